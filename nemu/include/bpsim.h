@@ -0,0 +1,43 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __BPSIM_H__
+#define __BPSIM_H__
+
+#include <common.h>
+
+#ifdef CONFIG_BPSIM
+
+// 控制流指令的种类, 由各 ISA 的译码部分给出
+typedef enum {
+  BP_COND,     // 条件分支
+  BP_JUMP,     // 直接跳转
+  BP_CALL,     // 函数调用 (直接或间接)
+  BP_RET,      // 函数返回
+  BP_INDIRECT, // 其他间接跳转
+  NR_BP_KIND,
+} BpKind;
+
+void init_bpsim(void);
+void bpsim_update(BpKind kind, vaddr_t pc, vaddr_t snpc, vaddr_t dnpc);
+void bpsim_report(void);
+
+#else
+// 只是用来骗过编译编译器的
+static inline void init_bpsim(void) {}
+static inline void bpsim_report(void) {}
+#endif
+
+#endif
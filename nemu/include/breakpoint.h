@@ -0,0 +1,37 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __BREAKPOINT_H__
+#define __BREAKPOINT_H__
+
+#include <common.h>
+
+#ifdef CONFIG_BREAKPOINT
+#include <memory/paddr.h>
+
+// pmem 中每个字 (指令) 一位, 有断点的位置置 1, 执行时只需要测一位
+#define BP_BITMAP_BITS (CONFIG_MSIZE / 4)
+extern uint64_t bp_bitmap[BP_BITMAP_BITS / 64];
+
+static inline bool bp_test(vaddr_t pc) {
+  paddr_t i = (pc - PMEM_LEFT) >> 2;
+  return i < BP_BITMAP_BITS && ((bp_bitmap[i / 64] >> (i % 64)) & 1);
+}
+
+bool check_breakpoint(vaddr_t pc);
+
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CACHESIM_H__
+#define __CACHESIM_H__
+
+#include <common.h>
+
+#ifdef CONFIG_CACHESIM
+
+enum { CACHESIM_IFETCH, CACHESIM_READ, CACHESIM_WRITE };
+
+void init_cachesim(void);
+void cachesim_access(int type, paddr_t addr);
+void cachesim_report(void);
+
+#else
+// 只是用来骗过编译编译器的
+static inline void init_cachesim(void) {}
+static inline void cachesim_report(void) {}
+#endif
+
+#endif
@@ -19,6 +19,11 @@
 #include <common.h>
 
 void cpu_exec(uint64_t n);
+void cpu_set_trace(bool on); // 切换带 trace 和不带 trace 的执行循环
+// 和执行循环一起切换. 指令和访存/设备/异常的钩子在其他编译单元里, 不能随执行循环
+// 一起被常量折叠, 由它们检查这个变量: trace 关闭时 mtrace/dtrace/etrace 的环和
+// ftrace 的调用栈都不更新 (FTRACE_PROFILE 除外), 打开之前的内容不会被清掉
+extern bool g_trace_on;
 
 void set_nemu_state(int state, vaddr_t pc, int halt_ret);
 void invalid_inst(vaddr_t thispc);
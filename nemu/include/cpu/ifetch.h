@@ -19,7 +19,7 @@
 #include <memory/vaddr.h>
 
 static inline uint32_t inst_fetch(vaddr_t *pc, int len) {
-  uint32_t inst = vaddr_ifetch(*pc, len);
+  uint32_t inst = len == 4 ? vaddr_ifetch32(*pc) : vaddr_ifetch(*pc, len);
   (*pc) += len;
   return inst;
 }
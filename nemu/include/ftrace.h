@@ -24,6 +24,10 @@ void init_ftrace(const char *img_file);
 void ftrace_call(vaddr_t pc, vaddr_t target);
 void ftrace_ret(vaddr_t pc);
 void ftrace_dump(void);
+const char *ftrace_func_name(vaddr_t addr); // 不在任何函数中时返回 NULL
+#ifdef CONFIG_FTRACE_PROFILE
+void init_ftrace_profile(const char *file);
+#endif
 
 #else
 // 只是用来骗过编译编译器的
@@ -31,6 +35,7 @@ static inline void init_ftrace(const char *elf_file) { (void)elf_file; }
 static inline void ftrace_call(vaddr_t pc, vaddr_t target) { (void)pc; (void)target; }
 static inline void ftrace_ret(vaddr_t pc) { (void)pc; }
 static inline void ftrace_dump(void) {}
+static inline const char *ftrace_func_name(vaddr_t addr) { (void)addr; return NULL; }
 #endif
 
 #endif
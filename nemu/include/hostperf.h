@@ -0,0 +1,92 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __HOSTPERF_H__
+#define __HOSTPERF_H__
+
+#include <common.h>
+
+#ifdef CONFIG_HOSTPERF
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * 执行循环里 host 时间的去向. 每个被计时的区域进入时压一个帧, 退出时
+ * 把经过的 tick 同时记到自己的 incl 和父区域的 child 上, self = incl - child,
+ * 所以 isa_exec_once 的 self 不包括其中的访存和 MMIO
+ */
+enum { HP_LOOP, HP_EXEC, HP_MEM, HP_MMIO, HP_DEVICE, HP_TRACE, HP_DIFFTEST, NR_HP };
+
+typedef struct { uint64_t calls, incl, self; } HostPerfSlot;
+typedef struct { uint64_t start, child; } HostPerfFrame;
+
+#define HOSTPERF_MAX_DEPTH 16
+
+extern HostPerfSlot hostperf_slot[NR_HP];
+extern HostPerfFrame hostperf_stack[HOSTPERF_MAX_DEPTH];
+extern int hostperf_top;
+extern bool hostperf_active;
+
+static inline uint64_t hostperf_tick(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static inline void hostperf_begin(void) {
+  HostPerfFrame *f = &hostperf_stack[++hostperf_top];
+  f->child = 0;
+  f->start = hostperf_tick();
+}
+
+static inline void hostperf_end(int id) {
+  uint64_t elapsed = hostperf_tick() - hostperf_stack[hostperf_top].start;
+  HostPerfSlot *s = &hostperf_slot[id];
+  s->calls++;
+  s->incl += elapsed;
+  s->self += elapsed - hostperf_stack[hostperf_top].child;
+  hostperf_stack[--hostperf_top].child += elapsed;
+}
+
+// 用法: HOSTPERF(HP_MEM, data = pmem_read(addr, len));
+// 只在执行循环里计时, sdb, gdbstub 和 difftest 接口在循环外的访存不算
+#define HOSTPERF(id, ...) do { \
+  bool hp_on_ = hostperf_active; \
+  if (hp_on_) hostperf_begin(); \
+  __VA_ARGS__; \
+  if (hp_on_) hostperf_end(id); \
+} while (0)
+
+void init_hostperf(const char *json_file);
+void hostperf_loop_begin(void);
+void hostperf_loop_end(void);
+void hostperf_report(void);
+
+#else
+// 只是用来骗过编译编译器的
+#define HOSTPERF(id, ...) do { __VA_ARGS__; } while (0)
+static inline void hostperf_loop_begin(void) {}
+static inline void hostperf_loop_end(void) {}
+static inline void hostperf_report(void) {}
+#endif
+
+#endif
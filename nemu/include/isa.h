@@ -32,6 +32,8 @@ void init_isa();
 extern CPU_state cpu;
 void isa_reg_display();
 word_t isa_reg_str2val(const char *name, bool *success);
+word_t *isa_reg_str2ptr(const char *name); // 没有这个寄存器时返回 NULL
+int isa_reg_gpr_idx(const word_t *reg); // reg 是第几个通用寄存器, 不是通用寄存器时返回 -1
 
 // exec
 struct Decode;
@@ -34,4 +34,20 @@ static inline bool in_pmem(paddr_t addr) {
 word_t paddr_read(paddr_t addr, int len);
 void paddr_write(paddr_t addr, int len, word_t data);
 
+// 宽度固定的版本, 访问 pmem 时不需要按 len 分派
+#define PADDR_ACCESSOR_DECL(bits) \
+  word_t paddr_read##bits(paddr_t addr); \
+  void paddr_write##bits(paddr_t addr, word_t data);
+
+PADDR_ACCESSOR_DECL(8)
+PADDR_ACCESSOR_DECL(16)
+PADDR_ACCESSOR_DECL(32)
+IFDEF(CONFIG_ISA64, PADDR_ACCESSOR_DECL(64))
+
+// 调用者接下来会写 [addr, addr + len), 并且可能是用系统调用写的 (例如 pread, mmap)
+void pmem_claim(paddr_t addr, size_t len);
+
+// addr 所在的块是否被访问过; 没有访问过的块还没有填随机值, 不需要保存
+bool pmem_chunk_touched(paddr_t addr);
+
 #endif
@@ -22,6 +22,25 @@ word_t vaddr_ifetch(vaddr_t addr, int len);
 word_t vaddr_read(vaddr_t addr, int len);
 void vaddr_write(vaddr_t addr, int len, word_t data);
 
+// 宽度固定的版本, 给译码器用, 宽度在编译时就知道
+word_t vaddr_ifetch32(vaddr_t addr);
+#define VADDR_ACCESSOR_DECL(bits) \
+  word_t vaddr_read##bits(vaddr_t addr); \
+  void vaddr_write##bits(vaddr_t addr, word_t data);
+
+VADDR_ACCESSOR_DECL(8)
+VADDR_ACCESSOR_DECL(16)
+VADDR_ACCESSOR_DECL(32)
+IFDEF(CONFIG_ISA64, VADDR_ACCESSOR_DECL(64))
+
+// 按字节数选择对应的版本, len 必须是字面量 1, 2, 4 或 8
+#define VADDR_BITS_1 8
+#define VADDR_BITS_2 16
+#define VADDR_BITS_4 32
+#define VADDR_BITS_8 64
+#define vaddr_read_n(addr, len) concat(vaddr_read, concat(VADDR_BITS_, len))(addr)
+#define vaddr_write_n(addr, len, data) concat(vaddr_write, concat(VADDR_BITS_, len))(addr, data)
+
 #ifdef CONFIG_MTRACE
 void mtrace_dump(void);
 #else
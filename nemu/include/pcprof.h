@@ -0,0 +1,68 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __PCPROF_H__
+#define __PCPROF_H__
+
+#include <common.h>
+
+#ifdef CONFIG_PCPROF
+#include <memory/paddr.h>
+
+// 每个 pmem 字一个计数器, 用 calloc 分配, 没执行过的页不会真正占用内存
+extern uint64_t *pcprof_cnt;   // 每个 pc 执行的次数
+extern uint64_t *pcprof_enter; // 作为基本块入口的次数
+extern bool pcprof_bb_end;     // 上一条指令是否结束了一个基本块
+
+static inline void pcprof_step(vaddr_t pc, uint32_t inst, vaddr_t snpc, vaddr_t dnpc) {
+  paddr_t i = (pc - PMEM_LEFT) >> 2;
+  if (likely(i < CONFIG_MSIZE / 4)) {
+    pcprof_cnt[i]++;
+    if (pcprof_bb_end) pcprof_enter[i]++;
+  }
+  // 跳转了, 或者是分支/跳转/system 指令 (没有跳转时下一条也是新的基本块)
+  switch (inst & 0x7f) {
+    case 0x63: case 0x6f: case 0x67: case 0x73: pcprof_bb_end = true; break;
+    default: pcprof_bb_end = dnpc != snpc; break;
+  }
+}
+
+// 按 INSTPAT 名字统计的指令组成, 每个 INSTPAT 有一个静态的计数器, 第一次命中时挂到链表上
+typedef struct InstMix {
+  const char *name;
+  uint64_t count;
+  bool registered;
+  struct InstMix *next;
+} InstMix;
+
+void instmix_register(InstMix *m);
+
+#define INSTMIX_COUNT(inst_name) do { \
+  static InstMix __mix = { .name = str(inst_name) }; \
+  if (unlikely(!__mix.registered)) instmix_register(&__mix); \
+  __mix.count++; \
+} while (0)
+
+void init_pcprof(void);
+void pcprof_dump(void);
+
+#else
+// 只是用来骗过编译编译器的
+static inline void init_pcprof(void) {}
+static inline void pcprof_step(vaddr_t pc, uint32_t inst, vaddr_t snpc, vaddr_t dnpc) { (void)pc; (void)inst; (void)snpc; (void)dnpc; }
+static inline void pcprof_dump(void) {}
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __SIMPOINT_H__
+#define __SIMPOINT_H__
+
+#include <common.h>
+
+// 检查点文件格式, 与 npc/include/simpoint.h 保持一致
+// 文件布局: SimpointCkptHeader, 然后是 npages 个 { uint32_t paddr; uint8_t data[SIMPOINT_PAGE_SIZE]; },
+// 最后是 ndevs 个 { SimpointCkptDev; uint8_t space[len]; }, 即各个设备的 MMIO 空间
+// 全零的页不写入, NPC 加载时先把 pmem 清零
+// 目录下的 SIMPOINT_CKPT_INDEX 每行记录一个检查点: 文件名 聚类编号 权重
+#define SIMPOINT_CKPT_MAGIC   0x4b435053 // "SPCK"
+#define SIMPOINT_CKPT_VERSION 2
+#define SIMPOINT_PAGE_SIZE    4096
+#define SIMPOINT_CKPT_INDEX   "checkpoints"
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t cluster;     // 聚类编号
+  uint32_t npages;      // 非零页的个数
+  uint64_t inst_count;  // 检查点位于第几条指令之后
+  uint64_t warmup;      // 详细模拟前的预热指令数
+  uint64_t interval;    // 需要详细模拟的指令数
+  uint64_t total_insts; // 整个程序的指令数, 用于估算总周期
+  double weight;        // 该区间所代表的指令比例
+  uint32_t mbase, msize;
+  uint32_t pc;
+  uint32_t gpr[32];
+  uint32_t mstatus, mtvec, mepc, mcause;
+  uint32_t ndevs;       // 设备的个数
+} SimpointCkptHeader;
+
+// 设备按名字对应, 只保存 MMIO 空间的内容, 设备模型在宿主机上的状态 (例如定时器的起点) 不保存
+typedef struct {
+  char name[16];
+  uint32_t len;
+} SimpointCkptDev;
+
+#ifdef CONFIG_SIMPOINT
+
+void init_simpoint(const char *profile_dir, const char *ckpt_dir);
+void simpoint_step(vaddr_t pc, vaddr_t snpc, vaddr_t dnpc);
+void simpoint_finish(void);
+
+#else
+// 只是用来骗过编译编译器的
+static inline void init_simpoint(const char *profile_dir, const char *ckpt_dir) { (void)profile_dir; (void)ckpt_dir; }
+static inline void simpoint_step(vaddr_t pc, vaddr_t snpc, vaddr_t dnpc) { (void)pc; (void)snpc; (void)dnpc; }
+static inline void simpoint_finish(void) {}
+#endif
+
+#endif
@@ -56,6 +56,18 @@ uint64_t get_time();
 
 #define ANSI_FMT(str, fmt) fmt str ANSI_NONE
 
+#ifdef CONFIG_TRACE_THREAD
+// 交给后台线程写, 与 tracer 的记录保持先后顺序
+#define log_write(...) \
+  do { \
+    extern FILE* log_fp; \
+    extern bool log_enable(); \
+    extern void tracelog_printf(const char *fmt, ...); \
+    if (log_enable() && log_fp != NULL) { \
+      tracelog_printf(__VA_ARGS__); \
+    } \
+  } while (0)
+#else
 #define log_write(...) IFDEF(CONFIG_TARGET_NATIVE_ELF, \
   do { \
     extern FILE* log_fp; \
@@ -66,6 +78,7 @@ uint64_t get_time();
     } \
   } while (0) \
 )
+#endif
 
 #define _Log(...) \
   do { \
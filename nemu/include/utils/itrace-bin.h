@@ -0,0 +1,126 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NEMU is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+#ifndef __UTILS_ITRACE_BIN_H__
+#define __UTILS_ITRACE_BIN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 二进制指令踪迹格式, NEMU 写入, tools/itrace-dump 离线解码
+ * 这个头文件不依赖 NEMU 的配置, 两边共用同一份编码
+ *
+ * 文件头: ITRACE_BIN_MAGIC (8 字节), 然后是 uint32_t version, uint32_t flags
+ * 之后是一条条记录, 每条记录:
+ *   uint8_t tag;
+ *     bit0 ITRACE_BIN_SEQ: pc 等于上一条指令的 pc + ilen, 省略 pc
+ *     bit1 ITRACE_BIN_HIT: 指令与缓存中该 pc 上次的指令相同, 省略 inst
+ *     bit2 ITRACE_BIN_RD : 后面跟着 rd 的新值
+ *     bit7:3            : rd 的编号
+ *   [varint zigzag(pc - 预期 pc)]          if !SEQ
+ *   [uint32_t inst, 小端]                   if !HIT
+ *   [varint zigzag(rd 新值 - rd 旧值)]      if RD
+ *
+ * 解码前的初始状态: 上一条指令的 pc 和 inst 都是 0, 寄存器和缓存的 inst 都是 0
+ * (缓存项的 pc 为 -1, 即无效)
+ *
+ * 指令缓存是按 pc 直接映射的 ITRACE_BIN_CACHE_SIZE 项, 写入端和解码端同步更新,
+ * 所以解码端总能复原出完整的 pc 和 inst
+ */
+
+#define ITRACE_BIN_MAGIC   "NEMUITB1"
+#define ITRACE_BIN_VERSION 1
+#define ITRACE_BIN_FLAG_RD   0x1 // 文件中带有 rd 的值
+#define ITRACE_BIN_FLAG_XL64 0x2 // 寄存器是 64 位的, 否则 rd 的值按 32 位回绕
+
+#define ITRACE_BIN_SEQ 0x1
+#define ITRACE_BIN_HIT 0x2
+#define ITRACE_BIN_RD  0x4
+#define ITRACE_BIN_RD_SHIFT 3
+
+#define ITRACE_BIN_CACHE_SIZE 4096 // 必须是 2 的幂
+#define ITRACE_BIN_REC_MAX (1 + 10 + 4 + 10)
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+} ItraceBinHeader;
+
+typedef struct {
+  uint64_t pc;
+  uint32_t inst;
+} ItraceBinCacheEntry;
+
+static inline ItraceBinCacheEntry *itrace_bin_cache_entry(ItraceBinCacheEntry *cache, uint64_t pc) {
+  return &cache[(pc >> 1) & (ITRACE_BIN_CACHE_SIZE - 1)];
+}
+
+// RISC-V 的指令长度: 低两位不是 11 的是压缩指令
+static inline int itrace_bin_ilen(uint32_t inst) {
+  return (inst & 0x3) == 0x3 ? 4 : 2;
+}
+
+// 会写 rd 的指令, 按 opcode 判断; x0 不记录
+static inline int itrace_bin_rd(uint32_t inst) {
+  int rd = (inst >> 7) & 0x1f;
+  if (rd == 0 || itrace_bin_ilen(inst) != 4) return -1;
+  switch (inst & 0x7f) {
+    case 0x37: case 0x17: case 0x6f: case 0x67: // lui auipc jal jalr
+    case 0x03: case 0x13: case 0x33:            // load op-imm op
+      return rd;
+    case 0x73: return ((inst >> 12) & 0x7) != 0 ? rd : -1; // csr*, 不包括 ecall/mret
+    default: return -1;
+  }
+}
+
+static inline uint64_t itrace_bin_zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t itrace_bin_unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline uint8_t *itrace_bin_put_varint(uint8_t *p, uint64_t v) {
+  while (v >= 0x80) {
+    *p++ = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+/// @return 解码后的位置, 数据不完整时返回 NULL
+static inline const uint8_t *itrace_bin_get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t b = *p++;
+    *v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) return p;
+  }
+  return NULL;
+}
+
+#ifdef CONFIG_ITRACE_BINARY
+struct Decode;
+void init_itrace_bin(const char *file);
+void itrace_bin_write(const struct Decode *s);
+void itrace_bin_flush(void);
+#endif
+
+#endif
@@ -16,6 +16,7 @@
 #ifndef __UTILS_RINGBUF_H__
 #define __UTILS_RINGBUF_H__
 
+#include <assert.h>
 #include <stddef.h>
 
 /*
@@ -38,12 +39,14 @@
 
 // 定义环形缓冲区类型
 // item_type: 元素类型
-// capacity: 缓冲区容量
+// capacity: 缓冲区容量, 必须是 2 的幂, 这样下标回绕只需要一次按位与
 #define RINGBUF_DEFINE(item_type, capacity)                                    \
   struct {                                                                     \
     item_type items[capacity];                                                 \
     size_t ptr;                                                                \
     size_t count;                                                              \
+    static_assert(((capacity) & ((capacity) - 1)) == 0,                        \
+                  "ring buffer capacity must be a power of 2");                \
   }
 
 // 初始化环形缓冲区
@@ -59,12 +62,12 @@
     if ((rb).count < (capacity)) {                                             \
       (rb).count++;                                                            \
     }                                                                          \
-    (rb).ptr = ((rb).ptr + 1) % (capacity);                                    \
+    (rb).ptr = ((rb).ptr + 1) & ((capacity) - 1);                              \
   } while (0)
 
 // 获取有效元素的起始位置
 #define RINGBUF_START(rb, capacity)                                            \
-  (((rb).ptr + (capacity) - (rb).count) % (capacity))
+  (((rb).ptr - (rb).count) & ((capacity) - 1))
 
 // 检查环形缓冲区是否为空
 #define RINGBUF_EMPTY(rb) ((rb).count == 0)
@@ -89,7 +92,7 @@
 #define RINGBUF_FOREACH(rb, capacity, idx, pos)                                \
   for (size_t idx = 0, pos = RINGBUF_START(rb, capacity),                      \
               _ringbuf_valid = (rb).count;                                     \
-       idx < _ringbuf_valid; idx++, pos = (pos + 1) % (capacity))
+       idx < _ringbuf_valid; idx++, pos = (pos + 1) & ((capacity) - 1))
 
 // 遍历时判断是否是最后一个元素 (通常用于标记当前执行位置)
 #define RINGBUF_IS_LAST(rb, idx) ((idx) == (rb).count - 1)
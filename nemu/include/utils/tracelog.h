@@ -0,0 +1,89 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NEMU is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+#ifndef __UTILS_TRACELOG_H__
+#define __UTILS_TRACELOG_H__
+
+#include <isa.h>
+
+#ifdef CONFIG_TRACE_THREAD
+#include <stdatomic.h>
+
+/*
+ * 所有 tracer 共用的日志环 (单生产者单消费者)
+ * CPU 线程只往环里写一条记录并递增 head, 由后台线程格式化 (包括反汇编) 后写入日志文件
+ * 普通的 log_write 也走这里, 以保证日志的先后顺序: 只记下格式串的指针和参数 (TREC_FMT),
+ * 由后台线程格式化. 格式串必须是字符串常量, %s 的内容会拷贝进环里
+ */
+
+typedef enum { TREC_TEXT, TREC_FMT, TREC_ARGS, TREC_INST, TREC_MEM, TREC_DEV, TREC_EXC } TraceRecType;
+
+// TREC_FMT 的参数和 TREC_TEXT 的文本都按这个长度切成多条记录, 直接拷贝到环里
+#define TREC_TEXT_CHUNK 16
+
+typedef struct {
+  uint8_t type;
+  char kind;   // mem/dev: 'R' 'W', exc: 'E' 'I' 'R'
+  uint8_t len; // text: 本条记录中的字节数, fmt: 后面跟着的 TREC_ARGS 记录数
+  vaddr_t pc;
+  union {
+    struct { vaddr_t snpc; ISADecodeInfo isa; } inst;
+    struct { vaddr_t addr; word_t data; } mem;
+    struct { const char *name; word_t data; } dev;
+    struct { word_t cause; vaddr_t handler; } exc;
+    const char *fmt;
+    char text[TREC_TEXT_CHUNK]; // 不以 '\0' 结尾
+  };
+} TraceRec;
+
+#define TRACE_RING_MASK (CONFIG_TRACE_RING_SIZE - 1)
+static_assert((CONFIG_TRACE_RING_SIZE & TRACE_RING_MASK) == 0, "CONFIG_TRACE_RING_SIZE must be a power of 2");
+
+extern TraceRec trace_ring[CONFIG_TRACE_RING_SIZE];
+extern _Atomic size_t trace_head, trace_tail;
+
+void init_tracelog(FILE *fp, bool compress);
+void tracelog_wait_space(size_t n);
+void tracelog_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void tracelog_sync(void);
+void tracelog_restart(void);
+
+// 以下只能在 CPU 线程调用
+// 预留 n 条记录, 返回第一条的下标; 写完之后用 tracelog_commit 一次性交给写线程
+static inline size_t tracelog_reserve(size_t n) {
+  size_t h = atomic_load_explicit(&trace_head, memory_order_relaxed);
+  if (unlikely(h + n - atomic_load_explicit(&trace_tail, memory_order_acquire) > CONFIG_TRACE_RING_SIZE)) {
+    tracelog_wait_space(n);
+  }
+  return h;
+}
+
+static inline void tracelog_commit(size_t head) {
+  atomic_store_explicit(&trace_head, head, memory_order_release);
+}
+
+static inline void tracelog_push(const TraceRec *r) {
+  size_t h = tracelog_reserve(1);
+  trace_ring[h & TRACE_RING_MASK] = *r;
+  tracelog_commit(h + 1);
+}
+
+#else
+// 只是用来骗过编译编译器的
+static inline void tracelog_sync(void) {}
+static inline void tracelog_restart(void) {}
+#endif
+
+#endif
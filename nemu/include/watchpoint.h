@@ -0,0 +1,42 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __WATCHPOINT_H__
+#define __WATCHPOINT_H__
+
+#include <common.h>
+
+#ifdef CONFIG_WATCHPOINT
+
+/*
+ * 监视点只在它依赖的状态被修改之后才重新求值:
+ * 依赖的通用寄存器被写, 或者依赖的内存 (形如 *ADDR) 被写时, 置上 wp_dirty
+ * 依赖 pc, csr 或者间接内存访问的监视点每条指令都要检查
+ */
+extern uint32_t wp_reg_mask;          // 所有监视点依赖的通用寄存器
+extern paddr_t wp_mem_lo, wp_mem_hi;  // 所有监视点依赖的内存范围 (闭区间), 没有时 lo > hi
+extern bool wp_dirty;
+
+static inline void wp_reg_write(int idx) {
+  if (unlikely((wp_reg_mask >> idx) & 1)) { wp_dirty = true; }
+}
+
+static inline void wp_mem_write(paddr_t addr, int len) {
+  if (unlikely(addr <= wp_mem_hi && addr + len - 1 >= wp_mem_lo)) { wp_dirty = true; }
+}
+
+#endif
+
+#endif
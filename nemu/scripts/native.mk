@@ -41,10 +41,46 @@ gdb: run-env
 	$(call git_commit, "gdb NEMU")
 	gdb -s $(BINARY) --args $(NEMU_EXEC)
 
+# 并行回归测试, 例如
+# make regress REGRESS_DIRS=$(AM_KERNELS_HOME)/tests/cpu-tests/build REGRESS_FLAGS="--baseline base.json"
+# REGRESS_FLAGS=--flows 还会检查 itrace-dump, sdb 断点, gdbstub, locale 和 NPC 检查点的流程
+REGRESS_DIRS ?= $(AM_KERNELS_HOME)/tests/cpu-tests/build
+regress: run-env
+	python3 $(NEMU_HOME)/tools/regress/regress.py --sim $(GUEST_ISA)-nemu=$(BINARY) \
+		--args "$(GUEST_ISA)-nemu=$(ARGS_DIFF)" -o $(BUILD_DIR)/regress $(REGRESS_FLAGS) $(REGRESS_DIRS)
+
+# 标准 benchmark, 每个负载在 BENCH_CPU 上跑 BENCH_RUNS 次, 结果写到 build/bench.csv
+# 打开 TIMER_VIRTUAL 之后负载看到的时间只和指令数有关, 每次运行的行为都一样
+PERFRUN = $(NEMU_HOME)/tools/perfrun/build/perfrun
+BENCH_KERNELS ?= $(AM_KERNELS_HOME)/benchmarks/coremark $(AM_KERNELS_HOME)/benchmarks/dhrystone \
+                 $(AM_KERNELS_HOME)/benchmarks/microbench \
+                 $(NEMU_HOME)/tools/bench/kernels/memstream $(NEMU_HOME)/tools/bench/kernels/mmio
+BENCH_RUNS ?= 5
+BENCH_CPU ?= 2
+# microbench 的输入规模
+BENCH_MAINARGS ?= train
+
+# 负载看到的是主机时间的话, 每次运行的行为都不一样, 结果没法比较
+ifneq ($(filter bench,$(MAKECMDGOALS)),)
+ifndef CONFIG_TIMER_VIRTUAL
+$(error make bench needs CONFIG_TIMER_VIRTUAL, enable it in menuconfig first)
+endif
+endif
+
+$(PERFRUN):
+	$(MAKE) -C $(NEMU_HOME)/tools/perfrun
+
+bench: $(BINARY) $(PERFRUN)
+	@for k in $(BENCH_KERNELS); do \
+		$(MAKE) -s -C $$k ARCH=$(GUEST_ISA)-nemu mainargs=$(BENCH_MAINARGS) insert-arg || exit 1; \
+	done
+	python3 $(NEMU_HOME)/tools/bench/bench.py --sim $(BINARY) --arch $(GUEST_ISA)-nemu --perfrun $(PERFRUN) \
+		--runs $(BENCH_RUNS) --cpu $(BENCH_CPU) --csv $(BUILD_DIR)/bench.csv $(BENCH_KERNELS)
+
 clean-tools = $(dir $(shell find ./tools -maxdepth 2 -mindepth 2 -name "Makefile"))
 $(clean-tools):
 	-@$(MAKE) -s -C $@ clean
 clean-tools: $(clean-tools)
 clean-all: clean distclean clean-tools
 
-.PHONY: run gdb run-env clean-tools clean-all $(clean-tools)
+.PHONY: run gdb run-env regress bench clean-tools clean-all $(clean-tools)
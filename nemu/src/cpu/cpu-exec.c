@@ -22,6 +22,14 @@
 #include <ftrace.h>
 #include <locale.h>
 #include <memory/vaddr.h>
+#include <simpoint.h>
+#include <pcprof.h>
+#include <hostperf.h>
+#include <breakpoint.h>
+#include <cachesim.h>
+#include <bpsim.h>
+#include <utils/itrace-bin.h>
+#include <utils/tracelog.h>
 #include "../isa/riscv32/local-include/reg.h"
 
 /* The assembly code of instructions executed is only output to the screen
@@ -43,23 +51,47 @@ static uint64_t g_timer = 0; // unit: us
 static bool g_print_step = false;
 
 void device_update();
+bool log_enable();
 
-static void trace_and_difftest(Decode *_this, vaddr_t dnpc) {
+#ifdef CONFIG_ITRACE
+bool gen_logbuf(char *logbuf, size_t size, vaddr_t pc, vaddr_t snpc,
+                const ISADecodeInfo *isa);
+
+// 反汇编很慢, 只在真正要输出的时候才生成 logbuf
+static const char *get_logbuf(Decode *s) {
+  if (s->logbuf[0] == '\0') {
+    bool ret = gen_logbuf(s->logbuf, sizeof(s->logbuf), s->pc, s->snpc, &s->isa);
+    Assert(ret, "disassemble failed"); // 不可能失败
+  }
+  return s->logbuf;
+}
+#endif
+
+__attribute__((always_inline))
+static inline void trace_and_difftest(Decode *_this, vaddr_t dnpc, bool traced) {
 #ifdef CONFIG_ITRACE_COND
-  if (ITRACE_COND) {
-    log_write("%s\n", _this->logbuf);
+  // log_enable() 在 trace 窗口之外为 false, 这时连反汇编都省掉
+  if (traced && ITRACE_COND && log_enable()) {
+#ifdef CONFIG_TRACE_THREAD
+    tracelog_push(&(TraceRec){ .type = TREC_INST, .pc = _this->pc,
+                               .inst = { .snpc = _this->snpc, .isa = _this->isa } });
+#else
+    log_write("%s\n", get_logbuf(_this));
+#endif
   }
 #endif
-  if (g_print_step) {
-    IFDEF(CONFIG_ITRACE, puts(_this->logbuf));
+  // rewind 之后的重放既不输出, 也不检查监视点
+  bool replaying = MUXDEF(CONFIG_SNAPSHOT, snapshot_replaying(), false);
+  if (g_print_step && !replaying) {
+    IFDEF(CONFIG_ITRACE, puts(get_logbuf(_this)));
   }
 
 #ifdef CONFIG_DIFFTEST
-  difftest_step(_this->pc, dnpc);
+  HOSTPERF(HP_DIFFTEST, difftest_step(_this->pc, dnpc));
 #endif
 
 #ifdef CONFIG_WATCHPOINT
-  check_watchpoints();
+  if (!replaying) { check_watchpoints(); }
 #endif
 }
 
@@ -111,7 +143,8 @@ static void dump_iringbuf(void) {
   if (RINGBUF_EMPTY(g_iringbuf))
     return;
 
-  Log("Last %d instructions:", CONFIG_IRINGBUF_SIZE);
+  // 只有 execute_traced 记录, trace off 之后这里停在关闭时的位置
+  Log("Last %d instructions%s:", CONFIG_IRINGBUF_SIZE, g_trace_on ? "" : " before 'trace off'");
   char logbuf[128];
   RINGBUF_FOREACH(g_iringbuf, CONFIG_IRINGBUF_SIZE, idx, pos) {
     const ItraceItem *it = RINGBUF_GET(g_iringbuf, pos);
@@ -132,32 +165,74 @@ static void dump_iringbuf(void) {
 static void exec_once(Decode *s, vaddr_t pc /*always pc = cpu.pc*/) {
   s->pc = pc;   // record
   s->snpc = pc; // static next pc
-  isa_exec_once(s);
+  HOSTPERF(HP_EXEC, isa_exec_once(s));
   cpu.pc = s->dnpc;
 }
 
-static void execute(uint64_t n) {
+#ifdef CONFIG_BREAKPOINT
+// 上一次因为断点停在了哪里, 从这里恢复执行时第一条指令不再检查断点
+static bool bp_stopped = false;
+static vaddr_t bp_stop_pc = 0;
+
+// 在执行 pc 处的指令之前检查断点, 返回 true 时停下来
+static inline bool breakpoint_before(vaddr_t pc, bool *resume) {
+  bool skip = *resume;
+  *resume = false;
+  if (likely(!bp_test(pc)) || skip) { return false; }
+  if (MUXDEF(CONFIG_SNAPSHOT, snapshot_replaying(), false)) { return false; }
+  if (!check_breakpoint(pc)) { return false; }
+  bp_stopped = true;
+  bp_stop_pc = pc;
+  return true;
+}
+#endif
+
+// 执行循环按 traced 编译成两份, traced 为 false 时 itrace 相关的代码都被编译器删掉
+__attribute__((always_inline))
+static inline void execute_body(uint64_t n, bool traced) {
   Decode s;
+#ifdef CONFIG_BREAKPOINT
+  bool resume = bp_stopped && bp_stop_pc == cpu.pc;
+  bp_stopped = false;
+#endif
   for (; n > 0; n--) {
+#ifdef CONFIG_SNAPSHOT
+    if (snapshot_step()) { break; } // 重放到了 rewind 的目标
+#endif
+    IFDEF(CONFIG_BREAKPOINT, if (breakpoint_before(cpu.pc, &resume)) break);
     exec_once(&s, cpu.pc);
 
 #ifdef CONFIG_ITRACE
-    // 生成日志(完整)
-    bool ret = gen_logbuf(s.logbuf, sizeof(s.logbuf), s.pc, s.snpc, &s.isa);
-    Assert(ret, "disassemble failed"); // 不可能失败
-    // 最近的 CONFIG_IRINGBUF_SIZE 条指令
-    RINGBUF_PUSH(g_iringbuf, CONFIG_IRINGBUF_SIZE,
-                 ((ItraceItem){.pc = s.pc, .snpc = s.snpc, .isa = s.isa}));
+    s.logbuf[0] = '\0'; // 需要时再由 get_logbuf() 生成
+    // 最近的 CONFIG_IRINGBUF_SIZE 条指令, 只记录原始编码, dump 时才反汇编
+    if (traced) {
+      RINGBUF_PUSH(g_iringbuf, CONFIG_IRINGBUF_SIZE,
+                   ((ItraceItem){.pc = s.pc, .snpc = s.snpc, .isa = s.isa}));
+    }
 #endif
 
+    IFDEF(CONFIG_ITRACE_BINARY, if (traced) itrace_bin_write(&s));
+    IFDEF(CONFIG_PCPROF, pcprof_step(s.pc, s.isa.inst, s.snpc, s.dnpc));
+
     g_nr_guest_inst++;
-    trace_and_difftest(&s, cpu.pc);
+    IFDEF(CONFIG_SIMPOINT, simpoint_step(s.pc, s.snpc, s.dnpc));
+    HOSTPERF(HP_TRACE, trace_and_difftest(&s, cpu.pc, traced));
     if (nemu_state.state != NEMU_RUNNING)
       break;
-    IFDEF(CONFIG_DEVICE, device_update());
+    IFDEF(CONFIG_DEVICE, HOSTPERF(HP_DEVICE, device_update()));
   }
 }
 
+static void execute_fast(uint64_t n) { execute_body(n, false); }
+static void execute_traced(uint64_t n) { execute_body(n, true); }
+
+static void (*execute)(uint64_t n) = execute_traced;
+
+void cpu_set_trace(bool on) {
+  g_trace_on = on;
+  execute = on ? execute_traced : execute_fast;
+}
+
 static void statistic() {
   IFNDEF(CONFIG_TARGET_AM, setlocale(LC_NUMERIC, ""));
 #define NUMBERIC_FMT MUXDEF(CONFIG_TARGET_AM, "%", "%'") PRIu64
@@ -169,12 +244,19 @@ static void statistic() {
   else
     Log("Finish running in less than 1 us and can not calculate the simulation "
         "frequency");
+  IFDEF(CONFIG_PCPROF, pcprof_dump());
+  cachesim_report();
+  bpsim_report();
+  hostperf_report();
 }
 
 static void dump_trace_msg(void) {
 #ifdef CONFIG_ITRACE
   dump_iringbuf();
 #endif
+#ifdef CONFIG_ITRACE_BINARY
+  itrace_bin_flush();
+#endif
 #ifdef CONFIG_MTRACE
   mtrace_dump();
 #endif
@@ -193,6 +275,7 @@ void assert_fail_msg() {
   isa_reg_display();
   dump_trace_msg();
   statistic();
+  tracelog_sync(); // 马上就要 abort 了
 }
 
 /* Simulate how the CPU works. */
@@ -211,7 +294,14 @@ void cpu_exec(uint64_t n) {
 
   uint64_t timer_start = get_time();
 
+  hostperf_loop_begin();
   execute(n);
+#ifdef CONFIG_SNAPSHOT
+  // 被唤醒的快照接着原来那次 cpu_exec 执行, 它的 n 不一定够重放到目标
+  while (snapshot_replaying() && nemu_state.state == NEMU_RUNNING) { execute(-1); }
+  snapshot_end_replay();
+#endif
+  hostperf_loop_end();
 
   uint64_t timer_end = get_time();
   g_timer += timer_end - timer_start;
@@ -231,6 +321,7 @@ void cpu_exec(uint64_t n) {
                     ? ANSI_FMT("HIT GOOD TRAP", ANSI_FG_GREEN)
                     : ANSI_FMT("HIT BAD TRAP", ANSI_FG_RED))),
         nemu_state.halt_pc);
+    IFDEF(CONFIG_SIMPOINT, simpoint_finish());
     dump_trace_msg();
     // fall through
   case NEMU_QUIT:
@@ -16,6 +16,7 @@
 #include <device/map.h>
 #include <isa.h>
 #include <memory/paddr.h>
+#include <hostperf.h>
 
 // mmio
 IOMap maps[NR_MAP] = {};
@@ -64,7 +65,11 @@ void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len,
 }
 
 #ifdef CONFIG_DTRACE
+#include <cpu/cpu.h>
 #include <utils/ringbuf.h>
+#include <utils/tracelog.h>
+
+bool trace_enable();
 
 #define DTRACE_BUF_SIZE 16
 
@@ -83,10 +88,20 @@ static RINGBUF_DEFINE(DtraceItem, DTRACE_BUF_SIZE) dtrace_buf = RINGBUF_INIT;
 
 static void dtrace_push(const IOMap *map, word_t data, int len, char type,
                         word_t pc) {
+  if (!g_trace_on) return;
   RINGBUF_PUSH(
       dtrace_buf, DTRACE_BUF_SIZE,
       ((DtraceItem){
           .map = map, .data = data, .len = len, .type = type, .pc = pc}));
+#ifdef CONFIG_TRACE_THREAD
+  if (trace_enable()) {
+    tracelog_push(&(TraceRec){.type = TREC_DEV,
+                              .kind = type,
+                              .len = len,
+                              .pc = pc,
+                              .dev = {.name = map->name, .data = data}});
+  }
+#endif
 }
 
 void dtrace_dump(void) {
@@ -126,7 +141,8 @@ void dtrace_dump(void) {
 word_t mmio_read(paddr_t addr, int len) {
   IOMap *map = fetch_mmio_map(addr);
 
-  word_t data = map_read(addr, len, map);
+  word_t data;
+  HOSTPERF(HP_MMIO, data = map_read(addr, len, map));
 
 #ifdef CONFIG_DTRACE
   dtrace_push(map, data, len, 'R', cpu.pc);
@@ -142,5 +158,5 @@ void mmio_write(paddr_t addr, int len, word_t data) {
   dtrace_push(map, data, len, 'R', cpu.pc);
 #endif
 
-  map_write(addr, len, data, map);
+  HOSTPERF(HP_MMIO, map_write(addr, len, data, map));
 }
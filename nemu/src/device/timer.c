@@ -19,10 +19,17 @@
 
 static uint32_t *rtc_port_base = NULL;
 
+#ifdef CONFIG_TIMER_VIRTUAL
+extern uint64_t g_nr_guest_inst;
+static uint64_t rtc_time() { return g_nr_guest_inst / CONFIG_TIMER_VIRTUAL_MIPS; }
+#else
+static uint64_t rtc_time() { return get_time(); }
+#endif
+
 static void rtc_io_handler(uint32_t offset, int len, bool is_write) {
   assert(offset == 0 || offset == 4);
   if (!is_write && offset == 4) {
-    uint64_t us = get_time();
+    uint64_t us = rtc_time();
     rtc_port_base[0] = (uint32_t)us;
     rtc_port_base[1] = us >> 32;
   }
@@ -16,11 +16,21 @@
 #include <cpu/cpu.h>
 
 void sdb_mainloop();
+void gdbstub_mainloop();
+bool gdbstub_enabled();
 
 void engine_start() {
 #ifdef CONFIG_TARGET_AM
   cpu_exec(-1);
 #else
+#ifdef CONFIG_GDBSTUB
+  /* Let gdb drive the execution instead of sdb. */
+  if (gdbstub_enabled()) {
+    gdbstub_mainloop();
+    return;
+  }
+#endif
+
   /* Receive commands from user. */
   sdb_mainloop();
 #endif
@@ -14,9 +14,22 @@
 #**************************************************************************************/
 
 SRCS-y += src/nemu-main.c
+SRCS-BLACKLIST-$(CONFIG_TARGET_AM) += src/monitor/image.c
 DIRS-y += src/cpu src/monitor src/utils
 DIRS-$(CONFIG_MODE_SYSTEM) += src/memory
 DIRS-BLACKLIST-$(CONFIG_TARGET_AM) += src/monitor/sdb
+ifeq ($(CONFIG_SNAPSHOT),)
+SRCS-BLACKLIST-y += src/monitor/sdb/snapshot.c
+endif
+ifeq ($(CONFIG_BREAKPOINT),)
+SRCS-BLACKLIST-y += src/monitor/sdb/breakpoint.c
+endif
+ifeq ($(CONFIG_GDBSTUB),)
+SRCS-BLACKLIST-y += src/monitor/sdb/gdbstub.c
+endif
+# RSP 协议层和 NPC 共用, 放在 tools/gdbstub 中
+SRCS-$(CONFIG_GDBSTUB) += tools/gdbstub/rsp.c
+INC_PATH += $(NEMU_HOME)/tools/gdbstub
 
 SHARE = $(if $(CONFIG_TARGET_SHARE),1,0)
 LIBS += $(if $(CONFIG_TARGET_NATIVE_ELF),-lreadline -ldl -pie,)
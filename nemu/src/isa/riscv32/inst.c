@@ -19,11 +19,16 @@
 #include <cpu/ifetch.h>
 #include <cpu/decode.h>
 #include <ftrace.h>
+#include <pcprof.h>
+#include <bpsim.h>
+#include <watchpoint.h>
 #include <stdint.h>
 
 #define R(i) gpr(i)
-#define Mr vaddr_read
-#define Mw vaddr_write
+#define Mr vaddr_read_n
+#define Mw vaddr_write_n
+// FTRACE_PROFILE 需要完整的调用栈, trace off 时也要跟踪
+#define FTRACE_ON MUXDEF(CONFIG_FTRACE_PROFILE, true, g_trace_on)
 
 enum {
   TYPE_I, TYPE_U, TYPE_S, TYPE_B, TYPE_J, TYPE_R,
@@ -55,11 +60,27 @@ static void decode_operand(Decode *s, int *rd, word_t *src1, word_t *src2, word_
   }
 }
 
+#ifdef CONFIG_BPSIM
+// 按 RISC-V 的调用约定区分 call/ret: rd 为 ra/t0 时是调用, rd 为 zero 且 rs1 为 ra 时是返回
+static void bpsim_classify(Decode *s) {
+  uint32_t i = s->isa.inst;
+  int rd = BITS(i, 11, 7), rs1 = BITS(i, 19, 15);
+  bool link = rd == 1 || rd == 5;
+  switch (BITS(i, 6, 0)) {
+    case 0x63: bpsim_update(BP_COND, s->pc, s->snpc, s->dnpc); break;
+    case 0x6f: bpsim_update(link ? BP_CALL : BP_JUMP, s->pc, s->snpc, s->dnpc); break;
+    case 0x67: bpsim_update(link ? BP_CALL : (rd == 0 && rs1 == 1) ? BP_RET : BP_INDIRECT,
+                   s->pc, s->snpc, s->dnpc); break;
+  }
+}
+#endif
+
 static int decode_exec(Decode *s) {
   s->dnpc = s->snpc;
 
 #define INSTPAT_INST(s) ((s)->isa.inst)
 #define INSTPAT_MATCH(s, name, type, ... /* execute body */ ) { \
+  IFDEF(CONFIG_PCPROF, INSTMIX_COUNT(name)); \
   int rd = 0; \
   word_t src1 = 0, src2 = 0, imm = 0; \
   decode_operand(s, &rd, &src1, &src2, &imm, concat(TYPE_, type)); \
@@ -71,7 +92,7 @@ static int decode_exec(Decode *s) {
   INSTPAT("??????? ????? ????? ??? ????? 00101 11", auipc  , U, R(rd) = s->pc + imm);
   INSTPAT("??????? ????? ????? ????? ????? 11011 11", jal   , J, { R(rd) = s->snpc; s->dnpc = s->pc + imm;
 #ifdef CONFIG_FTRACE
-    if (rd == 1) { // `call` aka. `jal ra, func`
+    if (FTRACE_ON && rd == 1) { // `call` aka. `jal ra, func`
       ftrace_call(s->pc, s->dnpc);
     }
 #endif
@@ -80,7 +101,9 @@ static int decode_exec(Decode *s) {
   INSTPAT("??????? ????? ????? 000 ????? 11001 11", jalr   , I, { word_t t = s->snpc; s->dnpc = (src1 + imm) & (~(word_t)1); R(rd) = t;
 #ifdef CONFIG_FTRACE
     int rs1 = BITS(s->isa.inst, 19, 15);
-    if (rd == 0 && rs1 == 1 && imm == 0) { // `ret` aka. `jalr zero, 0(ra)`
+    if (!FTRACE_ON) {
+      // trace off
+    } else if (rd == 0 && rs1 == 1 && imm == 0) { // `ret` aka. `jalr zero, 0(ra)`
       ftrace_ret(s->pc); // 函数返回
     } else if (rd != 0) {
       ftrace_call(s->pc, s->dnpc); // 函数指针调用
@@ -158,6 +181,16 @@ static int decode_exec(Decode *s) {
 
   R(0) = 0; // reset $zero to 0
 
+#ifdef CONFIG_WATCHPOINT
+  // S/B 型指令的 rd 字段是立即数的一部分, 不写寄存器
+  uint32_t opcode = BITS(s->isa.inst, 6, 0);
+  if (opcode != 0x23 && opcode != 0x63) { wp_reg_write(BITS(s->isa.inst, 11, 7)); }
+#endif
+
+#ifdef CONFIG_BPSIM
+  bpsim_classify(s);
+#endif
+
   return 0;
 }
 
@@ -41,27 +41,37 @@ void isa_reg_display() {
   }
 }
 
-word_t isa_reg_str2val(const char *s, bool *success) {
-  if (success) { *success = true; }
-
+word_t *isa_reg_str2ptr(const char *s) {
   if (strcmp(s, "pc") == 0) {
-    return cpu.pc;
+    return &cpu.pc;
   }
 
   for (int i = 0; i < ARRLEN(regs); i++) {
     if (strcmp(s, regs[i]) == 0) {
-      return cpu.gpr[i];
+      return &cpu.gpr[i];
     }
   }
 
   // csrs
-  if (strcmp(s, csrs[MSTATUS]) == 0) { return cpu.csr[MSTATUS]; }
-  if (strcmp(s, csrs[MTVEC]) == 0) { return cpu.csr[MTVEC]; }
-  if (strcmp(s, csrs[MEPC]) == 0) { return cpu.csr[MEPC]; }
-  if (strcmp(s, csrs[MCAUSE]) == 0) { return cpu.csr[MCAUSE]; }
-  if (strcmp(s, csrs[MVENDORID]) == 0) { return cpu.csr[MVENDORID]; }
-  if (strcmp(s, csrs[MARCHID]) == 0) { return cpu.csr[MARCHID]; }
+  if (strcmp(s, csrs[MSTATUS]) == 0) { return &cpu.csr[MSTATUS]; }
+  if (strcmp(s, csrs[MTVEC]) == 0) { return &cpu.csr[MTVEC]; }
+  if (strcmp(s, csrs[MEPC]) == 0) { return &cpu.csr[MEPC]; }
+  if (strcmp(s, csrs[MCAUSE]) == 0) { return &cpu.csr[MCAUSE]; }
+  if (strcmp(s, csrs[MVENDORID]) == 0) { return &cpu.csr[MVENDORID]; }
+  if (strcmp(s, csrs[MARCHID]) == 0) { return &cpu.csr[MARCHID]; }
+
+  return NULL;
+}
 
-  if (success) { *success = false; }
-  return 0;
+int isa_reg_gpr_idx(const word_t *reg) {
+  for (int i = 0; i < ARRLEN(cpu.gpr); i++) {
+    if (reg == &cpu.gpr[i]) { return i; }
+  }
+  return -1;
+}
+
+word_t isa_reg_str2val(const char *s, bool *success) {
+  word_t *r = isa_reg_str2ptr(s);
+  if (success) { *success = (r != NULL); }
+  return r ? *r : 0;
 }
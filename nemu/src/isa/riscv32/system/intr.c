@@ -22,6 +22,9 @@
 
 #ifdef CONFIG_ETRACE
 #include <utils/ringbuf.h>
+#include <utils/tracelog.h>
+
+bool trace_enable();
 
 #define ETRACE_BUF_SIZE 16
 
@@ -60,8 +63,15 @@ static const char *get_exception_name(word_t cause) {
 }
 
 static void etrace_push(char type, word_t cause, vaddr_t epc, vaddr_t handler) {
+  if (!g_trace_on) return;
   RINGBUF_PUSH(etrace_buf, ETRACE_BUF_SIZE,
       ((EtraceItem){.cause = cause, .epc = epc, .handler = handler, .type = type}));
+#ifdef CONFIG_TRACE_THREAD
+  if (trace_enable()) {
+    tracelog_push(&(TraceRec){ .type = TREC_EXC, .kind = type, .pc = epc,
+                               .exc = { .cause = cause, .handler = handler } });
+  }
+#endif
 }
 
 void etrace_dump(void) {
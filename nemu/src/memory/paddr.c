@@ -17,8 +17,14 @@
 #include <memory/paddr.h>
 #include <device/mmio.h>
 #include <isa.h>
+#include <hostperf.h>
+#ifdef CONFIG_PMEM_MMAP
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#endif
 
-#if   defined(CONFIG_PMEM_MALLOC)
+#if   defined(CONFIG_PMEM_MALLOC) || defined(CONFIG_PMEM_MMAP)
 static uint8_t *pmem = NULL;
 #else // CONFIG_PMEM_GARRAY
 static uint8_t pmem[CONFIG_MSIZE] PG_ALIGN = {};
@@ -41,24 +47,162 @@ static void out_of_bound(paddr_t addr) {
       addr, PMEM_LEFT, PMEM_RIGHT, cpu.pc);
 }
 
+#ifdef CONFIG_MEM_RANDOM
+// 随机初始化以块为单位, 内容只取决于种子和块号, 每次运行都相同
+#define PMEM_CHUNK (2 * 1024 * 1024)
+#define NR_CHUNK ((CONFIG_MSIZE + PMEM_CHUNK - 1) / PMEM_CHUNK)
+
+static size_t chunk_size(size_t i) {
+  size_t rest = CONFIG_MSIZE - i * PMEM_CHUNK;
+  return rest < PMEM_CHUNK ? rest : PMEM_CHUNK;
+}
+
+static void fill_chunk(size_t i) {
+  uint64_t *p = (uint64_t *)(pmem + i * PMEM_CHUNK);
+  size_t n = chunk_size(i) / sizeof(uint64_t);
+  uint64_t x = CONFIG_MEM_RANDOM_SEED ^ (i * 0x9e3779b97f4a7c15ull);
+  for (size_t k = 0; k < n; k++) { // splitmix64
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    p[k] = z ^ (z >> 31);
+  }
+}
+#endif
+
+#if defined(CONFIG_PMEM_MMAP) && defined(CONFIG_MEM_RANDOM)
+/*
+ * pmem 一开始是 PROT_NONE, 第一次访问某一块时在 SIGSEGV 里把它改成可读写并填上随机值,
+ * 因此启动时不需要碰任何页, 没访问过的块也不占用内存.
+ * 注意: 系统调用 (read/pread 等) 直接写没有填过的块会得到 EFAULT 而不是 SIGSEGV,
+ * 这种情况要先调用 pmem_claim()
+ */
+static bool chunk_ready[NR_CHUNK] = {};
+
+static void prepare_chunk(size_t i, bool fill) {
+  uint8_t *p = pmem + i * PMEM_CHUNK;
+  // 失败时不能返回, 否则 pmem_fault 返回后会在同一条指令上无限地重新触发 SIGSEGV
+  int ret = mprotect(p, chunk_size(i), PROT_READ | PROT_WRITE);
+  if (ret != 0) panic("pmem: can not map chunk %zu: %s", i, strerror(errno));
+  if (fill) fill_chunk(i);
+  chunk_ready[i] = true;
+}
+
+static struct sigaction old_segv; // 安装 pmem_fault 之前的处理方式
+
+static void pmem_fault(int sig, siginfo_t *info, void *ucontext) {
+  uint8_t *addr = info->si_addr;
+  if (addr >= pmem && addr < pmem + CONFIG_MSIZE) {
+    size_t i = (addr - pmem) / PMEM_CHUNK;
+    if (!chunk_ready[i]) { prepare_chunk(i, true); return; }
+  }
+  // 不是 pmem 的第一次访问, 交给原来的处理函数
+  if (old_segv.sa_flags & SA_SIGINFO) { old_segv.sa_sigaction(sig, info, ucontext); return; }
+  if (old_segv.sa_handler != SIG_DFL && old_segv.sa_handler != SIG_IGN) { old_segv.sa_handler(sig); return; }
+  // 原来没有处理函数: 恢复之后重新执行那条指令, 按原来的方式崩溃
+  sigaction(SIGSEGV, &old_segv, NULL);
+}
+
+void pmem_claim(paddr_t addr, size_t len) {
+  if (len == 0) return;
+  size_t lo = addr - CONFIG_MBASE, hi = lo + len;
+  for (size_t i = lo / PMEM_CHUNK; i <= (hi - 1) / PMEM_CHUNK; i++) {
+    if (chunk_ready[i]) continue;
+    // 整块都会被调用者覆盖的话就不用填了
+    bool whole = i * PMEM_CHUNK >= lo && i * PMEM_CHUNK + chunk_size(i) <= hi;
+    prepare_chunk(i, !whole);
+  }
+}
+
+bool pmem_chunk_touched(paddr_t addr) {
+  return chunk_ready[(addr - CONFIG_MBASE) / PMEM_CHUNK];
+}
+#else
+void pmem_claim(paddr_t addr, size_t len) {}
+bool pmem_chunk_touched(paddr_t addr) { return true; }
+#endif
+
+#ifdef CONFIG_PMEM_MMAP
+#define HUGE_PAGE (2 * 1024 * 1024)
+
+static void pmem_mmap() {
+  // 多映射一个大页, 以便把 pmem 对齐到大页的边界; 匿名页在第一次访问时才由内核清零
+  int prot = MUXDEF(CONFIG_MEM_RANDOM, PROT_NONE, PROT_READ | PROT_WRITE);
+  uint8_t *p = mmap(NULL, CONFIG_MSIZE + HUGE_PAGE, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  Assert(p != MAP_FAILED, "Can not map pmem");
+  pmem = (uint8_t *)(((uintptr_t)p + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1));
+#ifdef CONFIG_PMEM_HUGEPAGE
+  if (madvise(pmem, CONFIG_MSIZE, MADV_HUGEPAGE) != 0) Log("pmem: transparent huge pages are not available");
+#endif
+#ifdef CONFIG_MEM_RANDOM
+  struct sigaction s = {};
+  s.sa_sigaction = pmem_fault;
+  s.sa_flags = SA_SIGINFO;
+  int ret = sigaction(SIGSEGV, &s, &old_segv);
+  Assert(ret == 0, "Can not set signal handler");
+#endif
+}
+#endif
+
 void init_mem() {
 #if defined(CONFIG_PMEM_MALLOC)
   pmem = malloc(CONFIG_MSIZE);
   assert(pmem);
+#elif defined(CONFIG_PMEM_MMAP)
+  pmem_mmap();
+#endif
+#if defined(CONFIG_MEM_RANDOM) && !defined(CONFIG_PMEM_MMAP)
+  for (size_t i = 0; i < NR_CHUNK; i++) fill_chunk(i);
 #endif
-  IFDEF(CONFIG_MEM_RANDOM, memset(pmem, rand(), CONFIG_MSIZE));
   Log("physical memory area [" FMT_PADDR ", " FMT_PADDR "]", PMEM_LEFT, PMEM_RIGHT);
 }
 
-word_t paddr_read(paddr_t addr, int len) {
+static inline word_t paddr_read_raw(paddr_t addr, int len) {
   if (likely(in_pmem(addr))) { return pmem_read(addr, len); }
   IFDEF(CONFIG_DEVICE, return mmio_read(addr, len));
   out_of_bound(addr);
   return 0;
 }
 
-void paddr_write(paddr_t addr, int len, word_t data) {
+static inline void paddr_write_raw(paddr_t addr, int len, word_t data) {
   if (likely(in_pmem(addr))) { pmem_write(addr, len, data); return; }
   IFDEF(CONFIG_DEVICE, mmio_write(addr, len, data); return);
   out_of_bound(addr);
 }
+
+// 不开 CONFIG_HOSTPERF 时 HOSTPERF() 什么也不做, 和直接调用一样
+word_t paddr_read(paddr_t addr, int len) {
+  word_t data;
+  HOSTPERF(HP_MEM, data = paddr_read_raw(addr, len));
+  return data;
+}
+
+void paddr_write(paddr_t addr, int len, word_t data) {
+  HOSTPERF(HP_MEM, paddr_write_raw(addr, len, data));
+}
+
+#define PADDR_ACCESSOR(bits) \
+  static inline word_t paddr_read##bits##_raw(paddr_t addr) { \
+    if (likely(in_pmem(addr))) { return host_read##bits(guest_to_host(addr)); } \
+    IFDEF(CONFIG_DEVICE, return mmio_read(addr, bits / 8)); \
+    out_of_bound(addr); \
+    return 0; \
+  } \
+  static inline void paddr_write##bits##_raw(paddr_t addr, word_t data) { \
+    if (likely(in_pmem(addr))) { host_write##bits(guest_to_host(addr), data); return; } \
+    IFDEF(CONFIG_DEVICE, mmio_write(addr, bits / 8, data); return); \
+    out_of_bound(addr); \
+  } \
+  word_t paddr_read##bits(paddr_t addr) { \
+    word_t data; \
+    HOSTPERF(HP_MEM, data = paddr_read##bits##_raw(addr)); \
+    return data; \
+  } \
+  void paddr_write##bits(paddr_t addr, word_t data) { \
+    HOSTPERF(HP_MEM, paddr_write##bits##_raw(addr, data)); \
+  }
+
+PADDR_ACCESSOR(8)
+PADDR_ACCESSOR(16)
+PADDR_ACCESSOR(32)
+IFDEF(CONFIG_ISA64, PADDR_ACCESSOR(64))
@@ -15,12 +15,17 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <cachesim.h>
+#include <watchpoint.h>
 #ifdef CONFIG_MTRACE
 #include <cpu/cpu.h>
 #endif
 
 #ifdef CONFIG_MTRACE
 #include <utils/ringbuf.h>
+#include <utils/tracelog.h>
+
+bool trace_enable();
 
 #define MTRACE_BUF_SIZE 16
 
@@ -40,6 +45,12 @@ static RINGBUF_DEFINE(MtraceItem, MTRACE_BUF_SIZE) mtrace_buf = RINGBUF_INIT;
 static void mtrace_push(char type, vaddr_t addr, int len, word_t data, word_t pc) {
   RINGBUF_PUSH(mtrace_buf, MTRACE_BUF_SIZE,
       ((MtraceItem){.addr = addr, .len = len, .data = data, .type = type, .pc = pc}));
+#ifdef CONFIG_TRACE_THREAD
+  if (trace_enable()) {
+    tracelog_push(&(TraceRec){ .type = TREC_MEM, .kind = type, .len = len, .pc = pc,
+                               .mem = { .addr = addr, .data = data } });
+  }
+#endif
 }
 
 void mtrace_dump(void) {
@@ -57,25 +68,58 @@ void mtrace_dump(void) {
 }
 #endif
 
-word_t vaddr_ifetch(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
-}
-
-word_t vaddr_read(vaddr_t addr, int len) {
-  word_t data = paddr_read(addr, len);
+static inline void read_hook(vaddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_CACHESIM, cachesim_access(CACHESIM_READ, addr));
 #ifdef CONFIG_MTRACE
-  if (CONFIG_MTRACE_COND) {
+  if (g_trace_on && CONFIG_MTRACE_COND) {
     mtrace_push('R', addr, len, data, cpu.pc);
   }
 #endif
-  return data;
 }
 
-void vaddr_write(vaddr_t addr, int len, word_t data) {
+static inline void write_hook(vaddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_CACHESIM, cachesim_access(CACHESIM_WRITE, addr));
+  IFDEF(CONFIG_WATCHPOINT, wp_mem_write(addr, len));
 #ifdef CONFIG_MTRACE
-  if (CONFIG_MTRACE_COND) {
+  if (g_trace_on && CONFIG_MTRACE_COND) {
     mtrace_push('W', addr, len, data, cpu.pc);
   }
 #endif
+}
+
+word_t vaddr_ifetch(vaddr_t addr, int len) {
+  IFDEF(CONFIG_CACHESIM, cachesim_access(CACHESIM_IFETCH, addr));
+  return paddr_read(addr, len);
+}
+
+word_t vaddr_ifetch32(vaddr_t addr) {
+  IFDEF(CONFIG_CACHESIM, cachesim_access(CACHESIM_IFETCH, addr));
+  return paddr_read32(addr);
+}
+
+word_t vaddr_read(vaddr_t addr, int len) {
+  word_t data = paddr_read(addr, len);
+  read_hook(addr, len, data);
+  return data;
+}
+
+void vaddr_write(vaddr_t addr, int len, word_t data) {
+  write_hook(addr, len, data);
   paddr_write(addr, len, data);
 }
+
+#define VADDR_ACCESSOR(bits) \
+  word_t vaddr_read##bits(vaddr_t addr) { \
+    word_t data = paddr_read##bits(addr); \
+    read_hook(addr, bits / 8, data); \
+    return data; \
+  } \
+  void vaddr_write##bits(vaddr_t addr, word_t data) { \
+    write_hook(addr, bits / 8, data); \
+    paddr_write##bits(addr, data); \
+  }
+
+VADDR_ACCESSOR(8)
+VADDR_ACCESSOR(16)
+VADDR_ACCESSOR(32)
+IFDEF(CONFIG_ISA64, VADDR_ACCESSOR(64))
@@ -0,0 +1,123 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// 把镜像装入 pmem: ELF 按 PT_LOAD 段装入, 其他文件当作从 RESET_VECTOR 开始的平坦镜像
+// 页对齐的部分用 mmap(MAP_PRIVATE | MAP_FIXED) 直接映射到 pmem 上, 只有被访问的页才会读盘,
+// 写时复制不会改到文件; .bss 的页对齐部分映射为匿名页, 同样在第一次访问时才清零.
+// 首尾不满一页的部分用 pread/memset, 以免覆盖同一页中其他段的内容
+
+#include <isa.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <memory/paddr.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HOST_PAGE 4096
+#define ALIGN_UP(x) (((uintptr_t)(x) + HOST_PAGE - 1) & ~(uintptr_t)(HOST_PAGE - 1))
+#define ALIGN_DOWN(x) ((uintptr_t)(x) & ~(uintptr_t)(HOST_PAGE - 1))
+
+typedef MUXDEF(CONFIG_ISA64, Elf64_Ehdr, Elf32_Ehdr) Ehdr;
+typedef MUXDEF(CONFIG_ISA64, Elf64_Phdr, Elf32_Phdr) Phdr;
+
+static void read_at(int fd, uint8_t *dst, size_t size, off_t off) {
+  while (size > 0) {
+    ssize_t n = pread(fd, dst, size, off);
+    Assert(n > 0, "Can not read the image");
+    dst += n;
+    size -= n;
+    off += n;
+  }
+}
+
+// 把文件 [off, off + filesz) 装到 paddr, 之后到 memsz 为止清零
+static void load_segment(int fd, off_t off, paddr_t paddr, size_t filesz, size_t memsz) {
+  Assert(memsz == 0 || (in_pmem(paddr) && in_pmem(paddr + memsz - 1)),
+      "segment [" FMT_PADDR ", " FMT_PADDR ") is out of pmem", paddr, (paddr_t)(paddr + memsz));
+  pmem_claim(paddr, memsz);
+  uint8_t *start = guest_to_host(paddr), *end = start + filesz;
+  uint8_t *lo = (uint8_t *)ALIGN_UP(start), *hi = (uint8_t *)ALIGN_DOWN(end);
+  // 文件偏移和 pmem 中的地址要在页内对齐, 否则只能全部读进来
+  if (((uintptr_t)start - off) % HOST_PAGE == 0 && lo < hi) {
+    read_at(fd, start, lo - start, off);
+    void *p = mmap(lo, hi - lo, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, off + (lo - start));
+    Assert(p == lo, "Can not map the image");
+    read_at(fd, hi, end - hi, off + (hi - start));
+  } else {
+    read_at(fd, start, filesz, off);
+  }
+
+  uint8_t *bss_end = start + memsz;
+  lo = (uint8_t *)ALIGN_UP(end);
+  hi = (uint8_t *)ALIGN_DOWN(bss_end);
+  if (lo < hi) {
+    memset(end, 0, lo - end);
+    void *p = mmap(lo, hi - lo, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    Assert(p == lo, "Can not map .bss");
+    memset(hi, 0, bss_end - hi);
+  } else if (bss_end > end) {
+    memset(end, 0, bss_end - end);
+  }
+}
+
+static long load_elf(int fd, const char *file) {
+  Ehdr eh;
+  read_at(fd, (uint8_t *)&eh, sizeof(eh), 0);
+  Assert(eh.e_ident[EI_CLASS] == MUXDEF(CONFIG_ISA64, ELFCLASS64, ELFCLASS32) && eh.e_machine == EM_RISCV,
+      "'%s' is not an ELF file for this ISA", file);
+
+  paddr_t img_end = RESET_VECTOR;
+  for (int i = 0; i < eh.e_phnum; i++) {
+    Phdr ph;
+    read_at(fd, (uint8_t *)&ph, sizeof(ph), eh.e_phoff + (off_t)i * eh.e_phentsize);
+    if (ph.p_type != PT_LOAD || ph.p_memsz == 0) continue;
+    load_segment(fd, ph.p_offset, ph.p_paddr, ph.p_filesz, ph.p_memsz);
+    Log("load segment [" FMT_PADDR ", " FMT_PADDR "), file size = %ld", (paddr_t)ph.p_paddr,
+        (paddr_t)(ph.p_paddr + ph.p_memsz), (long)ph.p_filesz);
+    if (ph.p_paddr + ph.p_memsz > img_end) img_end = ph.p_paddr + ph.p_memsz;
+  }
+
+  cpu.pc = eh.e_entry;
+  Log("The image is %s (ELF), entry = " FMT_WORD, file, cpu.pc);
+  return img_end - RESET_VECTOR; // difftest 从 RESET_VECTOR 开始复制这么多字节
+}
+
+bool image_is_elf(const char *file) {
+  uint8_t magic[SELFMAG];
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) return false;
+  bool ret = read(fd, magic, SELFMAG) == SELFMAG && memcmp(magic, ELFMAG, SELFMAG) == 0;
+  close(fd);
+  return ret;
+}
+
+long load_image(const char *file) {
+  int fd = open(file, O_RDONLY);
+  Assert(fd >= 0, "Can not open '%s'", file);
+
+  long size;
+  if (image_is_elf(file)) {
+    size = load_elf(fd, file);
+  } else {
+    struct stat st;
+    fstat(fd, &st);
+    size = st.st_size;
+    Log("The image is %s, size = %ld", file, size);
+    load_segment(fd, 0, RESET_VECTOR, size, size);
+  }
+  close(fd); // 映射在 close 之后仍然有效
+  return size;
+}
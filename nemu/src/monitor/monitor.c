@@ -15,7 +15,14 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <cpu/cpu.h>
 #include <ftrace.h>
+#include <simpoint.h>
+#include <pcprof.h>
+#include <hostperf.h>
+#include <cachesim.h>
+#include <bpsim.h>
+#include <utils/itrace-bin.h>
 
 void init_rand();
 void init_log(const char *log_file);
@@ -39,11 +46,24 @@ static void welcome() {
 #include <getopt.h>
 
 void sdb_set_batch_mode();
+long load_image(const char *file);
+void gdbstub_set_addr(const char *addr);
 
 static char *log_file = NULL;
 static char *diff_so_file = NULL;
 static char *img_file = NULL;
 static int difftest_port = 1234;
+static char *simpoint_profile_dir = NULL;
+static char *simpoint_ckpt_dir = NULL;
+#ifdef CONFIG_ITRACE_BINARY
+static char *itrace_file = NULL;
+#endif
+#ifdef CONFIG_FTRACE_PROFILE
+static char *profile_file = NULL;
+#endif
+#ifdef CONFIG_HOSTPERF
+static char *hostperf_file = NULL;
+#endif
 
 static long load_img() {
   if (img_file == NULL) {
@@ -51,20 +71,7 @@ static long load_img() {
     return 4096; // built-in image size
   }
 
-  FILE *fp = fopen(img_file, "rb");
-  Assert(fp, "Can not open '%s'", img_file);
-
-  fseek(fp, 0, SEEK_END);
-  long size = ftell(fp);
-
-  Log("The image is %s, size = %ld", img_file, size);
-
-  fseek(fp, 0, SEEK_SET);
-  int ret = fread(guest_to_host(RESET_VECTOR), size, 1, fp);
-  assert(ret == 1);
-
-  fclose(fp);
-  return size;
+  return load_image(img_file); // ELF 或者平坦的 .bin
 }
 
 static int parse_args(int argc, char *argv[]) {
@@ -74,6 +81,23 @@ static int parse_args(int argc, char *argv[]) {
     {"diff"     , required_argument, NULL, 'd'},
     {"port"     , required_argument, NULL, 'p'},
     {"help"     , no_argument      , NULL, 'h'},
+    {"no-trace" , no_argument      , NULL, 'T'},
+#ifdef CONFIG_SIMPOINT
+    {"simpoint-profile", required_argument, NULL, 'S'},
+    {"simpoint-ckpt"   , required_argument, NULL, 'C'},
+#endif
+#ifdef CONFIG_ITRACE_BINARY
+    {"itrace"   , required_argument, NULL, 'i'},
+#endif
+#ifdef CONFIG_FTRACE_PROFILE
+    {"profile"  , required_argument, NULL, 'P'},
+#endif
+#ifdef CONFIG_GDBSTUB
+    {"gdb"      , required_argument, NULL, 'g'},
+#endif
+#ifdef CONFIG_HOSTPERF
+    {"hostperf" , required_argument, NULL, 'H'},
+#endif
     {0          , 0                , NULL,  0 },
   };
   int o;
@@ -83,6 +107,23 @@ static int parse_args(int argc, char *argv[]) {
       case 'p': sscanf(optarg, "%d", &difftest_port); break;
       case 'l': log_file = optarg; break;
       case 'd': diff_so_file = optarg; break;
+      case 'T': cpu_set_trace(false); break;
+#ifdef CONFIG_SIMPOINT
+      case 'S': simpoint_profile_dir = optarg; break;
+      case 'C': simpoint_ckpt_dir = optarg; break;
+#endif
+#ifdef CONFIG_ITRACE_BINARY
+      case 'i': itrace_file = optarg; break;
+#endif
+#ifdef CONFIG_FTRACE_PROFILE
+      case 'P': profile_file = optarg; break;
+#endif
+#ifdef CONFIG_GDBSTUB
+      case 'g': gdbstub_set_addr(optarg); break;
+#endif
+#ifdef CONFIG_HOSTPERF
+      case 'H': hostperf_file = optarg; break;
+#endif
       case 1: img_file = optarg; return 0;
       default:
         printf("Usage: %s [OPTION...] IMAGE [args]\n\n", argv[0]);
@@ -90,6 +131,23 @@ static int parse_args(int argc, char *argv[]) {
         printf("\t-l,--log=FILE           output log to FILE\n");
         printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
         printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
+        printf("\t--no-trace              start with tracing off (see 'trace on' in sdb)\n");
+#ifdef CONFIG_SIMPOINT
+        printf("\t--simpoint-profile=DIR  collect BBV and pick simpoints into DIR\n");
+        printf("\t--simpoint-ckpt=DIR     dump checkpoints of the simpoints in DIR\n");
+#endif
+#ifdef CONFIG_ITRACE_BINARY
+        printf("\t--itrace=FILE           write binary instruction trace to FILE\n");
+#endif
+#ifdef CONFIG_FTRACE_PROFILE
+        printf("\t--profile=FILE          write function profile to FILE and FILE.flat\n");
+#endif
+#ifdef CONFIG_GDBSTUB
+        printf("\t--gdb=PORT|PATH         wait for gdb on localhost:PORT or Unix socket PATH\n");
+#endif
+#ifdef CONFIG_HOSTPERF
+        printf("\t--hostperf=FILE         write the host performance breakdown to FILE as JSON\n");
+#endif
         printf("\n");
         exit(0);
     }
@@ -109,9 +167,22 @@ void init_monitor(int argc, char *argv[]) {
   /* Open the log file. */
   init_log(log_file);
 
+  /* Open the binary instruction trace. */
+  IFDEF(CONFIG_ITRACE_BINARY, init_itrace_bin(itrace_file));
+
   /* Initialize memory. */
   init_mem();
 
+  /* Initialize the per-pc instruction histogram. */
+  IFDEF(CONFIG_PCPROF, init_pcprof());
+
+  /* Initialize the cache and branch predictor models. */
+  init_cachesim();
+  init_bpsim();
+
+  /* Open the host performance counters. */
+  IFDEF(CONFIG_HOSTPERF, init_hostperf(hostperf_file));
+
   /* Initialize devices. */
   IFDEF(CONFIG_DEVICE, init_device());
 
@@ -123,6 +194,10 @@ void init_monitor(int argc, char *argv[]) {
 
   /* Initialize function tracer. */
   IFDEF(CONFIG_FTRACE, init_ftrace(img_file));
+  IFDEF(CONFIG_FTRACE_PROFILE, init_ftrace_profile(profile_file));
+
+  /* Initialize SimPoint profiling or checkpointing. */
+  init_simpoint(simpoint_profile_dir, simpoint_ckpt_dir);
 
   /* Initialize differential testing. */
   init_difftest(diff_so_file, img_size, difftest_port);
@@ -0,0 +1,148 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <breakpoint.h>
+#include "sdb.h"
+
+#define NR_BP 32
+
+typedef struct breakpoint {
+  int NO;
+  struct breakpoint *next;
+
+  vaddr_t addr;
+  char cond[1024]; // 条件, 为空时无条件
+  ExprProg prog;   // 编译后的条件
+  uint64_t hits;
+} BP;
+
+static BP bp_pool[NR_BP] = {};
+static BP *head = NULL, *free_ = NULL;
+
+uint64_t bp_bitmap[BP_BITMAP_BITS / 64] = {};
+
+void init_bp_pool() {
+  for (int i = 0; i < NR_BP; i ++) {
+    bp_pool[i].NO = i;
+    bp_pool[i].next = (i == NR_BP - 1 ? NULL : &bp_pool[i + 1]);
+  }
+
+  head = NULL;
+  free_ = bp_pool;
+}
+
+static void bitmap_set(vaddr_t addr, bool set) {
+  paddr_t i = (addr - PMEM_LEFT) >> 2;
+  if (set) { bp_bitmap[i / 64] |= 1ull << (i % 64); }
+  else { bp_bitmap[i / 64] &= ~(1ull << (i % 64)); }
+}
+
+int add_breakpoint(vaddr_t addr, const char *cond) {
+  if (!in_pmem(addr) || (addr & 0x3) != 0) {
+    printf("invalid breakpoint address " FMT_WORD "\n", addr);
+    return -1;
+  }
+  if (free_ == NULL) {
+    printf("breakpoint pool is full\n");
+    return -1;
+  }
+
+  ExprProg prog = {};
+  if (cond != NULL && !expr_compile(cond, &prog)) {
+    printf("invalid condition, breakpoint not set: %s\n", parse_error_msg);
+    return -1;
+  }
+
+  BP *bp = free_;
+  free_ = free_->next;
+  bp->next = head;
+  head = bp;
+
+  bp->addr = addr;
+  bp->hits = 0;
+  bp->prog = prog;
+  snprintf(bp->cond, sizeof(bp->cond), "%s", cond ? cond : "");
+  bitmap_set(addr, true);
+
+  printf("breakpoint %d at " FMT_WORD "%s%s\n", bp->NO, addr, cond ? " if " : "", bp->cond);
+  return bp->NO;
+}
+
+bool delete_breakpoint(int no) {
+  BP *prev = NULL;
+  BP *cur = head;
+  while (cur != NULL && cur->NO != no) {
+    prev = cur;
+    cur = cur->next;
+  }
+
+  if (cur == NULL) {
+    printf("breakpoint %d not found\n", no);
+    return false;
+  }
+
+  if (prev == NULL) {
+    head = cur->next;
+  } else {
+    prev->next = cur->next;
+  }
+  expr_free(&cur->prog);
+  cur->next = free_;
+  free_ = cur;
+
+  // 同一地址可能还有别的断点
+  bool still = false;
+  for (BP *p = head; p != NULL; p = p->next) { still |= (p->addr == cur->addr); }
+  bitmap_set(cur->addr, still);
+
+  printf("breakpoint %d deleted\n", no);
+  return true;
+}
+
+void list_breakpoints(void) {
+  if (head == NULL) {
+    printf("no breakpoints\n");
+    return;
+  }
+
+  printf("Num\tAddress\t\tHits\tCondition\n");
+  for (BP *cur = head; cur != NULL; cur = cur->next) {
+    printf("%d\t" FMT_WORD "\t%" PRIu64 "\t%s\n", cur->NO, cur->addr, cur->hits, cur->cond);
+  }
+}
+
+// 位图命中之后才会调用, 检查条件; 返回 true 时停下来
+bool check_breakpoint(vaddr_t pc) {
+  bool stop = false;
+  for (BP *cur = head; cur != NULL; cur = cur->next) {
+    if (cur->addr != pc) { continue; }
+    if (cur->prog.code != NULL) {
+      bool success = false;
+      word_t val = expr_run(&cur->prog, &success);
+      if (!success) {
+        printf("breakpoint %d condition evaluation failed: %s\n", cur->NO, parse_error_msg);
+      } else if (!val) {
+        continue;
+      }
+    }
+    cur->hits++;
+    printf("breakpoint %d hit at " FMT_WORD "\n", cur->NO, pc);
+    stop = true;
+  }
+
+  if (stop && nemu_state.state == NEMU_RUNNING) { nemu_state.state = NEMU_STOP; }
+  return stop;
+}
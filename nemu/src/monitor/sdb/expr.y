@@ -2,7 +2,6 @@
 
 %{
 #include <common.h> /* 引入头文件 */
-#include <memory/vaddr.h>
 #include <memory/paddr.h>
 #include <isa.h>
 #include "sdb.h"
@@ -14,22 +13,29 @@ void sdb_expr_delete_buffer(YY_BUFFER_STATE b); /* 释放状态机 */
 int sdb_exprlex_destroy(void); /* 销毁词法分析器 */
 int sdb_exprerror(const char *msg); /* 错误处理 handler */
 
-/* 全局变量 error */
-static word_t parse_result; /* 求值结果 */
+/* 语法分析的同时生成后缀形式的字节码 */
+static ExprOp code_buf[EXPR_CODE_MAX];
+static int code_len, code_depth, code_max_depth;
+static void emit(ExprOp op);
+#define EMIT(...) emit((ExprOp){ __VA_ARGS__ })
 
 /* 报错信息 */
 const char * parse_error_msg = NULL;
 bool parse_error;
 bool sdb_expr_lexer_error; /* yy_lexer_error -> sdb_expr_lexer_error */
-static bool runtime_error;
 
 %}
 
 %define api.prefix {sdb_expr} /* 定义前缀, yy_scan_string -> sdb_expr_scan_string, etc. */
-%define api.value.type {word_t} /* 定义值类型, $x 是 word_t 类型的 */
 %define parse.error verbose /* 定义错误处理方式 */
 
-%token TK_NUM TK_REG
+%union {
+  word_t num;         /* 常数 */
+  const word_t *reg;  /* 寄存器在 cpu 中的位置, 求值时再读 */
+}
+
+%token <num> TK_NUM
+%token <reg> TK_REG
 %token EQ NE LT LE GT GE
 %token AND OR
 
@@ -45,73 +51,155 @@ static bool runtime_error;
 /* BNF: https://craftinginterpreters.com/parsing-expressions.html#design-note */
 
 expression:
-  logic_or { parse_result = $1; }
+  logic_or
   ;
 
 logic_or:
-  logic_and { $$ = $1; }
-  | logic_or OR logic_and { $$ = $1 || $3; }
+  logic_and
+  | logic_or OR logic_and { EMIT(.op = EOP_OR); }
   ;
 
 logic_and:
-  equality { $$ = $1; }
-  | logic_and AND equality { $$ = $1 && $3; }
+  equality
+  | logic_and AND equality { EMIT(.op = EOP_AND); }
   ;
 
 equality:
-  comparison { $$ = $1; }
-  | equality EQ equality { $$ = ((sword_t)$1 == (sword_t)$3); }
-  | equality NE equality { $$ = ((sword_t)$1 != (sword_t)$3); }
+  comparison
+  | equality EQ equality { EMIT(.op = EOP_EQ); }
+  | equality NE equality { EMIT(.op = EOP_NE); }
   ;
 
 comparison:
-  term { $$ = $1; }
-  | comparison LT term { $$ = ((sword_t)$1 <  (sword_t)$3); }
-  | comparison LE term { $$ = ((sword_t)$1 <= (sword_t)$3); }
-  | comparison GT term { $$ = ((sword_t)$1 >  (sword_t)$3); }
-  | comparison GE term { $$ = ((sword_t)$1 >= (sword_t)$3); }
+  term
+  | comparison LT term { EMIT(.op = EOP_LT); }
+  | comparison LE term { EMIT(.op = EOP_LE); }
+  | comparison GT term { EMIT(.op = EOP_GT); }
+  | comparison GE term { EMIT(.op = EOP_GE); }
   ;
 
 term:
-  factor { $$ = $1; }
-  | term '-' factor { $$ = (word_t)((sword_t)$1 - (sword_t)$3); }
-  | term '+' factor { $$ = (word_t)((sword_t)$1 + (sword_t)$3); }
+  factor
+  | term '-' factor { EMIT(.op = EOP_SUB); }
+  | term '+' factor { EMIT(.op = EOP_ADD); }
   ;
 
 factor:
-  unary { $$ = $1; }
-  | factor '*' unary { $$ = (word_t)((sword_t)$1 * (sword_t)$3); }
-  | factor '/' unary { if ($3 == 0) { runtime_error = true; sdb_exprerror("division by zero"); $$ = 0; } else { $$ = (word_t)((sword_t)$1 / (sword_t)$3); } }
+  unary
+  | factor '*' unary { EMIT(.op = EOP_MUL); }
+  | factor '/' unary { EMIT(.op = EOP_DIV); }
   ;
 
 unary:
-  primary { $$ = $1; }
-  | '-' unary %prec UMINUS { $$ = (word_t)(-((sword_t)$2)); }
-  | '*' unary %prec DEREF { if (likely(in_pmem($2))) { $$ = vaddr_read($2, sizeof(word_t)); } else { $$ = 0xdeadbeef; runtime_error = true; sdb_exprerror("invalid memory access"); } } /* 解引用 */
+  primary
+  | '-' unary %prec UMINUS { EMIT(.op = EOP_NEG); }
+  | '*' unary %prec DEREF { EMIT(.op = EOP_DEREF); } /* 解引用 */
   ;
 
 primary:
-  TK_NUM { $$ = $1; }
-  | TK_REG { $$ = $1; }
-  | '(' expression ')' { $$ = $2; }
+  TK_NUM { EMIT(.op = EOP_NUM, .num = $1); }
+  | TK_REG { EMIT(.op = EOP_REG, .reg = $1); }
+  | '(' expression ')'
   ;
 
 %%
 
-word_t expr_eval(const char *expr_str, bool *success) {
-  parse_result = 0;
+static void emit(ExprOp op) {
+  if (code_len == EXPR_CODE_MAX) {
+    if (!parse_error) { sdb_exprerror("expression too long"); }
+    return;
+  }
+  code_buf[code_len++] = op;
+  // NUM/REG 压栈, NEG/DEREF 不变, 其余的二元运算弹出一个
+  code_depth += (op.op == EOP_NUM || op.op == EOP_REG) ? 1 : (op.op == EOP_NEG || op.op == EOP_DEREF) ? 0 : -1;
+  if (code_depth > code_max_depth) { code_max_depth = code_depth; }
+}
+
+bool expr_compile(const char *expr_str, ExprProg *prog) {
+  code_len = code_depth = code_max_depth = 0;
   parse_error = false;
   sdb_expr_lexer_error = false; /* 词法分析错误: 无效字符, 无效寄存器 */
-  runtime_error = false; /* 运行时错误: 除以0 或者无效的解引用 */
 
   YY_BUFFER_STATE buf = sdb_expr_scan_string(expr_str);
-  int ret = sdb_exprparse(); /* 表达式求值 */
+  int ret = sdb_exprparse();
   sdb_expr_delete_buffer(buf);
   sdb_exprlex_destroy(); /* 销毁词法分析器 */
 
-  bool ok = (ret == 0) && !parse_error && !sdb_expr_lexer_error && !runtime_error;
-  if (success) { *success = ok; }
-  return ok ? parse_result : -1;
+  bool ok = (ret == 0) && !parse_error && !sdb_expr_lexer_error;
+  if (ok && code_max_depth > EXPR_STACK_MAX) {
+    sdb_exprerror("expression too complex");
+    ok = false;
+  }
+  if (!ok) { return false; }
+
+  prog->len = code_len;
+  prog->code = malloc(sizeof(ExprOp) * code_len);
+  Assert(prog->code, "no memory");
+  memcpy(prog->code, code_buf, sizeof(ExprOp) * code_len);
+  return true;
+}
+
+void expr_free(ExprProg *prog) {
+  free(prog->code);
+  prog->code = NULL;
+  prog->len = 0;
+}
+
+word_t expr_run(const ExprProg *prog, bool *success) {
+  word_t stack[EXPR_STACK_MAX];
+  int sp = 0;
+#define BIN(expr) do { word_t b = stack[--sp], a = stack[sp - 1]; stack[sp - 1] = (expr); (void)a; (void)b; } while (0)
+  for (const ExprOp *p = prog->code, *end = p + prog->len; p < end; p++) {
+    switch (p->op) {
+      case EOP_NUM: stack[sp++] = p->num; break;
+      case EOP_REG: stack[sp++] = *p->reg; break;
+      case EOP_NEG: stack[sp - 1] = (word_t)(-(sword_t)stack[sp - 1]); break;
+      case EOP_DEREF:
+        if (unlikely(!in_pmem(stack[sp - 1]))) {
+          parse_error_msg = "invalid memory access";
+          goto fail;
+        }
+        stack[sp - 1] = paddr_read(stack[sp - 1], sizeof(word_t));
+        break;
+      case EOP_ADD: BIN((word_t)((sword_t)a + (sword_t)b)); break;
+      case EOP_SUB: BIN((word_t)((sword_t)a - (sword_t)b)); break;
+      case EOP_MUL: BIN((word_t)((sword_t)a * (sword_t)b)); break;
+      case EOP_DIV:
+        if (unlikely(stack[sp - 1] == 0)) {
+          parse_error_msg = "division by zero";
+          goto fail;
+        }
+        BIN((word_t)((sword_t)a / (sword_t)b));
+        break;
+      case EOP_EQ: BIN(a == b); break;
+      case EOP_NE: BIN(a != b); break;
+      case EOP_LT: BIN((sword_t)a <  (sword_t)b); break;
+      case EOP_LE: BIN((sword_t)a <= (sword_t)b); break;
+      case EOP_GT: BIN((sword_t)a >  (sword_t)b); break;
+      case EOP_GE: BIN((sword_t)a >= (sword_t)b); break;
+      case EOP_AND: BIN(a && b); break;
+      case EOP_OR: BIN(a || b); break;
+      default: panic("bad expression opcode %d", p->op);
+    }
+  }
+#undef BIN
+  if (success) { *success = true; }
+  return stack[0];
+
+fail:
+  if (success) { *success = false; }
+  return -1;
+}
+
+word_t expr_eval(const char *expr_str, bool *success) {
+  ExprProg prog;
+  if (!expr_compile(expr_str, &prog)) {
+    if (success) { *success = false; }
+    return -1;
+  }
+  word_t val = expr_run(&prog, success);
+  expr_free(&prog);
+  return val;
 }
 
 int sdb_exprerror(const char *msg) {
@@ -119,4 +207,3 @@ int sdb_exprerror(const char *msg) {
   parse_error_msg = msg;
   return -1;
 }
-
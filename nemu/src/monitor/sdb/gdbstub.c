@@ -0,0 +1,125 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// GDB 远程串行协议 (RSP) 的 NEMU 端, 代替 sdb 作为调试前端:
+//   nemu --gdb=1234 IMAGE             监听 127.0.0.1:1234
+//   nemu --gdb=/tmp/nemu.sock IMAGE   监听 Unix socket
+//   riscv64-linux-gnu-gdb -ex 'target remote :1234' prog.elf
+// 协议层在 tools/gdbstub/rsp.c 中, 和 NPC 共用; 这里只提供访问 NEMU 的回调.
+// 断点 (Z0/Z1) 直接放进 sdb 的断点表, continue 时整段地执行, 中间不经过 gdb
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <memory/paddr.h>
+#include <watchpoint.h>
+#include <rsp.h>
+#include "sdb.h"
+
+#define RUN_CHUNK (1 << 20) // continue 时每执行这么多条指令检查一次 Ctrl-C
+
+extern uint64_t g_nr_guest_inst;
+
+static const char *gdb_addr = NULL;
+
+// gdb 的断点地址 -> sdb 的断点编号
+static struct { vaddr_t addr; int no; } gdb_bps[64];
+static int nr_gdb_bps = 0;
+
+void gdbstub_set_addr(const char *addr) { gdb_addr = addr; }
+bool gdbstub_enabled() { return gdb_addr != NULL; }
+
+static bool reg_read(int n, word_t *val) {
+  if (n < ARRLEN(cpu.gpr)) { *val = cpu.gpr[n]; return true; }
+  if (n == RSP_PC) { *val = cpu.pc; return true; }
+  return false;
+}
+
+// 和指令写寄存器/内存一样通知监视点, 下一条指令之后就会检查
+static bool reg_write(int n, word_t val) {
+  if (n < ARRLEN(cpu.gpr)) {
+    cpu.gpr[n] = val;
+    IFDEF(CONFIG_WATCHPOINT, wp_reg_write(n));
+    return true;
+  }
+  if (n == RSP_PC) { cpu.pc = val; return true; }
+  return false;
+}
+
+static bool mem_ok(paddr_t addr, word_t len) {
+  return in_pmem(addr) && (len == 0 || in_pmem(addr + len - 1));
+}
+
+static bool mem_read(paddr_t addr, uint8_t *buf, word_t len) {
+  if (!mem_ok(addr, len)) { return false; }
+  memcpy(buf, guest_to_host(addr), len);
+  return true;
+}
+
+static bool mem_write(paddr_t addr, const uint8_t *buf, word_t len) {
+  if (!mem_ok(addr, len)) { return false; }
+  memcpy(guest_to_host(addr), buf, len);
+  IFDEF(CONFIG_WATCHPOINT, wp_mem_write(addr, len));
+  return true;
+}
+
+static bool bp_set(vaddr_t addr, bool set) {
+  if (set) {
+    if (nr_gdb_bps == ARRLEN(gdb_bps)) { return false; }
+    int no = add_breakpoint(addr, NULL);
+    if (no < 0) { return false; }
+    gdb_bps[nr_gdb_bps].addr = addr;
+    gdb_bps[nr_gdb_bps++].no = no;
+    return true;
+  }
+  for (int i = 0; i < nr_gdb_bps; i++) {
+    if (gdb_bps[i].addr == addr) {
+      delete_breakpoint(gdb_bps[i].no);
+      gdb_bps[i] = gdb_bps[--nr_gdb_bps];
+      return true;
+    }
+  }
+  return false;
+}
+
+// 断点 (包括条件) 和监视点都由执行循环检查, 没有执行完 n 条说明停下来了
+static bool run(uint64_t n) {
+  uint64_t start = g_nr_guest_inst;
+  cpu_exec(n);
+  return nemu_state.state != NEMU_STOP || g_nr_guest_inst - start < n;
+}
+
+static RspStatus status(int *exit_code) {
+  switch (nemu_state.state) {
+    case NEMU_END: *exit_code = nemu_state.halt_ret; return RSP_EXITED;
+    case NEMU_QUIT: *exit_code = 0; return RSP_EXITED;
+    case NEMU_ABORT: return RSP_ABORTED;
+    default: return RSP_STOPPED;
+  }
+}
+
+static void quit(void) { nemu_state.state = NEMU_QUIT; }
+
+void gdbstub_mainloop() {
+  static const RspTarget target = {
+    .run_chunk = RUN_CHUNK,
+    .reg_read = reg_read, .reg_write = reg_write,
+    .mem_read = mem_read, .mem_write = mem_write,
+    .bp_set = bp_set, .exec = run, .status = status, .kill = quit,
+  };
+  rsp_serve(gdb_addr, &target);
+
+  // gdb detach 之后继续运行到结束
+  if (nemu_state.state == NEMU_STOP || nemu_state.state == NEMU_RUNNING) { cpu_exec(-1); }
+}
@@ -141,6 +141,72 @@ static int cmd_d(char *args) {
   return 0;
 }
 
+#ifdef CONFIG_BREAKPOINT
+// b ADDR [if COND]
+static int cmd_b(char *args) {
+  if (args == NULL) {
+    printf("usage: b ADDR [if COND]\n");
+    return 0;
+  }
+
+  char *cond = strstr(args, " if ");
+  if (cond != NULL) {
+    *cond = '\0';
+    cond += strlen(" if ");
+  }
+
+  bool success = false;
+  vaddr_t addr = expr_eval(args, &success);
+  if (!success) {
+    printf("expression evaluation failed: %s\n", parse_error_msg);
+    return 0;
+  }
+  add_breakpoint(addr, cond);
+  return 0;
+}
+
+static int cmd_db(char *args) {
+  if (args == NULL) {
+    printf("usage: db N\n");
+    return 0;
+  }
+
+  int no = strtol(args, NULL, 0);
+  delete_breakpoint(no);
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_SNAPSHOT
+static int cmd_rewind(char *args) {
+  uint64_t n = 1;
+  if (args != NULL) {
+    n = strtoull(args, NULL, 0);
+    if (n == 0) {
+      printf("invalid number of instructions: %s\n", args);
+      return 0;
+    }
+  }
+  snapshot_rewind(n); // 成功的话不会返回, 由快照进程接管
+  return 0;
+}
+
+static int cmd_rs(char *args) {
+  return cmd_rewind(NULL);
+}
+#endif
+
+static int cmd_trace(char *args) {
+  if (args != NULL && strcmp(args, "on") == 0) {
+    cpu_set_trace(true);
+  } else if (args != NULL && strcmp(args, "off") == 0) {
+    cpu_set_trace(false);
+  } else {
+    printf("usage: trace on|off\n");
+  }
+  return 0;
+}
+
 static int cmd_help(char *args);
 
 enum {
@@ -153,6 +219,16 @@ enum {
   CMD_P,
   CMD_W,
   CMD_D,
+  CMD_TRACE,
+#ifdef CONFIG_BREAKPOINT
+  CMD_B,
+  CMD_DB,
+#endif
+#ifdef CONFIG_SNAPSHOT
+  CMD_REWIND,
+  CMD_REVERSE_STEP,
+  CMD_RS,
+#endif
   NR_CMD,
 };
 
@@ -170,6 +246,16 @@ static struct {
   [CMD_P]    = { "p", "print expression", cmd_p }, // p EXPR
   [CMD_W]    = { "w", "watchpoint expression", cmd_w }, // w EXPR
   [CMD_D]    = { "d", "delete watchpoint", cmd_d }, // d N
+  [CMD_TRACE] = { "trace", "Turn tracing on or off", cmd_trace }, // trace on|off
+#ifdef CONFIG_BREAKPOINT
+  [CMD_B]    = { "b", "Set a breakpoint, optionally with a condition", cmd_b }, // b ADDR [if COND]
+  [CMD_DB]   = { "db", "delete breakpoint", cmd_db }, // db N
+#endif
+#ifdef CONFIG_SNAPSHOT
+  [CMD_REWIND]       = { "rewind", "Go back N instructions by replaying from the nearest snapshot", cmd_rewind }, // rewind [N]
+  [CMD_REVERSE_STEP] = { "reverse-step", "Step back one instruction", cmd_rs },
+  [CMD_RS]           = { "rs", "Alias of reverse-step", cmd_rs },
+#endif
 };
 
 #define NR_CMD ARRLEN(cmd_table)
@@ -204,6 +290,14 @@ static int cmd_info(char *args) {
     isa_reg_display();
   } else if (0 == strcmp(args, "w")) {
     list_watchpoints();
+#ifdef CONFIG_BREAKPOINT
+  } else if (0 == strcmp(args, "b")) {
+    list_breakpoints();
+#endif
+#ifdef CONFIG_SNAPSHOT
+  } else if (0 == strcmp(args, "s")) {
+    list_snapshots();
+#endif
   } else {
     printf("Unknown subcommand '%s'\n", args);
     printf("%s - %s\n", cmd_table[CMD_INFO].name, cmd_table[CMD_INFO].description);
@@ -276,4 +370,9 @@ void sdb_mainloop() {
 void init_sdb() {
   /* Initialize the watchpoint pool. */
   init_wp_pool();
+
+  /* Initialize the breakpoint pool. */
+  IFDEF(CONFIG_BREAKPOINT, init_bp_pool());
+
+  IFDEF(CONFIG_SNAPSHOT, init_snapshot());
 }
@@ -18,12 +18,56 @@
 
 #include <common.h>
 
+// 编译后的表达式: 后缀形式的字节码, 求值时不再经过 flex/bison
+enum {
+  EOP_NUM, EOP_REG, EOP_NEG, EOP_DEREF,
+  EOP_ADD, EOP_SUB, EOP_MUL, EOP_DIV,
+  EOP_EQ, EOP_NE, EOP_LT, EOP_LE, EOP_GT, EOP_GE,
+  EOP_AND, EOP_OR,
+};
+
+typedef struct {
+  int op;
+  union {
+    word_t num;         // EOP_NUM
+    const word_t *reg;  // EOP_REG
+  };
+} ExprOp;
+
+typedef struct {
+  ExprOp *code;
+  int len;
+} ExprProg;
+
+#define EXPR_CODE_MAX 256
+#define EXPR_STACK_MAX 32
+
+bool expr_compile(const char *expr, ExprProg *prog);
+word_t expr_run(const ExprProg *prog, bool *success);
+void expr_free(ExprProg *prog);
 word_t expr_eval(const char *expr, bool *success);
 void init_wp_pool(void);
 int add_watchpoint(const char *expr);
 bool delete_watchpoint(int no);
 void list_watchpoints(void);
 bool check_watchpoints(void);
+void sync_watchpoints(void);
+
+#ifdef CONFIG_BREAKPOINT
+void init_bp_pool(void);
+int add_breakpoint(vaddr_t addr, const char *cond);
+bool delete_breakpoint(int no);
+void list_breakpoints(void);
+#endif
+
+#ifdef CONFIG_SNAPSHOT
+void init_snapshot(void);
+bool snapshot_step(void);
+bool snapshot_replaying(void);
+void snapshot_end_replay(void);
+void snapshot_rewind(uint64_t n);
+void list_snapshots(void);
+#endif
 
 extern const char * parse_error_msg;
 
@@ -0,0 +1,204 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// 基于 fork 的快照, 用于 sdb 的 rewind / rs
+// 每执行 CONFIG_SNAPSHOT_INTERVAL 条指令 fork 一次, 子进程就是快照:
+// 它阻塞在 cmd 管道上, 内存 (包括 pmem) 与父进程写时复制, 几乎不占额外空间.
+// rewind 时, 当前进程丢弃更新的快照, 把目标指令数写给不晚于目标的最新快照,
+// 然后等待它结束并以它的退出状态退出. 被唤醒的快照重放到目标位置后回到 sdb.
+//
+// 快照进程继承了更早快照的管道, 所以被唤醒后可以继续向更早的快照 rewind.
+// 设备的副作用 (例如串口输出) 在重放时会再发生一次.
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utils/tracelog.h>
+#include "sdb.h"
+
+extern uint64_t g_nr_guest_inst;
+int is_exit_status_bad();
+IFDEF(CONFIG_DEVICE, void init_alarm());
+
+typedef struct {
+  pid_t pid;
+  int cmd_fd;    // 写端, 发送目标指令数
+  int done_fd;   // 读端, 接收快照进程的退出状态
+  uint64_t inst; // 快照所在的指令数
+} Snapshot;
+
+static Snapshot snaps[CONFIG_SNAPSHOT_MAX];
+static int nr_snap = 0;
+static uint64_t interval = CONFIG_SNAPSHOT_INTERVAL;
+static uint64_t next_snap = 0;
+
+static bool replaying = false;
+static uint64_t replay_target = 0;
+static int my_done_fd = -1; // 被唤醒之后, 退出时通过它通知上一个进程
+
+static ssize_t read_full(int fd, void *buf, size_t len) {
+  ssize_t r;
+  do { r = read(fd, buf, len); } while (r < 0 && errno == EINTR);
+  return r;
+}
+
+static void drop_snapshot(int i) {
+  kill(snaps[i].pid, SIGKILL);
+  waitpid(snaps[i].pid, NULL, 0); // 不是自己的子进程时会返回 ECHILD, 忽略即可
+  close(snaps[i].cmd_fd);
+  close(snaps[i].done_fd);
+  snaps[i].pid = -1;
+}
+
+static void compact(void) {
+  int n = 0;
+  for (int i = 0; i < nr_snap; i++) {
+    if (snaps[i].pid > 0) snaps[n++] = snaps[i];
+  }
+  nr_snap = n;
+}
+
+static void notify(int status) {
+  if (my_done_fd < 0) return;
+  if (write(my_done_fd, &status, sizeof(status)) != sizeof(status)) { /* 上一个进程已经不在了 */ }
+  close(my_done_fd);
+  my_done_fd = -1;
+}
+
+static void notify_on_exit(void) {
+  notify(is_exit_status_bad());
+}
+
+// 快照进程: 等待被唤醒, 或者在管道关闭/被 kill 时直接退出
+static void wait_for_resume(int cmd_fd, int done_fd) {
+  uint64_t target;
+  if (read_full(cmd_fd, &target, sizeof(target)) != sizeof(target)) { _exit(0); }
+  close(cmd_fd);
+
+  my_done_fd = done_fd;
+  atexit(notify_on_exit);
+  IFDEF(CONFIG_DEVICE, init_alarm()); // fork 不继承定时器
+  tracelog_restart(); // 也不继承写日志的线程
+  replaying = true;
+  replay_target = target;
+  next_snap = g_nr_guest_inst; // 自己已经不再是快照了
+}
+
+static void take_snapshot(void) {
+  if (nr_snap == CONFIG_SNAPSHOT_MAX) {
+    // 满了: 隔一个丢一个, 间隔翻倍, 越早的快照越稀疏
+    for (int i = 1; i < nr_snap; i += 2) drop_snapshot(i);
+    compact();
+    interval *= 2;
+  }
+
+  int cmd[2], done[2];
+  if (pipe(cmd) != 0 || pipe(done) != 0) {
+    printf("snapshot: pipe failed: %s\n", strerror(errno));
+    return;
+  }
+  fflush(NULL); // 否则缓冲区里的内容会在每个进程中各输出一次
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    printf("snapshot: fork failed: %s\n", strerror(errno));
+    close(cmd[0]); close(cmd[1]); close(done[0]); close(done[1]);
+    return;
+  }
+  if (pid == 0) {
+    close(cmd[1]);
+    close(done[0]);
+    wait_for_resume(cmd[0], done[1]);
+    return;
+  }
+
+  close(cmd[0]);
+  close(done[1]);
+  snaps[nr_snap++] = (Snapshot){ .pid = pid, .cmd_fd = cmd[1], .done_fd = done[0], .inst = g_nr_guest_inst };
+}
+
+bool snapshot_step(void) {
+  while (g_nr_guest_inst >= next_snap) {
+    next_snap = g_nr_guest_inst + interval;
+    take_snapshot(); // 被唤醒的快照从这里返回, 并在原地补一个新的快照
+  }
+  if (replaying && g_nr_guest_inst >= replay_target) {
+    replaying = false;
+    sync_watchpoints(); // 重放时没有检查监视点, 更新为当前的值
+    nemu_state.state = NEMU_STOP;
+    printf("rewound to instruction %" PRIu64 ", pc = " FMT_WORD "\n", g_nr_guest_inst, cpu.pc);
+    return true;
+  }
+  return false;
+}
+
+bool snapshot_replaying(void) {
+  return replaying;
+}
+
+// 回到 sdb 之前调用, 重放中程序就结束了的话也要恢复输出和监视点/断点的检查
+void snapshot_end_replay(void) {
+  if (!replaying) return;
+  replaying = false;
+  sync_watchpoints();
+}
+
+void snapshot_rewind(uint64_t n) {
+  uint64_t target = n > g_nr_guest_inst ? 0 : g_nr_guest_inst - n;
+  while (nr_snap > 0) {
+    int i = nr_snap - 1;
+    while (i > 0 && snaps[i].inst > target) i--;
+    if (snaps[i].inst > target) {
+      printf("no snapshot before instruction %" PRIu64 ", rewind to %" PRIu64 " instead\n", target, snaps[i].inst);
+      target = snaps[i].inst;
+    }
+
+    for (int j = nr_snap - 1; j > i; j--) drop_snapshot(j);
+    nr_snap = i + 1;
+
+    tracelog_sync();
+    fflush(NULL);
+    if (write(snaps[i].cmd_fd, &target, sizeof(target)) == sizeof(target)) {
+      // 由被唤醒的快照接管, 等它结束后以它的状态退出
+      int status = 1;
+      read_full(snaps[i].done_fd, &status, sizeof(status));
+      notify(status); // 自己也可能是被唤醒的快照, 把状态继续往上传
+      _exit(status);
+    }
+
+    // 该快照已经被其他进程丢弃了, 试试更早的
+    drop_snapshot(i);
+    nr_snap = i;
+  }
+  printf("no snapshot available\n");
+}
+
+void list_snapshots(void) {
+  if (nr_snap == 0) {
+    printf("no snapshots\n");
+    return;
+  }
+  printf("Num\tInst\tPid\n");
+  for (int i = 0; i < nr_snap; i++) {
+    printf("%d\t%" PRIu64 "\t%d\n", i, snaps[i].inst, snaps[i].pid);
+  }
+}
+
+void init_snapshot(void) {
+  signal(SIGPIPE, SIG_IGN); // 向已经退出的快照写入时返回 EPIPE, 而不是被杀死
+}
@@ -14,6 +14,8 @@
 ***************************************************************************************/
 
 #include <stdio.h>
+#include <isa.h>
+#include <watchpoint.h>
 #include "sdb.h"
 #include "utils.h"
 
@@ -26,11 +28,59 @@ typedef struct watchpoint {
   char expr[1024]; // 记录表达式 
   word_t last_value; // 上一次的值
 
+  ExprProg prog; // 编译后的表达式
+  // 依赖的状态, 见 include/watchpoint.h
+  bool always;
+  uint32_t reg_mask;
+  paddr_t mem_lo, mem_hi;
 } WP;
 
 static WP wp_pool[NR_WP] = {};
 static WP *head = NULL, *free_ = NULL;
 
+uint32_t wp_reg_mask = 0;
+paddr_t wp_mem_lo = -1, wp_mem_hi = 0;
+bool wp_dirty = false;
+static bool wp_always = false;
+
+// 从字节码中找出表达式依赖的寄存器和内存
+static void analyze_deps(WP *wp) {
+  wp->always = false;
+  wp->reg_mask = 0;
+  wp->mem_lo = -1;
+  wp->mem_hi = 0;
+  const ExprOp *code = wp->prog.code;
+  for (int i = 0; i < wp->prog.len; i++) {
+    if (code[i].op == EOP_REG) {
+      int idx = isa_reg_gpr_idx(code[i].reg);
+      if (idx >= 0) { wp->reg_mask |= 1u << idx; }
+      else { wp->always = true; } // pc 和 csr 不只是被指令的 rd 修改
+    } else if (code[i].op == EOP_DEREF) {
+      if (i > 0 && code[i - 1].op == EOP_NUM) { // *常数
+        paddr_t lo = code[i - 1].num, hi = lo + sizeof(word_t) - 1;
+        if (lo < wp->mem_lo) { wp->mem_lo = lo; }
+        if (hi > wp->mem_hi) { wp->mem_hi = hi; }
+      } else {
+        wp->always = true; // 地址要运行时才知道
+      }
+    }
+  }
+}
+
+static void update_deps(void) {
+  wp_always = false;
+  wp_reg_mask = 0;
+  wp_mem_lo = -1;
+  wp_mem_hi = 0;
+  for (WP *cur = head; cur != NULL; cur = cur->next) {
+    wp_always |= cur->always;
+    wp_reg_mask |= cur->reg_mask;
+    if (cur->mem_lo < wp_mem_lo) { wp_mem_lo = cur->mem_lo; }
+    if (cur->mem_hi > wp_mem_hi) { wp_mem_hi = cur->mem_hi; }
+  }
+  wp_reg_mask &= ~1u; // $0 永远不会变
+}
+
 void init_wp_pool() {
   for (int i = 0; i < NR_WP; i ++) {
     wp_pool[i].NO = i;
@@ -41,7 +91,7 @@ void init_wp_pool() {
   free_ = wp_pool;
 }
 
-static WP *new_wp(const char * expr, word_t last_value) {
+static WP *new_wp(const char * expr, const ExprProg *prog, word_t last_value) {
   Assert(free_ != NULL, "watchpoint pool is full");
   WP *wp = free_;
   free_ = free_->next; // pop from free_list
@@ -52,23 +102,34 @@ static WP *new_wp(const char * expr, word_t last_value) {
   strncpy(wp->expr, expr, sizeof(wp->expr) - 1);
   wp->expr[sizeof(wp->expr) - 1] = '\0';
   wp->last_value = last_value;
+  wp->prog = *prog;
+  analyze_deps(wp);
+  update_deps();
   return wp;
 }
 
 static void free_wp(WP *wp) {
+  expr_free(&wp->prog);
   wp->next = free_;
   free_ = wp;
 }
 
 int add_watchpoint(const char *expr) {
-  bool success = true;
-  word_t val = expr_eval(expr, &success);
+  if (free_ == NULL) {
+    printf("watchpoint pool is full\n");
+    return -1;
+  }
+
+  ExprProg prog = {};
+  bool success = expr_compile(expr, &prog);
+  word_t val = success ? expr_run(&prog, &success) : 0;
   if (!success) {
     printf("expression evaluation failed, watchpoint not set: %s\n", expr);
+    expr_free(&prog);
     return -1;
   }
 
-  WP *wp = new_wp(expr, val);
+  WP *wp = new_wp(expr, &prog, val);
   printf("watchpoint %d: %s\ncurrent value = " FMT_WORD "\n", wp->NO, wp->expr, wp->last_value);
   return wp->NO;
 }
@@ -92,6 +153,7 @@ bool delete_watchpoint(int no) {
     prev->next = cur->next;
   }
   free_wp(cur);
+  update_deps();
   printf("watchpoint %d deleted\n", no);
   return true;
 }
@@ -109,11 +171,15 @@ void list_watchpoints(void) {
 }
 
 bool check_watchpoints(void) {
+  if (likely(!wp_dirty && !wp_always)) { return false; }
+  bool dirty = wp_dirty;
+  wp_dirty = false;
   bool triggered = false;
 
   for (WP *cur = head; cur != NULL; cur = cur->next) {
+    if (!dirty && !cur->always) { continue; }
     bool success = false;
-    word_t val = expr_eval(cur->expr, &success);
+    word_t val = expr_run(&cur->prog, &success);
     if (!success) {
       printf("watchpoint %d expression evaluation failed: %s\n", cur->NO, cur->expr);
       continue;
@@ -132,4 +198,14 @@ bool check_watchpoints(void) {
   }
 
   return triggered;
-}
\ No newline at end of file
+}
+
+// 重新计算所有监视点的值, 但不触发
+void sync_watchpoints(void) {
+  wp_dirty = false;
+  for (WP *cur = head; cur != NULL; cur = cur->next) {
+    bool success = false;
+    word_t val = expr_run(&cur->prog, &success);
+    if (success) { cur->last_value = val; }
+  }
+}
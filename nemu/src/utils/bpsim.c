@@ -0,0 +1,122 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// 分支预测器模型: 2 位饱和计数器 (bimodal 或 gshare) + 直接映射的 BTB + RAS
+// 只统计预测的结果, 不影响 NEMU 的行为
+
+#include <bpsim.h>
+
+#define PHT_SIZE (1 << CONFIG_BPSIM_PHT_BITS)
+#define BTB_MASK (CONFIG_BPSIM_BTB_ENTRIES - 1)
+static_assert((CONFIG_BPSIM_BTB_ENTRIES & BTB_MASK) == 0, "CONFIG_BPSIM_BTB_ENTRIES must be a power of 2");
+
+extern uint64_t g_nr_guest_inst;
+
+static uint8_t pht[PHT_SIZE]; // 0,1: 不跳转, 2,3: 跳转
+IFDEF(CONFIG_BPSIM_GSHARE, static uint32_t ghr = 0);
+
+static struct { vaddr_t pc, target; bool valid; } btb[CONFIG_BPSIM_BTB_ENTRIES];
+
+// 满了以后覆盖最老的一项, 和硬件的循环栈一样
+static vaddr_t ras[CONFIG_BPSIM_RAS_DEPTH];
+static int ras_top = 0, ras_cnt = 0;
+
+static struct {
+  uint64_t count, miss;
+} bp_stat[NR_BP_KIND];
+static uint64_t btb_miss = 0; // 方向预测正确, 但是 BTB 给不出正确的目标
+
+static const char *kind_name[] = {
+  [BP_COND] = "branch", [BP_JUMP] = "jump", [BP_CALL] = "call",
+  [BP_RET] = "return", [BP_INDIRECT] = "indirect",
+};
+
+static uint32_t pht_index(vaddr_t pc) {
+  uint32_t idx = pc >> 2;
+  IFDEF(CONFIG_BPSIM_GSHARE, idx ^= ghr);
+  return idx & (PHT_SIZE - 1);
+}
+
+static bool btb_lookup(vaddr_t pc, vaddr_t target) {
+  int i = (pc >> 2) & BTB_MASK;
+  bool hit = btb[i].valid && btb[i].pc == pc && btb[i].target == target;
+  btb[i].pc = pc;
+  btb[i].target = target;
+  btb[i].valid = true;
+  return hit;
+}
+
+static void ras_push(vaddr_t addr) {
+  ras[ras_top] = addr;
+  ras_top = (ras_top + 1) % CONFIG_BPSIM_RAS_DEPTH;
+  if (ras_cnt < CONFIG_BPSIM_RAS_DEPTH) ras_cnt++;
+}
+
+static bool ras_pop(vaddr_t addr) {
+  if (ras_cnt == 0) return false;
+  ras_top = (ras_top + CONFIG_BPSIM_RAS_DEPTH - 1) % CONFIG_BPSIM_RAS_DEPTH;
+  ras_cnt--;
+  return ras[ras_top] == addr;
+}
+
+void bpsim_update(BpKind kind, vaddr_t pc, vaddr_t snpc, vaddr_t dnpc) {
+  bool hit = true;
+  switch (kind) {
+    case BP_COND: {
+      bool taken = dnpc != snpc;
+      uint8_t *c = &pht[pht_index(pc)];
+      hit = (*c >= 2) == taken;
+      if (taken && *c < 3) (*c)++;
+      else if (!taken && *c > 0) (*c)--;
+      IFDEF(CONFIG_BPSIM_GSHARE, ghr = ((ghr << 1) | taken) & ((1u << CONFIG_BPSIM_GHR_BITS) - 1));
+      // 跳转了就要查 (并填入) BTB, 方向预测对了但 BTB 没有目标也算预测失败
+      bool btb_hit = !taken || btb_lookup(pc, dnpc);
+      if (hit && !btb_hit) { hit = false; btb_miss++; }
+      break;
+    }
+    case BP_CALL:
+      ras_push(snpc);
+      // fall through
+    case BP_JUMP: case BP_INDIRECT:
+      hit = btb_lookup(pc, dnpc);
+      if (!hit && kind != BP_INDIRECT) btb_miss++;
+      break;
+    case BP_RET: hit = ras_pop(dnpc); break;
+    default: return;
+  }
+  bp_stat[kind].count++;
+  if (!hit) bp_stat[kind].miss++;
+}
+
+void init_bpsim(void) {
+  memset(pht, 1, sizeof(pht)); // 弱不跳转
+  Log("bpsim: %s with %d counters, %d-entry BTB, %d-entry RAS",
+      MUXDEF(CONFIG_BPSIM_GSHARE, "gshare", "bimodal"), PHT_SIZE,
+      CONFIG_BPSIM_BTB_ENTRIES, CONFIG_BPSIM_RAS_DEPTH);
+}
+
+void bpsim_report(void) {
+  uint64_t count = 0, miss = 0;
+  for (int k = 0; k < NR_BP_KIND; k++) { count += bp_stat[k].count; miss += bp_stat[k].miss; }
+  if (count == 0) return;
+  double kinst = g_nr_guest_inst / 1000.0;
+  for (int k = 0; k < NR_BP_KIND; k++) {
+    if (bp_stat[k].count == 0) continue;
+    Log("bpsim: %-8s %14" PRIu64 ", mispredicted %12" PRIu64 " (%.2f%%)", kind_name[k],
+        bp_stat[k].count, bp_stat[k].miss, bp_stat[k].miss * 100.0 / bp_stat[k].count);
+  }
+  Log("bpsim: total %" PRIu64 " control transfers, %" PRIu64 " mispredicted (%.2f%%, %" PRIu64 " by BTB), MPKI %.2f",
+      count, miss, miss * 100.0 / count, btb_miss, kinst > 0 ? miss / kinst : 0.0);
+}
@@ -0,0 +1,113 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// 简单的 cache 模型, 只统计命中/缺失, 不影响 NEMU 的行为
+// 写策略: 写回 + 写分配, 替换时统计写回次数; 只有 pmem 的访问经过 cache
+
+#include <cachesim.h>
+#include <memory/paddr.h>
+
+#define LINE_BITS __builtin_ctz(CONFIG_CACHESIM_LINE_SIZE)
+static_assert((CONFIG_CACHESIM_LINE_SIZE & (CONFIG_CACHESIM_LINE_SIZE - 1)) == 0,
+    "CONFIG_CACHESIM_LINE_SIZE must be a power of 2");
+
+extern uint64_t g_nr_guest_inst;
+
+typedef struct {
+  paddr_t tag;
+  bool valid, dirty;
+  uint64_t stamp; // LRU: 最近一次访问的时间, FIFO: 装入的时间
+} CacheLine;
+
+typedef struct {
+  const char *name;
+  int sets, ways;
+  CacheLine *lines; // sets * ways
+  uint64_t tick;
+  uint64_t access, miss, writeback;
+} Cache;
+
+static Cache icache = { .name = "I-cache" }, dcache = { .name = "D-cache" };
+
+static void cache_init(Cache *c, int size, int ways) {
+  c->ways = ways;
+  c->sets = size / (ways * CONFIG_CACHESIM_LINE_SIZE);
+  Assert(c->sets > 0 && (c->sets & (c->sets - 1)) == 0,
+      "cachesim: %s has %d sets, which should be a power of 2", c->name, c->sets);
+  c->lines = calloc(c->sets * ways, sizeof(CacheLine));
+  Assert(c->lines, "cachesim: no memory");
+}
+
+static int choose_victim(const CacheLine *set, int ways) {
+  for (int i = 0; i < ways; i++) {
+    if (!set[i].valid) return i;
+  }
+#ifdef CONFIG_CACHESIM_RANDOM
+  return rand() % ways;
+#else
+  int v = 0;
+  for (int i = 1; i < ways; i++) {
+    if (set[i].stamp < set[v].stamp) v = i;
+  }
+  return v;
+#endif
+}
+
+static void cache_access(Cache *c, paddr_t addr, bool is_write) {
+  paddr_t line = addr >> LINE_BITS;
+  CacheLine *set = &c->lines[(line & (c->sets - 1)) * c->ways];
+  c->access++;
+  c->tick++;
+  for (int i = 0; i < c->ways; i++) {
+    if (set[i].valid && set[i].tag == line) {
+      IFDEF(CONFIG_CACHESIM_LRU, set[i].stamp = c->tick);
+      set[i].dirty |= is_write;
+      return;
+    }
+  }
+
+  c->miss++;
+  CacheLine *v = &set[choose_victim(set, c->ways)];
+  if (v->valid && v->dirty) c->writeback++;
+  *v = (CacheLine){ .tag = line, .valid = true, .dirty = is_write, .stamp = c->tick };
+}
+
+void cachesim_access(int type, paddr_t addr) {
+  if (!in_pmem(addr)) return; // 设备不经过 cache
+  if (type == CACHESIM_IFETCH) cache_access(&icache, addr, false);
+  else cache_access(&dcache, addr, type == CACHESIM_WRITE);
+}
+
+void init_cachesim(void) {
+  cache_init(&icache, CONFIG_CACHESIM_ICACHE_SIZE, CONFIG_CACHESIM_ICACHE_WAYS);
+  cache_init(&dcache, CONFIG_CACHESIM_DCACHE_SIZE, CONFIG_CACHESIM_DCACHE_WAYS);
+  Log("cachesim: I-cache %dB %d-way, D-cache %dB %d-way, %dB lines, %s replacement",
+      CONFIG_CACHESIM_ICACHE_SIZE, CONFIG_CACHESIM_ICACHE_WAYS,
+      CONFIG_CACHESIM_DCACHE_SIZE, CONFIG_CACHESIM_DCACHE_WAYS, CONFIG_CACHESIM_LINE_SIZE,
+      MUXDEF(CONFIG_CACHESIM_LRU, "LRU", MUXDEF(CONFIG_CACHESIM_FIFO, "FIFO", "random")));
+}
+
+static void cache_report(const Cache *c) {
+  if (c->access == 0) return;
+  double kinst = g_nr_guest_inst / 1000.0;
+  Log("cachesim: %s %" PRIu64 " accesses, %" PRIu64 " misses (%.2f%%), MPKI %.2f, %" PRIu64 " writebacks",
+      c->name, c->access, c->miss, c->miss * 100.0 / c->access,
+      kinst > 0 ? c->miss / kinst : 0.0, c->writeback);
+}
+
+void cachesim_report(void) {
+  cache_report(&icache);
+  cache_report(&dcache);
+}
@@ -14,50 +14,96 @@
 ***************************************************************************************/
 
 #include <dlfcn.h>
+#include <limits.h>
 #include <capstone/capstone.h>
 #include <common.h>
 
-#define CS_LIB_SUFFIX "so.5"
+// 反汇编结果的缓存, 以 (pc, 指令编码) 为键, 直接映射
+// 同一条指令在循环里会被反复输出 (si, itrace 日志, iringbuf), 只有第一次需要调用 capstone
+#define DISASM_CACHE_SIZE 4096 // 必须是 2 的幂
 
-static size_t (*cs_disasm_dl)(csh handle, const uint8_t *code, size_t code_size, uint64_t address, size_t count, cs_insn **insn);
-static void (*cs_free_dl)(cs_insn *insn, size_t count);
+typedef struct {
+  uint64_t pc;
+  uint32_t inst;
+  int nbyte; // 0 表示无效
+  char str[sizeof(((cs_insn *)0)->mnemonic) + sizeof(((cs_insn *)0)->op_str)];
+} DisasmCacheEntry;
 
-static csh handle;
+static cs_err (*cs_open_dl)(cs_arch arch, cs_mode mode, csh *handle);
+static cs_insn *(*cs_malloc_dl)(csh handle);
+static bool (*cs_disasm_iter_dl)(csh handle, const uint8_t **code, size_t *size, uint64_t *address, cs_insn *insn);
+
+// 每个线程各用一份, 后台写日志的线程也会反汇编
+static __thread DisasmCacheEntry cache[DISASM_CACHE_SIZE];
+static __thread csh handle;
+static __thread cs_insn *insn; // 由 cs_malloc 分配, 反复使用
+
+static void open_handle(void) {
+  cs_arch arch = CS_ARCH_RISCV;
+  cs_mode mode = MUXDEF(CONFIG_ISA64, CS_MODE_RISCV64, CS_MODE_RISCV32) | CS_MODE_RISCVC;
+  int ret = cs_open_dl(arch, mode, &handle);
+  assert(ret == CS_ERR_OK);
+
+  insn = cs_malloc_dl(handle);
+  assert(insn);
+}
 
 void init_disasm() {
-  void *dl_handle;
-  dl_handle = dlopen("tools/capstone/repo/libcapstone." CS_LIB_SUFFIX, RTLD_LAZY);
-  assert(dl_handle);
+  // 相对路径是相对于 NEMU_HOME 的, 这样在其他目录下运行 NEMU 也能找到
+  const char *path = CONFIG_ITRACE_CAPSTONE_PATH;
+  char buf[PATH_MAX];
+  const char *home = getenv("NEMU_HOME");
+  if (path[0] != '/' && home != NULL) {
+    snprintf(buf, sizeof(buf), "%s/%s", home, path);
+    path = buf;
+  }
+  void *dl_handle = dlopen(path, RTLD_LAZY);
+  Assert(dl_handle, "Can not load capstone from '%s': %s", path, dlerror());
 
-  cs_err (*cs_open_dl)(cs_arch arch, cs_mode mode, csh *handle) = NULL;
   cs_open_dl = dlsym(dl_handle, "cs_open");
   assert(cs_open_dl);
 
-  cs_disasm_dl = dlsym(dl_handle, "cs_disasm");
-  assert(cs_disasm_dl);
+  cs_malloc_dl = dlsym(dl_handle, "cs_malloc");
+  assert(cs_malloc_dl);
 
-  cs_free_dl = dlsym(dl_handle, "cs_free");
-  assert(cs_free_dl);
+  cs_disasm_iter_dl = dlsym(dl_handle, "cs_disasm_iter");
+  assert(cs_disasm_iter_dl);
 
-  cs_arch arch = CS_ARCH_RISCV;
-
-  cs_mode mode = MUXDEF(CONFIG_ISA64, CS_MODE_RISCV64, CS_MODE_RISCV32) | CS_MODE_RISCVC;
-	int ret = cs_open_dl(arch, mode, &handle);
-  assert(ret == CS_ERR_OK);
+  open_handle();
 }
 
 /// @return true 成功反汇编
 /// @return false 失败
 bool disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte) {
-	cs_insn *insn;
-	size_t count = cs_disasm_dl(handle, code, nbyte, pc, 0, &insn);
-  if (count != 1) {
+  uint32_t inst = 0;
+  memcpy(&inst, code, nbyte > 4 ? 4 : nbyte);
+  DisasmCacheEntry *e = &cache[(pc >> 1) & (DISASM_CACHE_SIZE - 1)];
+  if (nbyte <= 4 && e->nbyte == nbyte && e->pc == pc && e->inst == inst) {
+    snprintf(str, size, "%s", e->str);
+    return true;
+  }
+
+  if (insn == NULL) open_handle();
+
+  const uint8_t *p = code;
+  size_t len = nbyte;
+  uint64_t addr = pc;
+  if (!cs_disasm_iter_dl(handle, &p, &len, &addr, insn) || len != 0) {
     return false;
   }
-  int ret = snprintf(str, size, "%s", insn->mnemonic);
+  char buf[sizeof(e->str)];
   if (insn->op_str[0] != '\0') {
-    snprintf(str + ret, size - ret, "\t%s", insn->op_str);
+    snprintf(buf, sizeof(buf), "%s\t%s", insn->mnemonic, insn->op_str);
+  } else {
+    snprintf(buf, sizeof(buf), "%s", insn->mnemonic);
+  }
+  snprintf(str, size, "%s", buf);
+
+  if (nbyte <= 4) {
+    e->pc = pc;
+    e->inst = inst;
+    e->nbyte = nbyte;
+    memcpy(e->str, buf, sizeof(buf));
   }
-  cs_free_dl(insn, count);
   return true;
 }
@@ -29,4 +29,34 @@ else
 LIBS += -lelf
 endif
 
+ifeq ($(CONFIG_TRACE_THREAD),)
+SRCS-BLACKLIST-y += src/utils/tracelog.c
+else
+LIBS += -lpthread $(if $(CONFIG_TRACE_GZIP),-lz,)
+endif
+
+ifeq ($(CONFIG_ITRACE_BINARY),)
+SRCS-BLACKLIST-y += src/utils/itrace-bin.c
+endif
+
+ifeq ($(CONFIG_PCPROF),)
+SRCS-BLACKLIST-y += src/utils/pcprof.c
+endif
+
+ifeq ($(CONFIG_SIMPOINT),)
+SRCS-BLACKLIST-y += src/utils/simpoint.c
+else
+LIBS += -lm
+endif
+
+ifeq ($(CONFIG_CACHESIM),)
+SRCS-BLACKLIST-y += src/utils/cachesim.c
+endif
 
+ifeq ($(CONFIG_BPSIM),)
+SRCS-BLACKLIST-y += src/utils/bpsim.c
+endif
+
+ifeq ($(CONFIG_HOSTPERF),)
+SRCS-BLACKLIST-y += src/utils/hostperf.c
+endif
@@ -19,10 +19,11 @@
 #include <libelf.h> // libelf 是库本身, 提供读写ELF的基础API
 #include <errno.h> // NOLINT: for errno
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
-
+#include <utils/ringbuf.h>
 
 typedef struct {
   vaddr_t start;
@@ -33,6 +34,7 @@ typedef struct {
 typedef struct {
   const FuncSym *sym;
   vaddr_t addr;
+  IFDEF(CONFIG_FTRACE_PROFILE, int node); // 调用上下文树中的节点
 } CallFrame;
 
 static FuncSym *funcs = NULL; // 不同的 function 之间, 地址是不可能 overlay 的
@@ -46,21 +48,15 @@ typedef struct {
   vaddr_t pc;
   vaddr_t target;
   size_t depth;
-  char name[64];
+  const char *name; // 指向 funcs 中的名字, 初始化之后 funcs 不会再移动
 } TraceEntry;
 
-static TraceEntry log_buf[CONFIG_FTRACE_LOG_SIZE];
-static size_t log_cnt = 0;
+// 只保留最近的 CONFIG_FTRACE_LOG_SIZE 条, 长时间运行也不会停止记录
+static RINGBUF_DEFINE(TraceEntry, CONFIG_FTRACE_LOG_SIZE) log_buf = RINGBUF_INIT;
 
 static void log_trace(char type, vaddr_t pc, vaddr_t target, size_t depth, const char *name) {
-  if (log_cnt >= CONFIG_FTRACE_LOG_SIZE) return;
-  TraceEntry *e = &log_buf[log_cnt];
-  e->type = type;
-  e->pc = pc;
-  e->target = target;
-  e->depth = depth;
-  snprintf(e->name, sizeof(e->name), "%s", name);
-  log_cnt++;
+  RINGBUF_PUSH(log_buf, CONFIG_FTRACE_LOG_SIZE,
+      ((TraceEntry){.type = type, .pc = pc, .target = target, .depth = depth, .name = name}));
 }
 
 /// @param need 预留空间
@@ -127,6 +123,8 @@ static void load_symtab(Elf *e, size_t stridx, Elf_Scn *scn) {
 static char * elf_file = NULL;
 static size_t len = 0;
 
+bool image_is_elf(const char *file);
+
 void init_ftrace(const char *img_file) {
   len = strlen(img_file);
   elf_file = strndup(img_file, len);
@@ -135,11 +133,13 @@ void init_ftrace(const char *img_file) {
     return;
   }
 
-  // .bin -> .elf
-  elf_file[len] = '\0';
-  elf_file[len - 1] = 'f';
-  elf_file[len - 2] = 'l';
-  elf_file[len - 3] = 'e';
+  // 直接运行的 ELF 就带着符号表; 否则 .bin -> .elf
+  if (!image_is_elf(img_file)) {
+    elf_file[len] = '\0';
+    elf_file[len - 1] = 'f';
+    elf_file[len - 2] = 'l';
+    elf_file[len - 3] = 'e';
+  }
 
   int fd = open(elf_file, O_RDONLY);
   if (fd < 0) {
@@ -175,39 +175,62 @@ void init_ftrace(const char *img_file) {
   }
 }
 
+const char *ftrace_func_name(vaddr_t addr) {
+  const FuncSym *f = find_func(addr);
+  return f ? f->name : NULL;
+}
+
+#ifdef CONFIG_FTRACE_PROFILE
+static void prof_account(void);
+static void prof_call(CallFrame *f);
+static void prof_ret(const CallFrame *f);
+#endif
+
+// 超过 CONFIG_FTRACE_STACK_MAX 的部分只计数, 不记录栈帧
+static CallFrame *top_frame(void) {
+  if (call_depth == 0 || call_depth > CONFIG_FTRACE_STACK_MAX) return NULL;
+  return &call_stack[call_depth - 1];
+}
+
 void ftrace_call(vaddr_t pc, vaddr_t target) {
   const FuncSym *callee = find_func(target);
   const char *name = callee ? callee->name : "???";
 
   log_trace('C', pc, target, call_depth, name);
+  IFDEF(CONFIG_FTRACE_PROFILE, prof_account());
 
   if (call_depth < CONFIG_FTRACE_STACK_MAX) {
-    call_stack[call_depth].sym = callee;
-    call_stack[call_depth].addr = target;
-    call_depth++;
+    CallFrame *f = &call_stack[call_depth];
+    f->sym = callee;
+    f->addr = target;
+    IFDEF(CONFIG_FTRACE_PROFILE, prof_call(f));
   }
+  call_depth++;
 }
 
 void ftrace_ret(vaddr_t pc) {
+  IFDEF(CONFIG_FTRACE_PROFILE, prof_account());
+  const CallFrame *f = top_frame();
   if (call_depth > 0) {
     call_depth--;
   }
 
   const char *name = "???";
-  if (call_depth < CONFIG_FTRACE_STACK_MAX) {
-    const CallFrame *f = &call_stack[call_depth];
+  if (f != NULL) {
     if (f->sym && f->sym->name[0]) name = f->sym->name;
+    IFDEF(CONFIG_FTRACE_PROFILE, prof_ret(f));
   }
 
   log_trace('R', pc, 0, call_depth, name);
 }
 
 void ftrace_dump(void) {
-  if (log_cnt == 0) { return; }
+  if (RINGBUF_EMPTY(log_buf)) { return; }
 
   Log("Last %d ftrace entries:", CONFIG_FTRACE_LOG_SIZE);
-  for (size_t idx = 0; idx < log_cnt; idx++) {
-    const TraceEntry *e = &log_buf[idx];
+  RINGBUF_FOREACH(log_buf, CONFIG_FTRACE_LOG_SIZE, idx, pos) {
+    (void)idx; // unused
+    const TraceEntry *e = RINGBUF_GET(log_buf, pos);
     size_t pad = e->depth * 2; // 计算空格
     if (pad > 2 * CONFIG_FTRACE_STACK_MAX) pad = 2 * CONFIG_FTRACE_STACK_MAX;
     char spaces[2 * CONFIG_FTRACE_STACK_MAX + 1];
@@ -220,3 +243,168 @@ void ftrace_dump(void) {
     }
   }
 }
+
+#ifdef CONFIG_FTRACE_PROFILE
+// ===============================  函数级 profiler  ===============================
+// 在调用上下文树 (CCT) 上统计指令数: 每次 call/ret 时, 把上一次事件以来执行的指令
+// 记到当前栈顶的节点上, 所以不需要每条指令都回调. 退出时输出:
+//   FILE      : 折叠后的调用栈 (a;b;c 指令数), 可以直接交给 flamegraph.pl
+//   FILE.flat : 按 self 排序的平铺 profile, 带 inclusive 指令数
+
+extern uint64_t g_nr_guest_inst;
+
+typedef struct {
+  int parent;
+  int func;      // funcs 的下标, -1 表示不认识的函数; 根节点为 -2
+  uint64_t self; // 以该调用路径为栈顶时执行的指令数
+} ProfNode;
+
+static const char *prof_file = NULL;
+static ProfNode *nodes = NULL;
+static int node_cnt = 0, node_cap = 0;
+static int *node_hash = NULL; // 开放寻址, (parent, func) -> 节点下标, -1 为空
+static size_t hash_cap = 0;
+static uint64_t last_inst = 0;
+// 按函数统计 inclusive, 下标是 func + 1; 递归时只在最外层一次计入
+static uint64_t *incl = NULL, *incl_start = NULL;
+static uint32_t *active = NULL;
+
+static size_t node_hash_of(int parent, int func) {
+  return ((uint32_t)parent * 0x9e3779b1u ^ (uint32_t)(func + 2) * 0x85ebca6bu) & (hash_cap - 1);
+}
+
+static void hash_insert(int id) {
+  size_t h = node_hash_of(nodes[id].parent, nodes[id].func);
+  while (node_hash[h] >= 0) h = (h + 1) & (hash_cap - 1);
+  node_hash[h] = id;
+}
+
+static int new_node(int parent, int func) {
+  if (node_cnt == node_cap) {
+    node_cap = node_cap ? node_cap * 2 : 1024;
+    nodes = realloc(nodes, node_cap * sizeof(ProfNode));
+    Assert(nodes, "ftrace: no memory");
+  }
+  if ((size_t)(node_cnt + 1) * 2 > hash_cap) { // 装载率不超过 1/2
+    hash_cap = hash_cap ? hash_cap * 2 : 4096;
+    node_hash = realloc(node_hash, hash_cap * sizeof(int));
+    Assert(node_hash, "ftrace: no memory");
+    memset(node_hash, -1, hash_cap * sizeof(int));
+    for (int i = 0; i < node_cnt; i++) hash_insert(i);
+  }
+  nodes[node_cnt] = (ProfNode){ .parent = parent, .func = func, .self = 0 };
+  hash_insert(node_cnt);
+  return node_cnt++;
+}
+
+static int find_node(int parent, int func) {
+  for (size_t h = node_hash_of(parent, func); node_hash[h] >= 0; h = (h + 1) & (hash_cap - 1)) {
+    const ProfNode *n = &nodes[node_hash[h]];
+    if (n->parent == parent && n->func == func) return node_hash[h];
+  }
+  return new_node(parent, func);
+}
+
+static int cur_node(void) {
+  if (call_depth == 0) return 0;
+  size_t d = call_depth < CONFIG_FTRACE_STACK_MAX ? call_depth : CONFIG_FTRACE_STACK_MAX;
+  return call_stack[d - 1].node;
+}
+
+static void prof_account(void) {
+  if (prof_file == NULL) return;
+  nodes[cur_node()].self += g_nr_guest_inst - last_inst;
+  last_inst = g_nr_guest_inst;
+}
+
+static void prof_call(CallFrame *f) {
+  if (prof_file == NULL) return;
+  int func = f->sym ? (int)(f->sym - funcs) : -1;
+  f->node = find_node(cur_node(), func);
+  if (active[func + 1]++ == 0) incl_start[func + 1] = g_nr_guest_inst;
+}
+
+static void prof_ret(const CallFrame *f) {
+  if (prof_file == NULL) return;
+  int i = nodes[f->node].func + 1;
+  if (active[i] > 0 && --active[i] == 0) incl[i] += g_nr_guest_inst - incl_start[i];
+}
+
+static const char *func_name(int func) {
+  return func == -2 ? "(root)" : func == -1 ? "???" : funcs[func].name;
+}
+
+static void write_stack(FILE *fp, int id) {
+  if (nodes[id].parent > 0) {
+    write_stack(fp, nodes[id].parent);
+    fputc(';', fp);
+  }
+  fputs(func_name(nodes[id].func), fp);
+}
+
+static uint64_t *flat_self = NULL;
+
+static int cmp_self(const void *a, const void *b) {
+  uint64_t sa = flat_self[*(const int *)a], sb = flat_self[*(const int *)b];
+  return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+static void ftrace_profile_dump(void) {
+  prof_account();
+  uint64_t now = g_nr_guest_inst;
+  size_t nr = func_cnt + 1;
+  for (size_t i = 0; i < nr; i++) {
+    if (active[i] > 0) { incl[i] += now - incl_start[i]; active[i] = 0; }
+  }
+
+  FILE *fp = fopen(prof_file, "w");
+  if (fp == NULL) {
+    Log("ftrace: can not open '%s': %s", prof_file, strerror(errno));
+    return;
+  }
+  flat_self = calloc(nr, sizeof(uint64_t));
+  uint64_t root_self = nodes[0].self;
+  for (int id = 0; id < node_cnt; id++) {
+    if (nodes[id].self == 0) continue;
+    if (id > 0) flat_self[nodes[id].func + 1] += nodes[id].self;
+    write_stack(fp, id);
+    fprintf(fp, " %" PRIu64 "\n", nodes[id].self);
+  }
+  fclose(fp);
+
+  char flat_file[PATH_MAX];
+  snprintf(flat_file, sizeof(flat_file), "%s.flat", prof_file);
+  fp = fopen(flat_file, "w");
+  Assert(fp, "Can not open '%s'", flat_file);
+  int *order = malloc(nr * sizeof(int));
+  for (size_t i = 0; i < nr; i++) order[i] = i;
+  qsort(order, nr, sizeof(int), cmp_self);
+
+  double total = now ? (double)now : 1;
+  fprintf(fp, "%7s %14s %7s %14s  %s\n", "self%", "self", "incl%", "inclusive", "function");
+  fprintf(fp, "%6.2f%% %14" PRIu64 " %6.2f%% %14" PRIu64 "  %s\n", root_self * 100 / total, root_self, 100.0, now, func_name(-2));
+  Log("ftrace: top functions by self instruction count:");
+  for (size_t k = 0; k < nr && flat_self[order[k]] > 0; k++) {
+    int i = order[k];
+    fprintf(fp, "%6.2f%% %14" PRIu64 " %6.2f%% %14" PRIu64 "  %s\n",
+        flat_self[i] * 100 / total, flat_self[i], incl[i] * 100 / total, incl[i], func_name(i - 1));
+    if (k < 10) Log("  %6.2f%% %14" PRIu64 "  %s", flat_self[i] * 100 / total, flat_self[i], func_name(i - 1));
+  }
+  fclose(fp);
+  Log("ftrace: profile is written to %s and %s", prof_file, flat_file);
+  free(order);
+  free(flat_self);
+}
+
+void init_ftrace_profile(const char *file) {
+  if (file == NULL) return;
+  prof_file = file;
+  new_node(-1, -2); // 根节点, 还没有进入任何函数
+  incl = calloc(func_cnt + 1, sizeof(uint64_t));
+  incl_start = calloc(func_cnt + 1, sizeof(uint64_t));
+  active = calloc(func_cnt + 1, sizeof(uint32_t));
+  Assert(incl && incl_start && active, "ftrace: no memory");
+  last_inst = g_nr_guest_inst;
+  atexit(ftrace_profile_dump);
+}
+#endif
@@ -0,0 +1,159 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// 执行循环的 host 端开销: perf_event 统计整个循环的周期/指令/分支预测失败/L1D 缺失,
+// 各个子系统的时间由 hostperf.h 里基于 rdtsc 的计时器统计
+
+#include <hostperf.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+
+extern uint64_t g_nr_guest_inst;
+
+HostPerfSlot hostperf_slot[NR_HP] = {};
+HostPerfFrame hostperf_stack[HOSTPERF_MAX_DEPTH] = {};
+int hostperf_top = 0; // hostperf_stack[0] 是哨兵, 收集最外层区域的时间
+bool hostperf_active = false; // 在 hostperf_loop_begin/end 之间
+
+static const char *slot_name[NR_HP] = {
+  [HP_LOOP] = "loop", [HP_EXEC] = "isa_exec_once", [HP_MEM] = "paddr",
+  [HP_MMIO] = "mmio", [HP_DEVICE] = "device_update", [HP_TRACE] = "trace",
+  [HP_DIFFTEST] = "difftest_step",
+};
+
+typedef struct {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+  int fd;
+} HostCounter;
+
+#define L1D_READ_MISS (PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static HostCounter counter[] = {
+  { "cycles"       , PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES   , -1 },
+  { "instructions" , PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS , -1 },
+  { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1 },
+  { "l1d_misses"   , PERF_TYPE_HW_CACHE, L1D_READ_MISS              , -1 },
+};
+
+static const char *json_file = NULL;
+static uint64_t tick_start, ns_start; // 用来把 tick 换算成时间
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void init_hostperf(const char *file) {
+  json_file = file;
+  int nr_ok = 0;
+  for (int i = 0; i < ARRLEN(counter); i++) {
+    struct perf_event_attr attr = {
+      .size = sizeof(attr), .type = counter[i].type, .config = counter[i].config,
+      .disabled = 1, .exclude_kernel = 1, .exclude_hv = 1,
+      // 计数器多于硬件寄存器时内核会分时复用, 报告时按运行时间放大
+      .read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+    };
+    counter[i].fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counter[i].fd >= 0) nr_ok++;
+  }
+  if (nr_ok < ARRLEN(counter)) {
+    Log("hostperf: %d/%d perf_event counters are not available (see /proc/sys/kernel/perf_event_paranoid)",
+        ARRLEN(counter) - nr_ok, ARRLEN(counter));
+  }
+  tick_start = hostperf_tick();
+  ns_start = now_ns();
+}
+
+void hostperf_loop_begin(void) {
+  for (int i = 0; i < ARRLEN(counter); i++) {
+    if (counter[i].fd >= 0) ioctl(counter[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  hostperf_begin();
+  hostperf_active = true;
+}
+
+void hostperf_loop_end(void) {
+  hostperf_active = false;
+  hostperf_end(HP_LOOP);
+  for (int i = 0; i < ARRLEN(counter); i++) {
+    if (counter[i].fd >= 0) ioctl(counter[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+}
+
+static int64_t read_counter(const HostCounter *c) {
+  uint64_t val[3]; // value, time_enabled, time_running
+  if (c->fd < 0 || read(c->fd, val, sizeof(val)) != sizeof(val)) return -1;
+  if (val[2] == 0) return 0;
+  return val[2] < val[1] ? (int64_t)((double)val[0] * val[1] / val[2]) : (int64_t)val[0];
+}
+
+// 每微秒多少个 tick, 没有 rdtsc 时 tick 就是纳秒
+static double ticks_per_us(void) {
+  uint64_t ns = now_ns() - ns_start;
+  return ns > 0 ? (hostperf_tick() - tick_start) * 1000.0 / ns : 1.0;
+}
+
+static void dump_json(const int64_t *val, double tpu) {
+  FILE *fp = fopen(json_file, "w");
+  if (fp == NULL) { Log("hostperf: can not open %s", json_file); return; }
+  fprintf(fp, "{\n  \"guest_insts\": %" PRIu64 ",\n  \"ticks_per_us\": %.3f,\n  \"counters\": {", g_nr_guest_inst, tpu);
+  for (int i = 0; i < ARRLEN(counter); i++) {
+    fprintf(fp, "%s\n    \"%s\": %" PRId64, i ? "," : "", counter[i].name, val[i]);
+  }
+  fprintf(fp, "\n  },\n  \"regions\": {");
+  for (int i = 0; i < NR_HP; i++) {
+    const HostPerfSlot *s = &hostperf_slot[i];
+    fprintf(fp, "%s\n    \"%s\": { \"calls\": %" PRIu64 ", \"self_ticks\": %" PRIu64 ", \"incl_ticks\": %" PRIu64 " }",
+        i ? "," : "", slot_name[i], s->calls, s->self, s->incl);
+  }
+  fprintf(fp, "\n  }\n}\n");
+  fclose(fp);
+  Log("hostperf: results written to %s", json_file);
+}
+
+void hostperf_report(void) {
+  const HostPerfSlot *loop = &hostperf_slot[HP_LOOP];
+  if (loop->calls == 0) return;
+  int64_t val[ARRLEN(counter)];
+  for (int i = 0; i < ARRLEN(counter); i++) val[i] = read_counter(&counter[i]);
+
+  double kinst = g_nr_guest_inst / 1000.0;
+  if (val[0] > 0 && val[1] > 0) {
+    Log("hostperf: %" PRId64 " cycles, %" PRId64 " instructions, IPC %.2f, %.1f host cycles/guest inst",
+        val[0], val[1], (double)val[1] / val[0], g_nr_guest_inst ? (double)val[0] / g_nr_guest_inst : 0.0);
+  }
+  if (val[2] >= 0 && val[3] >= 0 && kinst > 0) {
+    Log("hostperf: branch misses %" PRId64 " (%.2f per kinst), L1D misses %" PRId64 " (%.2f per kinst)",
+        val[2], val[2] / kinst, val[3], val[3] / kinst);
+  }
+
+  // self 不包括嵌套在里面的区域, 各行 self 加起来就是整个执行循环
+  double tpu = ticks_per_us();
+  Log("hostperf: %-14s %12s %12s %7s %10s", "region", "calls", "self us", "self%", "ticks/call");
+  for (int i = 0; i < NR_HP; i++) {
+    const HostPerfSlot *s = &hostperf_slot[i];
+    if (s->calls == 0) continue;
+    Log("hostperf: %-14s %12" PRIu64 " %12.0f %6.2f%% %10.1f", slot_name[i], s->calls, s->self / tpu,
+        s->self * 100.0 / loop->incl, (double)s->incl / s->calls);
+  }
+  if (json_file) dump_json(val, tpu);
+}
@@ -0,0 +1,107 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NEMU is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+// 二进制指令踪迹的写入端, 格式见 include/utils/itrace-bin.h
+// 执行时只做编码, 不做反汇编; 用 tools/itrace-dump 离线查看
+
+#include <isa.h>
+#include <cpu/decode.h>
+#include <utils/itrace-bin.h>
+
+#define BUF_SIZE (1 << 20)
+
+static FILE *itb_fp = NULL;
+static uint8_t buf[BUF_SIZE];
+static size_t buf_pos = 0;
+static uint64_t nr_rec = 0, nr_bytes = 0;
+
+// 上一条指令, 初值与解码端约定为 0
+static uint64_t last_pc = 0;
+static uint32_t last_inst = 0;
+#ifdef CONFIG_ITRACE_BINARY_RD
+static word_t shadow_gpr[32]; // 解码端看到的寄存器值, 用于差分编码
+#endif
+static ItraceBinCacheEntry cache[ITRACE_BIN_CACHE_SIZE];
+
+void itrace_bin_flush(void) {
+  if (itb_fp == NULL || buf_pos == 0) return;
+  size_t ret = fwrite(buf, 1, buf_pos, itb_fp);
+  Assert(ret == buf_pos, "itrace: write failed");
+  fflush(itb_fp);
+  nr_bytes += buf_pos;
+  buf_pos = 0;
+}
+
+static void itrace_bin_close(void) {
+  if (itb_fp == NULL) return;
+  itrace_bin_flush();
+  fclose(itb_fp);
+  itb_fp = NULL;
+  Log("itrace: %" PRIu64 " instructions, %" PRIu64 " bytes (%.2f bytes/inst)",
+      nr_rec, nr_bytes, nr_rec ? (double)nr_bytes / nr_rec : 0.0);
+}
+
+void init_itrace_bin(const char *file) {
+  if (file == NULL) return;
+  itb_fp = fopen(file, "wb");
+  Assert(itb_fp, "Can not open '%s'", file);
+
+  ItraceBinHeader h = { .version = ITRACE_BIN_VERSION,
+    .flags = MUXDEF(CONFIG_ITRACE_BINARY_RD, ITRACE_BIN_FLAG_RD, 0) | MUXDEF(CONFIG_ISA64, ITRACE_BIN_FLAG_XL64, 0) };
+  memcpy(h.magic, ITRACE_BIN_MAGIC, sizeof(h.magic));
+  memcpy(buf, &h, sizeof(h));
+  buf_pos = sizeof(h);
+
+  for (int i = 0; i < ITRACE_BIN_CACHE_SIZE; i++) cache[i].pc = -1;
+  atexit(itrace_bin_close);
+  Log("itrace: binary instruction trace is written to %s", file);
+}
+
+void itrace_bin_write(const Decode *s) {
+  if (itb_fp == NULL) return;
+  if (buf_pos + ITRACE_BIN_REC_MAX > BUF_SIZE) itrace_bin_flush();
+
+  uint32_t inst = s->isa.inst;
+  uint8_t *tag = &buf[buf_pos];
+  uint8_t *p = tag + 1;
+  *tag = 0;
+
+  uint64_t expect = last_pc + itrace_bin_ilen(last_inst);
+  if (s->pc == expect) *tag |= ITRACE_BIN_SEQ;
+  else p = itrace_bin_put_varint(p, itrace_bin_zigzag((int64_t)(s->pc - expect)));
+
+  ItraceBinCacheEntry *e = itrace_bin_cache_entry(cache, s->pc);
+  if (e->pc == s->pc && e->inst == inst) *tag |= ITRACE_BIN_HIT;
+  else {
+    memcpy(p, &inst, 4); p += 4;
+    e->pc = s->pc;
+    e->inst = inst;
+  }
+
+#ifdef CONFIG_ITRACE_BINARY_RD
+  int rd = itrace_bin_rd(inst);
+  if (rd > 0) {
+    word_t val = cpu.gpr[rd];
+    *tag |= ITRACE_BIN_RD | (rd << ITRACE_BIN_RD_SHIFT);
+    p = itrace_bin_put_varint(p, itrace_bin_zigzag((int64_t)(sword_t)(val - shadow_gpr[rd])));
+    shadow_gpr[rd] = val;
+  }
+#endif
+
+  buf_pos = p - buf;
+  last_pc = s->pc;
+  last_inst = inst;
+  nr_rec++;
+}
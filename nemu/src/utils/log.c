@@ -14,9 +14,14 @@
 ***************************************************************************************/
 
 #include <common.h>
+#include <utils/tracelog.h>
 
 extern uint64_t g_nr_guest_inst;
 
+// sdb 的 trace on/off, 只影响 tracer 的输出, 不影响普通的 Log
+// cpu_set_trace() 在 AM 上也会用到, 所以放在 CONFIG_TARGET_AM 之外
+bool g_trace_on = true;
+
 #ifndef CONFIG_TARGET_AM
 FILE *log_fp = NULL;
 
@@ -27,6 +32,7 @@ void init_log(const char *log_file) {
     Assert(fp, "Can not open '%s'", log_file);
     log_fp = fp;
   }
+  IFDEF(CONFIG_TRACE_THREAD, init_tracelog(log_fp, MUXDEF(CONFIG_TRACE_GZIP, log_file != NULL, false)));
   Log("Log is written to %s", log_file ? log_file : "stdout");
 }
 
@@ -38,4 +44,8 @@ bool log_enable() {
     false
   );
 }
+
+bool trace_enable() {
+  return g_trace_on && log_enable();
+}
 #endif
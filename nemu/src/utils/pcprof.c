@@ -0,0 +1,152 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// 按 pc 统计的指令直方图, 退出时报告最热的 pc, 基本块和指令组成
+
+#include <pcprof.h>
+#include <ftrace.h>
+
+#define NR_WORDS (CONFIG_MSIZE / 4)
+#define BB_MAX_LEN 256 // 基本块最多往后看多少条指令
+
+#define LogProf(format, ...) \
+  _Log(ANSI_FMT(format, ANSI_FG_BLUE) "\n", ##__VA_ARGS__)
+
+uint64_t *pcprof_cnt = NULL;
+uint64_t *pcprof_enter = NULL;
+bool pcprof_bb_end = true; // 第一条指令也是基本块的入口
+
+static InstMix *instmix_list = NULL;
+
+IFDEF(CONFIG_ITRACE, bool disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte));
+
+void instmix_register(InstMix *m) {
+  m->registered = true;
+  m->next = instmix_list;
+  instmix_list = m;
+}
+
+void init_pcprof(void) {
+  pcprof_cnt = calloc(NR_WORDS, sizeof(uint64_t));
+  pcprof_enter = calloc(NR_WORDS, sizeof(uint64_t));
+  Assert(pcprof_cnt && pcprof_enter, "pcprof: no memory");
+}
+
+static paddr_t idx2pc(size_t i) { return PMEM_LEFT + i * 4; }
+
+static uint32_t inst_at(size_t i) {
+  uint32_t inst;
+  memcpy(&inst, guest_to_host(idx2pc(i)), sizeof(inst));
+  return inst;
+}
+
+// 分支, 跳转和 system 指令结束一个基本块
+static bool is_ctrl(uint32_t inst) {
+  switch (inst & 0x7f) {
+    case 0x63: case 0x6f: case 0x67: case 0x73: return true;
+    default: return false;
+  }
+}
+
+static const char *func_of(size_t i) {
+  const char *name = ftrace_func_name(idx2pc(i));
+  return name ? name : "";
+}
+
+// 维护 key 最大的 n 项, 按 key 从大到小排列
+static void topn_insert(uint64_t *keys, size_t *idx, int n, uint64_t key, size_t i) {
+  if (key <= keys[n - 1]) return;
+  int k = n - 1;
+  for (; k > 0 && keys[k - 1] < key; k--) {
+    keys[k] = keys[k - 1];
+    idx[k] = idx[k - 1];
+  }
+  keys[k] = key;
+  idx[k] = i;
+}
+
+static void dump_hot_pcs(uint64_t total) {
+  uint64_t keys[CONFIG_PCPROF_TOPN] = {0};
+  size_t idx[CONFIG_PCPROF_TOPN];
+  for (size_t i = 0; i < NR_WORDS; i++) {
+    if (pcprof_cnt[i]) topn_insert(keys, idx, CONFIG_PCPROF_TOPN, pcprof_cnt[i], i);
+  }
+
+  LogProf("Top %d hot pcs:", CONFIG_PCPROF_TOPN);
+  for (int k = 0; k < CONFIG_PCPROF_TOPN && keys[k] > 0; k++) {
+    char asm_buf[128] = "";
+#ifdef CONFIG_ITRACE
+    uint32_t inst = inst_at(idx[k]);
+    disassemble(asm_buf, sizeof(asm_buf), idx2pc(idx[k]), (uint8_t *)&inst, 4);
+#endif
+    LogProf("  " FMT_PADDR " %14" PRIu64 " %6.2f%%  %-24s %s", idx2pc(idx[k]), keys[k],
+        keys[k] * 100.0 / total, func_of(idx[k]), asm_buf);
+  }
+}
+
+static void dump_hot_bbs(uint64_t total) {
+  uint64_t keys[CONFIG_PCPROF_TOPN] = {0};
+  size_t idx[CONFIG_PCPROF_TOPN];
+  for (size_t i = 0; i < NR_WORDS; i++) {
+    if (pcprof_enter[i] == 0) continue;
+    uint64_t sum = 0;
+    for (size_t j = i; j < NR_WORDS && j < i + BB_MAX_LEN && pcprof_cnt[j]; j++) {
+      if (j > i && pcprof_enter[j]) break; // 另一个基本块的入口
+      sum += pcprof_cnt[j];
+      if (is_ctrl(inst_at(j))) break;
+    }
+    topn_insert(keys, idx, CONFIG_PCPROF_TOPN, sum, i);
+  }
+
+  LogProf("Top %d hot basic blocks:", CONFIG_PCPROF_TOPN);
+  for (int k = 0; k < CONFIG_PCPROF_TOPN && keys[k] > 0; k++) {
+    size_t i = idx[k], j = i;
+    while (j + 1 < NR_WORDS && j + 1 < i + BB_MAX_LEN && !is_ctrl(inst_at(j)) &&
+           pcprof_cnt[j + 1] && !pcprof_enter[j + 1]) j++;
+    LogProf("  [" FMT_PADDR ", " FMT_PADDR "] %3zu insts, entered %12" PRIu64 ", %14" PRIu64 " %6.2f%%  %s",
+        idx2pc(i), idx2pc(j), j - i + 1, pcprof_enter[i], keys[k], keys[k] * 100.0 / total, func_of(i));
+  }
+}
+
+static int cmp_mix(const void *a, const void *b) {
+  uint64_t ca = (*(InstMix *const *)a)->count, cb = (*(InstMix *const *)b)->count;
+  return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static void dump_instmix(void) {
+  int n = 0;
+  uint64_t total = 0;
+  for (InstMix *m = instmix_list; m != NULL; m = m->next) { n++; total += m->count; }
+  if (n == 0) return;
+  InstMix **arr = malloc(n * sizeof(InstMix *));
+  n = 0;
+  for (InstMix *m = instmix_list; m != NULL; m = m->next) arr[n++] = m;
+  qsort(arr, n, sizeof(InstMix *), cmp_mix);
+
+  LogProf("Instruction mix:");
+  for (int k = 0; k < n; k++) {
+    LogProf("  %-8s %14" PRIu64 " %6.2f%%", arr[k]->name, arr[k]->count, arr[k]->count * 100.0 / total);
+  }
+  free(arr);
+}
+
+void pcprof_dump(void) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < NR_WORDS; i++) total += pcprof_cnt[i];
+  if (total == 0) return;
+  dump_hot_pcs(total);
+  dump_hot_bbs(total);
+  dump_instmix();
+}
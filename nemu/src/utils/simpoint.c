@@ -0,0 +1,551 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// SimPoint 采样模拟
+// 1. --simpoint-profile=DIR: 按区间收集基本块向量 (BBV), 随机投影降维后做 k-means,
+//    选出代表区间, 写出 DIR/{bbv,simpoints,weights,summary}
+// 2. --simpoint-ckpt=DIR: 读回 simpoints/weights, 在每个代表区间 (减去预热) 的起点
+//    dump 寄存器和 pmem 到 DIR/ckpt-<cluster>.bin, 交给 NPC 做详细模拟
+// @ref Sherwood et al., "Automatically Characterizing Large Scale Program Behavior", ASPLOS'02
+
+#include <common.h>
+#include <isa.h>
+#include <simpoint.h>
+#include <memory/paddr.h>
+#include <device/map.h>
+#include <math.h>
+#include <stdio.h>
+#include "../isa/riscv32/local-include/reg.h"
+
+#define SP_DIM 15          // 随机投影后的维度, 与 SimPoint 的默认值一致
+#define SP_KMEANS_ITERS 100
+#define SP_KMEANS_SEEDS 5  // 每个 k 尝试几组初始中心, 取失真最小的
+#define SP_BIC_THRESHOLD 0.9
+
+extern uint64_t g_nr_guest_inst;
+
+enum { SP_OFF, SP_PROFILE, SP_CKPT };
+static int sp_mode = SP_OFF;
+static char sp_dir[256];
+
+// ===============================  BBV 收集  ===============================
+
+typedef struct {
+  vaddr_t pc;
+  uint32_t id; // 0 表示空槽
+} BBEntry;
+
+static BBEntry *bb_table = NULL; // 开放寻址, 基本块起始 pc -> id
+static size_t bb_cap = 0;
+static uint32_t bb_cnt = 0;
+static uint64_t *bb_count = NULL;  // 当前区间内每个基本块执行的指令数, 以 id 为下标
+static uint32_t *bb_touched = NULL; // 当前区间内出现过的基本块 id
+static size_t touched_cnt = 0;
+static size_t count_cap = 0;
+
+static vaddr_t cur_bb_pc = 0;
+static uint64_t cur_bb_len = 0;
+static uint64_t interval_left = CONFIG_SIMPOINT_INTERVAL;
+
+typedef struct {
+  float vec[SP_DIM]; // 投影并归一化后的 BBV
+  uint64_t insts;
+} Interval;
+
+static Interval *intervals = NULL;
+static size_t nr_interval = 0;
+static size_t interval_cap = 0;
+static FILE *bbv_fp = NULL;
+
+static inline uint32_t hash_pc(vaddr_t pc) { return (uint32_t)(pc >> 2) * 2654435761u; }
+
+static void bb_table_grow(void) {
+  size_t new_cap = bb_cap ? bb_cap * 2 : 4096;
+  BBEntry *t = calloc(new_cap, sizeof(BBEntry));
+  Assert(t, "simpoint: no memory");
+  for (size_t i = 0; i < bb_cap; i++) {
+    if (bb_table[i].id == 0) continue;
+    size_t h = hash_pc(bb_table[i].pc) & (new_cap - 1);
+    while (t[h].id != 0) h = (h + 1) & (new_cap - 1);
+    t[h] = bb_table[i];
+  }
+  free(bb_table);
+  bb_table = t;
+  bb_cap = new_cap;
+}
+
+static void bb_count_reserve(size_t need) {
+  if (need <= count_cap) return;
+  size_t new_cap = count_cap ? count_cap * 2 : 4096;
+  if (new_cap < need) new_cap = need;
+  bb_count = realloc(bb_count, new_cap * sizeof(*bb_count));
+  bb_touched = realloc(bb_touched, new_cap * sizeof(*bb_touched));
+  Assert(bb_count && bb_touched, "simpoint: no memory");
+  memset(bb_count + count_cap, 0, (new_cap - count_cap) * sizeof(*bb_count));
+  count_cap = new_cap;
+}
+
+// 基本块编号从 1 开始, 与 SimPoint 的 .bb 格式一致
+static uint32_t bb_lookup(vaddr_t pc) {
+  if ((bb_cnt + 1) * 2 > bb_cap) bb_table_grow();
+  size_t h = hash_pc(pc) & (bb_cap - 1);
+  while (bb_table[h].id != 0) {
+    if (bb_table[h].pc == pc) return bb_table[h].id;
+    h = (h + 1) & (bb_cap - 1);
+  }
+  bb_table[h].pc = pc;
+  bb_table[h].id = ++bb_cnt;
+  bb_count_reserve(bb_cnt + 1);
+  return bb_cnt;
+}
+
+static void bb_end(void) {
+  if (cur_bb_len == 0) return;
+  uint32_t id = bb_lookup(cur_bb_pc);
+  if (bb_count[id] == 0) bb_touched[touched_cnt++] = id;
+  bb_count[id] += cur_bb_len;
+  cur_bb_len = 0;
+}
+
+// 随机投影矩阵的元素, 由 (id, d) 决定, 不需要保存整个矩阵
+static inline double proj_weight(uint32_t id, int d) {
+  uint64_t x = (uint64_t)id * SP_DIM + d + 0x9e3779b97f4a7c15ull; // splitmix64
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return (double)(x >> 11) / (double)(1ull << 52) - 1.0; // [-1, 1)
+}
+
+static void interval_end(void) {
+  bb_end();
+  if (touched_cnt == 0) return;
+
+  if (nr_interval >= interval_cap) {
+    interval_cap = interval_cap ? interval_cap * 2 : 1024;
+    intervals = realloc(intervals, interval_cap * sizeof(Interval));
+    Assert(intervals, "simpoint: no memory");
+  }
+
+  double v[SP_DIM] = {};
+  uint64_t insts = 0;
+  if (bbv_fp) fputc('T', bbv_fp);
+  for (size_t i = 0; i < touched_cnt; i++) {
+    uint32_t id = bb_touched[i];
+    uint64_t c = bb_count[id];
+    insts += c;
+    for (int d = 0; d < SP_DIM; d++) v[d] += c * proj_weight(id, d);
+    if (bbv_fp) fprintf(bbv_fp, ":%u:%" PRIu64 " ", id, c);
+    bb_count[id] = 0;
+  }
+  if (bbv_fp) fputc('\n', bbv_fp);
+  touched_cnt = 0;
+
+  Interval *it = &intervals[nr_interval++];
+  for (int d = 0; d < SP_DIM; d++) it->vec[d] = v[d] / insts;
+  it->insts = insts;
+}
+
+// ===============================  k-means  ===============================
+
+typedef double Centroid[SP_DIM];
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dull;
+
+static double rng_uniform(void) { // xorshift64*, 保证每次运行结果相同
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return ((rng_state * 0x2545f4914f6cdd1dull) >> 11) * 0x1.0p-53;
+}
+
+static double dist2(const Interval *it, const double *c) {
+  double s = 0;
+  for (int d = 0; d < SP_DIM; d++) {
+    double t = it->vec[d] - c[d];
+    s += t * t;
+  }
+  return s;
+}
+
+static void set_centroid(double *c, const Interval *it) {
+  for (int d = 0; d < SP_DIM; d++) c[d] = it->vec[d];
+}
+
+/// @return 失真 (所有点到所属中心的距离平方和)
+static double kmeans(int k, int *assign, Centroid *cent) {
+  size_t n = nr_interval;
+  double *d2 = malloc(n * sizeof(double));
+  Assert(d2, "simpoint: no memory");
+
+  // k-means++ 初始化: 离已有中心越远, 越可能被选为下一个中心
+  set_centroid(cent[0], &intervals[(size_t)(rng_uniform() * n)]);
+  for (int c = 1; c < k; c++) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+      double best = INFINITY;
+      for (int j = 0; j < c; j++) best = fmin(best, dist2(&intervals[i], cent[j]));
+      d2[i] = best;
+      sum += best;
+    }
+    size_t pick = (size_t)(rng_uniform() * n);
+    if (sum > 0) {
+      double r = rng_uniform() * sum;
+      for (size_t i = 0; i < n; i++) {
+        r -= d2[i];
+        if (r <= 0) { pick = i; break; }
+      }
+    }
+    set_centroid(cent[c], &intervals[pick]);
+  }
+
+  // Lloyd 迭代
+  size_t *members = malloc(k * sizeof(size_t));
+  Assert(members, "simpoint: no memory");
+  for (size_t i = 0; i < n; i++) assign[i] = -1;
+  for (int iter = 0; iter < SP_KMEANS_ITERS; iter++) {
+    bool changed = false;
+    for (size_t i = 0; i < n; i++) {
+      int best = 0;
+      double best_d = dist2(&intervals[i], cent[0]);
+      for (int c = 1; c < k; c++) {
+        double d = dist2(&intervals[i], cent[c]);
+        if (d < best_d) { best_d = d; best = c; }
+      }
+      if (assign[i] != best) { assign[i] = best; changed = true; }
+    }
+    if (!changed) break;
+
+    memset(members, 0, k * sizeof(size_t));
+    double (*sum)[SP_DIM] = calloc(k, sizeof(Centroid));
+    Assert(sum, "simpoint: no memory");
+    for (size_t i = 0; i < n; i++) {
+      members[assign[i]]++;
+      for (int d = 0; d < SP_DIM; d++) sum[assign[i]][d] += intervals[i].vec[d];
+    }
+    for (int c = 0; c < k; c++) {
+      if (members[c] == 0) continue; // 空簇保留原来的中心
+      for (int d = 0; d < SP_DIM; d++) cent[c][d] = sum[c][d] / members[c];
+    }
+    free(sum);
+  }
+
+  double distortion = 0;
+  for (size_t i = 0; i < n; i++) distortion += dist2(&intervals[i], cent[assign[i]]);
+  free(members);
+  free(d2);
+  return distortion;
+}
+
+// 球形高斯模型下的 BIC 评分, 越大越好
+// @ref Pelleg and Moore, "X-means: Extending K-means with Efficient Estimation of the Number of Clusters"
+static double bic_score(int k, const int *assign, double distortion) {
+  double R = nr_interval, M = SP_DIM;
+  if (nr_interval <= (size_t)k) return -INFINITY;
+  double var = distortion / ((R - k) * M);
+  if (var < 1e-12) var = 1e-12;
+
+  size_t *members = calloc(k, sizeof(size_t));
+  Assert(members, "simpoint: no memory");
+  for (size_t i = 0; i < nr_interval; i++) members[assign[i]]++;
+  double ll = -R * log(R) - R * M / 2 * log(2 * M_PI * var) - distortion / (2 * var);
+  for (int c = 0; c < k; c++) {
+    if (members[c] > 0) ll += members[c] * log((double)members[c]);
+  }
+  free(members);
+
+  double params = (k - 1) + M * k + 1;
+  return ll - params / 2 * log(R);
+}
+
+static FILE *open_in_dir(const char *name, const char *mode) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", sp_dir, name);
+  FILE *fp = fopen(path, mode);
+  Assert(fp, "simpoint: can not open '%s'", path);
+  return fp;
+}
+
+static void profile_finish(void) {
+  interval_end(); // 最后一个区间可能不满
+  if (bbv_fp) { fclose(bbv_fp); bbv_fp = NULL; }
+  if (nr_interval == 0) {
+    Log("simpoint: no interval was collected");
+    return;
+  }
+
+  int max_k = CONFIG_SIMPOINT_MAX_K;
+  if ((size_t)max_k > nr_interval) max_k = nr_interval;
+
+  int *assign_all = malloc(sizeof(int) * nr_interval * max_k);
+  Centroid *cent_all = malloc(sizeof(Centroid) * max_k * max_k);
+  int *assign_tmp = malloc(sizeof(int) * nr_interval);
+  Centroid *cent_tmp = malloc(sizeof(Centroid) * max_k);
+  double *bic = malloc(sizeof(double) * max_k);
+  Assert(assign_all && cent_all && assign_tmp && cent_tmp && bic, "simpoint: no memory");
+
+  // 对每个 k 做若干次 k-means, 保留失真最小的那次
+  for (int k = 1; k <= max_k; k++) {
+    int *assign = assign_all + (k - 1) * nr_interval;
+    Centroid *cent = cent_all + (k - 1) * max_k;
+    double best = INFINITY;
+    for (int seed = 0; seed < SP_KMEANS_SEEDS; seed++) {
+      double d = kmeans(k, assign_tmp, cent_tmp);
+      if (d < best) {
+        best = d;
+        memcpy(assign, assign_tmp, sizeof(int) * nr_interval);
+        memcpy(cent, cent_tmp, sizeof(Centroid) * k);
+      }
+    }
+    bic[k - 1] = bic_score(k, assign, best);
+  }
+
+  // 与 SimPoint 一样: 取 BIC 达到 [min, max] 区间 90% 处的最小 k
+  double bic_min = INFINITY, bic_max = -INFINITY;
+  for (int k = 1; k <= max_k; k++) {
+    if (!isfinite(bic[k - 1])) continue;
+    bic_min = fmin(bic_min, bic[k - 1]);
+    bic_max = fmax(bic_max, bic[k - 1]);
+  }
+  int k = 1;
+  if (isfinite(bic_min)) {
+    double th = bic_min + SP_BIC_THRESHOLD * (bic_max - bic_min);
+    for (k = 1; k < max_k; k++) {
+      if (isfinite(bic[k - 1]) && bic[k - 1] >= th) break;
+    }
+  }
+  int *assign = assign_all + (k - 1) * nr_interval;
+  Centroid *cent = cent_all + (k - 1) * max_k;
+
+  // 每个簇选离中心最近的区间作为 simpoint, 权重为簇内的指令占比
+  uint64_t total = 0;
+  for (size_t i = 0; i < nr_interval; i++) total += intervals[i].insts;
+
+  FILE *sp_fp = open_in_dir("simpoints", "w");
+  FILE *w_fp = open_in_dir("weights", "w");
+  Log("simpoint: %zu intervals of %d instructions, k = %d", nr_interval, CONFIG_SIMPOINT_INTERVAL, k);
+  int cluster = 0;
+  for (int c = 0; c < k; c++) {
+    size_t pick = nr_interval;
+    double pick_d = INFINITY;
+    uint64_t insts = 0;
+    for (size_t i = 0; i < nr_interval; i++) {
+      if (assign[i] != c) continue;
+      insts += intervals[i].insts;
+      double d = dist2(&intervals[i], cent[c]);
+      if (d < pick_d) { pick_d = d; pick = i; }
+    }
+    if (pick == nr_interval) continue; // 空簇
+    double weight = (double)insts / total;
+    fprintf(sp_fp, "%zu %d\n", pick, cluster);
+    fprintf(w_fp, "%.6f %d\n", weight, cluster);
+    Log("simpoint: cluster %d, interval %zu, weight %.4f", cluster, pick, weight);
+    cluster++;
+  }
+  fclose(sp_fp);
+  fclose(w_fp);
+
+  FILE *fp = open_in_dir("summary", "w");
+  fprintf(fp, "interval %d\ninsts %" PRIu64 "\nk %d\n", CONFIG_SIMPOINT_INTERVAL, total, cluster);
+  fclose(fp);
+  Log("simpoint: results are written to %s, run with --simpoint-ckpt=%s to dump checkpoints", sp_dir, sp_dir);
+
+  free(assign_all);
+  free(cent_all);
+  free(assign_tmp);
+  free(cent_tmp);
+  free(bic);
+}
+
+// ===============================  checkpoint  ===============================
+
+typedef struct {
+  uint64_t inst_count;
+  uint64_t warmup;
+  uint64_t interval;
+  double weight;
+  uint32_t cluster;
+} CkptTarget;
+
+static CkptTarget *ckpts = NULL;
+static size_t ckpt_cnt = 0;
+static size_t ckpt_next = 0;
+static uint64_t total_insts = 0;
+
+static bool page_is_zero(const uint8_t *p) {
+  const uint64_t *q = (const uint64_t *)p;
+  for (int i = 0; i < SIMPOINT_PAGE_SIZE / 8; i++) {
+    if (q[i] != 0) return false;
+  }
+  return true;
+}
+
+static void ckpt_dump(const CkptTarget *t) {
+  char name[64];
+  snprintf(name, sizeof(name), "ckpt-%u.bin", t->cluster);
+  FILE *fp = open_in_dir(name, "wb");
+
+  SimpointCkptHeader h = {
+    .magic = SIMPOINT_CKPT_MAGIC,
+    .version = SIMPOINT_CKPT_VERSION,
+    .cluster = t->cluster,
+    .inst_count = t->inst_count,
+    .warmup = t->warmup,
+    .interval = t->interval,
+    .total_insts = total_insts,
+    .weight = t->weight,
+    .mbase = CONFIG_MBASE,
+    .msize = CONFIG_MSIZE,
+    .pc = cpu.pc,
+    .mstatus = cpu.csr[MSTATUS],
+    .mtvec = cpu.csr[MTVEC],
+    .mepc = cpu.csr[MEPC],
+    .mcause = cpu.csr[MCAUSE],
+  };
+  for (int i = 0; i < ARRLEN(h.gpr); i++) h.gpr[i] = cpu.gpr[i];
+
+  // 先占位写头部, 写完页面后再回填 npages
+  fwrite(&h, sizeof(h), 1, fp);
+  for (paddr_t off = 0; off < CONFIG_MSIZE; off += SIMPOINT_PAGE_SIZE) {
+    // 没有访问过的块不要去读, 否则 MEM_RANDOM 会把它填满随机值, 检查点就变成整个 pmem 了
+    if (!pmem_chunk_touched(CONFIG_MBASE + off)) continue;
+    uint8_t *p = guest_to_host(CONFIG_MBASE + off);
+    if (page_is_zero(p)) continue;
+    uint32_t paddr = CONFIG_MBASE + off;
+    fwrite(&paddr, sizeof(paddr), 1, fp);
+    fwrite(p, SIMPOINT_PAGE_SIZE, 1, fp);
+    h.npages++;
+  }
+#ifdef CONFIG_DEVICE
+  for (int i = 0; i < nr_map; i++) {
+    SimpointCkptDev d = { .len = maps[i].high - maps[i].low + 1 };
+    snprintf(d.name, sizeof(d.name), "%s", maps[i].name);
+    fwrite(&d, sizeof(d), 1, fp);
+    fwrite(maps[i].space, d.len, 1, fp);
+    h.ndevs++;
+  }
+#endif
+  fseek(fp, 0, SEEK_SET);
+  fwrite(&h, sizeof(h), 1, fp);
+  fclose(fp);
+
+  // NPC 按索引文件找检查点, 不用扫描目录
+  FILE *idx = open_in_dir(SIMPOINT_CKPT_INDEX, "a");
+  fprintf(idx, "%s %u %.9f\n", name, t->cluster, t->weight);
+  fclose(idx);
+
+  Log("simpoint: checkpoint %s at inst %" PRIu64 ", pc = " FMT_WORD ", %u pages",
+      name, t->inst_count, cpu.pc, h.npages);
+}
+
+static int cmp_ckpt(const void *a, const void *b) {
+  uint64_t x = ((const CkptTarget *)a)->inst_count;
+  uint64_t y = ((const CkptTarget *)b)->inst_count;
+  return (x > y) - (x < y);
+}
+
+static void load_simpoints(void) {
+  FILE *fp = open_in_dir("summary", "r");
+  int interval = 0;
+  int ret = fscanf(fp, "interval %d\ninsts %" SCNu64, &interval, &total_insts);
+  Assert(ret == 2, "simpoint: bad summary file in %s", sp_dir);
+  Assert(interval == CONFIG_SIMPOINT_INTERVAL,
+      "simpoint: profiled with interval %d, but CONFIG_SIMPOINT_INTERVAL = %d", interval, CONFIG_SIMPOINT_INTERVAL);
+  fclose(fp);
+
+  FILE *sp_fp = open_in_dir("simpoints", "r");
+  FILE *w_fp = open_in_dir("weights", "r");
+  size_t cap = 0;
+  uint64_t idx;
+  uint32_t cluster, wcluster;
+  double weight;
+  while (fscanf(sp_fp, "%" SCNu64 " %u", &idx, &cluster) == 2) {
+    Assert(fscanf(w_fp, "%lf %u", &weight, &wcluster) == 2 && wcluster == cluster,
+        "simpoint: simpoints and weights do not match");
+    if (ckpt_cnt >= cap) {
+      cap = cap ? cap * 2 : 16;
+      ckpts = realloc(ckpts, cap * sizeof(CkptTarget));
+      Assert(ckpts, "simpoint: no memory");
+    }
+    uint64_t start = idx * CONFIG_SIMPOINT_INTERVAL;
+    uint64_t warmup = start < CONFIG_SIMPOINT_WARMUP ? start : CONFIG_SIMPOINT_WARMUP;
+    uint64_t len = total_insts - start < CONFIG_SIMPOINT_INTERVAL ? total_insts - start : CONFIG_SIMPOINT_INTERVAL;
+    ckpts[ckpt_cnt++] = (CkptTarget){
+      .inst_count = start - warmup, .warmup = warmup, .interval = len,
+      .weight = weight, .cluster = cluster,
+    };
+  }
+  fclose(sp_fp);
+  fclose(w_fp);
+  Assert(ckpt_cnt > 0, "simpoint: no simpoint found in %s", sp_dir);
+  qsort(ckpts, ckpt_cnt, sizeof(CkptTarget), cmp_ckpt);
+}
+
+static void ckpt_check(void) {
+  while (ckpt_next < ckpt_cnt && ckpts[ckpt_next].inst_count == g_nr_guest_inst) {
+    ckpt_dump(&ckpts[ckpt_next++]);
+  }
+  if (ckpt_next == ckpt_cnt) {
+    Log("simpoint: all %zu checkpoints are dumped", ckpt_cnt);
+    nemu_state.state = NEMU_QUIT; // 后面的指令不需要再执行
+    sp_mode = SP_OFF;
+  }
+}
+
+// ===============================  接口  ===============================
+
+void init_simpoint(const char *profile_dir, const char *ckpt_dir) {
+  if (profile_dir == NULL && ckpt_dir == NULL) return;
+  Assert(profile_dir == NULL || ckpt_dir == NULL, "simpoint: --simpoint-profile and --simpoint-ckpt are exclusive");
+
+  sp_mode = profile_dir ? SP_PROFILE : SP_CKPT;
+  snprintf(sp_dir, sizeof(sp_dir), "%s", profile_dir ? profile_dir : ckpt_dir);
+
+  if (sp_mode == SP_PROFILE) {
+    bbv_fp = open_in_dir("bbv", "w"); // SimPoint 3.2 的 .bb 格式, 可以直接交给官方工具
+    Log("simpoint: profiling with interval = %d, output to %s", CONFIG_SIMPOINT_INTERVAL, sp_dir);
+  } else {
+    load_simpoints();
+    fclose(open_in_dir(SIMPOINT_CKPT_INDEX, "w")); // 清空索引, 每写一个检查点追加一行
+    Log("simpoint: %zu checkpoints will be dumped to %s", ckpt_cnt, sp_dir);
+    ckpt_check(); // 第 0 条指令处的检查点
+  }
+}
+
+void simpoint_step(vaddr_t pc, vaddr_t snpc, vaddr_t dnpc) {
+  switch (sp_mode) {
+    case SP_PROFILE:
+      if (cur_bb_len == 0) cur_bb_pc = pc;
+      cur_bb_len++;
+      if (dnpc != snpc) bb_end(); // 控制流转移, 基本块结束
+      if (--interval_left == 0) {
+        interval_end();
+        interval_left = CONFIG_SIMPOINT_INTERVAL;
+      }
+      break;
+    case SP_CKPT: ckpt_check(); break;
+    default: break;
+  }
+}
+
+void simpoint_finish(void) {
+  switch (sp_mode) {
+    case SP_PROFILE: profile_finish(); break;
+    case SP_CKPT:
+      Log("simpoint: program ended with %zu of %zu checkpoints dumped", ckpt_next, ckpt_cnt);
+      break;
+    default: break;
+  }
+  sp_mode = SP_OFF;
+}
@@ -0,0 +1,473 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NEMU is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+// 后台写日志的线程, 环的定义见 include/utils/tracelog.h
+// 写线程没有运行时 (已经退出, 或者创建失败), 由 CPU 线程自己清空环
+
+#include <utils/tracelog.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef CONFIG_TRACE_GZIP
+#include <zlib.h>
+#endif
+
+// 写线程每写这么多字节刷新一次文件, tracelog_sync 和退出时也会刷新
+#define FLUSH_BYTES (64 * 1024)
+// 环为空时写线程最多睡这么久; CPU 线程等空间或者 tracelog_sync 时会马上叫醒它
+#define IDLE_NS (1000 * 1000)
+
+// 一条 TREC_FMT 最多带这么多条 TREC_ARGS, 参数更多的退回到 TREC_TEXT
+#define FMT_MAX_RECS UINT8_MAX
+#define FMT_MAX_ARGS 16
+static_assert(CONFIG_TRACE_RING_SIZE > FMT_MAX_RECS, "CONFIG_TRACE_RING_SIZE is too small");
+
+TraceRec trace_ring[CONFIG_TRACE_RING_SIZE];
+_Atomic size_t trace_head = 0, trace_tail = 0;
+
+static FILE *out_fp = NULL;
+IFDEF(CONFIG_TRACE_GZIP, static gzFile out_gz = NULL);
+
+static pthread_t writer_tid;
+static bool running = false;    // 写线程是否存在, 只由 CPU 线程修改
+static bool stopped = false;    // 退出之后不再启动写线程
+static size_t unflushed = 0;    // 上次刷新之后写出的字节数, 只由写日志的一方访问
+
+// 以下由 lock 保护
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cv = PTHREAD_COND_INITIALIZER; // 叫醒写线程
+static pthread_cond_t cpu_cv = PTHREAD_COND_INITIALIZER;    // 叫醒等待中的 CPU 线程
+static bool stop_req = false;
+static bool flush_req = false;  // tracelog_sync 请求写线程刷新
+static bool cpu_waiting = false;
+
+#ifdef CONFIG_ITRACE
+bool gen_logbuf(char *logbuf, size_t size, vaddr_t pc, vaddr_t snpc, const ISADecodeInfo *isa);
+#endif
+
+// printf 的一个转换说明需要的参数类型
+typedef enum {
+  ARG_NONE, ARG_INT, ARG_LONG, ARG_LLONG, ARG_SIZE, ARG_INTMAX, ARG_PTRDIFF,
+  ARG_PTR, ARG_DOUBLE, ARG_STR, ARG_BAD,
+} ArgKind;
+
+typedef struct {
+  const char *start, *end; // 从 '%' 到转换字符 (含)
+  int nstar;               // 宽度和精度中 '*' 的个数, 各对应一个 int 参数
+  ArgKind kind;
+} FmtSpec;
+
+/// 解析 p (指向 '%') 处的转换说明
+/// @return 转换说明之后的位置
+static const char *parse_spec(const char *p, FmtSpec *s) {
+  s->start = p++;
+  s->nstar = 0;
+  while (*p && strchr("-+ #0'", *p)) p++;
+  if (*p == '*') { s->nstar++; p++; } else while (*p >= '0' && *p <= '9') p++;
+  if (*p == '.') {
+    p++;
+    if (*p == '*') { s->nstar++; p++; } else while (*p >= '0' && *p <= '9') p++;
+  }
+  int l = 0; // 'l' 的个数, 'L' 等不支持的修饰记为 -1
+  char mod = 0;
+  for (; *p && strchr("hlqjztL", *p); p++) {
+    if (*p == 'l') l++;
+    else if (*p == 'q') l += 2;
+    else if (*p != 'h') { if (mod) l = -1; mod = *p; }
+  }
+  s->end = p;
+  switch (*p) {
+    case '%': s->kind = ARG_NONE; break;
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+      if (*p == 'c' && l != 0) { s->kind = ARG_BAD; break; } // %lc
+      s->kind = l < 0 || (mod && l) ? ARG_BAD :
+        mod == 'z' ? ARG_SIZE : mod == 'j' ? ARG_INTMAX : mod == 't' ? ARG_PTRDIFF :
+        mod == 'L' ? ARG_BAD : l == 0 ? ARG_INT : l == 1 ? ARG_LONG : ARG_LLONG;
+      break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+      s->kind = mod || l < 0 ? ARG_BAD : ARG_DOUBLE; break; // 不支持 long double
+    case 's': s->kind = mod || l ? ARG_BAD : ARG_STR; break;
+    case 'p': s->kind = ARG_PTR; break;
+    default: s->kind = ARG_BAD; break; // 包括 %n
+  }
+  return *p ? p + 1 : p;
+}
+
+/************************************** 写线程 **************************************/
+
+static void out_vprintf(const char *fmt, va_list ap) {
+  int n;
+#ifdef CONFIG_TRACE_GZIP
+  if (out_gz != NULL) n = gzvprintf(out_gz, fmt, ap);
+  else
+#endif
+  n = vfprintf(out_fp, fmt, ap);
+  if (n > 0) unflushed += n;
+}
+
+static void out_write(const char *buf, size_t len) {
+#ifdef CONFIG_TRACE_GZIP
+  if (out_gz != NULL) gzwrite(out_gz, buf, len);
+  else
+#endif
+  fwrite(buf, 1, len, out_fp);
+  unflushed += len;
+}
+
+static void out_printf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  out_vprintf(fmt, ap);
+  va_end(ap);
+}
+
+static void out_flush(void) {
+  unflushed = 0;
+#ifdef CONFIG_TRACE_GZIP
+  if (out_gz != NULL) { gzflush(out_gz, Z_SYNC_FLUSH); return; }
+#endif
+  fflush(out_fp);
+}
+
+#define TAKE(type) ({ type _v; memcpy(&_v, *arg, sizeof(_v)); *arg += 8; _v; })
+
+// 按 fmt 格式化 TREC_ARGS 中的参数, 每个转换说明单独调用一次 printf
+static void out_fmt(const char *fmt, const uint8_t *args) {
+  const uint8_t **arg = &args;
+  const char *p = fmt;
+  while (*p) {
+    const char *q = strchr(p, '%');
+    if (q == NULL) { out_write(p, strlen(p)); break; }
+    if (q > p) out_write(p, q - p);
+    FmtSpec s;
+    p = parse_spec(q, &s);
+    if (s.kind == ARG_NONE) { out_write("%", 1); continue; }
+
+    // 把 '*' 换成对应参数的值
+    char spec[64];
+    size_t n = 0;
+    for (const char *c = s.start; c <= s.end && n < sizeof(spec) - 16; c++) {
+      if (*c != '*') { spec[n++] = *c; continue; }
+      int v = TAKE(int64_t);
+      if (v < 0 && c[-1] == '.') n--; // 负的精度相当于没有精度
+      else n += sprintf(spec + n, "%d", v);
+    }
+    spec[n] = '\0';
+
+    switch (s.kind) {
+      case ARG_INT:     out_printf(spec, (int)TAKE(int64_t)); break;
+      case ARG_LONG:    out_printf(spec, (long)TAKE(int64_t)); break;
+      case ARG_LLONG:   out_printf(spec, (long long)TAKE(int64_t)); break;
+      case ARG_SIZE:    out_printf(spec, (size_t)TAKE(int64_t)); break;
+      case ARG_INTMAX:  out_printf(spec, (intmax_t)TAKE(int64_t)); break;
+      case ARG_PTRDIFF: out_printf(spec, (ptrdiff_t)TAKE(int64_t)); break;
+      case ARG_PTR:     out_printf(spec, (void *)(uintptr_t)TAKE(int64_t)); break;
+      case ARG_DOUBLE:  out_printf(spec, TAKE(double)); break;
+      case ARG_STR: {
+        uint32_t len = TAKE(uint32_t);
+        *arg -= 8 - sizeof(len);
+        out_printf(spec, (const char *)*arg); // 长度里包括了 '\0'
+        *arg += len;
+        break;
+      }
+      default: break;
+    }
+  }
+}
+
+/// @return 处理的记录数
+static size_t format_rec(size_t i) {
+  TraceRec *r = &trace_ring[i & TRACE_RING_MASK];
+  switch (r->type) {
+    case TREC_TEXT:
+      out_write(r->text, r->len);
+      break;
+    case TREC_FMT: {
+      uint8_t args[FMT_MAX_RECS * TREC_TEXT_CHUNK];
+      for (int j = 0; j < r->len; j++) {
+        memcpy(args + j * TREC_TEXT_CHUNK, trace_ring[(i + 1 + j) & TRACE_RING_MASK].text, TREC_TEXT_CHUNK);
+      }
+      out_fmt(r->fmt, args);
+      return 1 + r->len;
+    }
+#ifdef CONFIG_ITRACE
+    case TREC_INST: {
+      char logbuf[128];
+      if (gen_logbuf(logbuf, sizeof(logbuf), r->pc, r->inst.snpc, &r->inst.isa)) {
+        out_printf("%s\n", logbuf);
+      }
+      break;
+    }
+#endif
+    case TREC_MEM:
+      out_printf("[mtrace] %c pc=" FMT_WORD " addr=" FMT_WORD " len=%d data=" FMT_WORD "\n",
+          r->kind, r->pc, r->mem.addr, r->len, r->mem.data);
+      break;
+    case TREC_DEV:
+      out_printf("[dtrace] %c pc=" FMT_WORD " device=%s len=%d data=" FMT_WORD "\n",
+          r->kind, r->pc, r->dev.name, r->len, r->dev.data);
+      break;
+    case TREC_EXC:
+      out_printf("[etrace] %c cause=" FMT_WORD " epc=" FMT_WORD " handler=" FMT_WORD "\n",
+          r->kind, r->exc.cause, r->pc, r->exc.handler);
+      break;
+    default: break;
+  }
+  return 1;
+}
+
+/// @return 处理的记录数
+static size_t drain(void) {
+  size_t t = atomic_load_explicit(&trace_tail, memory_order_relaxed);
+  size_t h = atomic_load_explicit(&trace_head, memory_order_acquire);
+  for (size_t i = t; i < h; ) i += format_rec(i);
+  if (unflushed >= FLUSH_BYTES) out_flush();
+  atomic_store_explicit(&trace_tail, h, memory_order_release);
+  return h - t;
+}
+
+static bool ring_empty(void) {
+  return atomic_load_explicit(&trace_head, memory_order_acquire) ==
+    atomic_load_explicit(&trace_tail, memory_order_relaxed);
+}
+
+static void *writer(void *arg) {
+  pthread_mutex_lock(&lock);
+  while (true) {
+    pthread_mutex_unlock(&lock);
+    size_t n = drain();
+    pthread_mutex_lock(&lock);
+    if (n > 0) {
+      if (cpu_waiting) pthread_cond_broadcast(&cpu_cv);
+      continue;
+    }
+    // 环已经空了, 刷新之后 tracelog_sync 才返回
+    if (flush_req) {
+      out_flush();
+      flush_req = false;
+      pthread_cond_broadcast(&cpu_cv);
+    }
+    if (stop_req) break;
+    if (ring_empty()) {
+      // CPU 线程写记录时不通知, 所以只睡一小会
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += IDLE_NS;
+      if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+      pthread_cond_timedwait(&writer_cv, &lock, &ts);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+static void start_writer(void) {
+  stop_req = false;
+  running = pthread_create(&writer_tid, NULL, writer, NULL) == 0;
+}
+
+static void stop_writer(void) {
+  if (running) {
+    pthread_mutex_lock(&lock);
+    stop_req = true;
+    pthread_cond_signal(&writer_cv);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer_tid, NULL);
+    running = false;
+  }
+  drain();
+  out_flush();
+}
+
+/************************************** CPU 线程 **************************************/
+
+void tracelog_wait_space(size_t n) {
+  if (!running) { drain(); return; }
+  pthread_mutex_lock(&lock);
+  cpu_waiting = true;
+  pthread_cond_signal(&writer_cv);
+  size_t h = atomic_load_explicit(&trace_head, memory_order_relaxed);
+  while (h + n - atomic_load_explicit(&trace_tail, memory_order_acquire) > CONFIG_TRACE_RING_SIZE) {
+    pthread_cond_wait(&cpu_cv, &lock);
+  }
+  cpu_waiting = false;
+  pthread_mutex_unlock(&lock);
+}
+
+// 等环清空并且文件刷新, 之后可以安全地 fork 或者 abort
+void tracelog_sync(void) {
+  if (out_fp == NULL) return;
+  if (!running) { drain(); out_flush(); return; }
+  pthread_mutex_lock(&lock);
+  flush_req = true;
+  cpu_waiting = true;
+  pthread_cond_signal(&writer_cv);
+  while (flush_req) pthread_cond_wait(&cpu_cv, &lock);
+  cpu_waiting = false;
+  pthread_mutex_unlock(&lock);
+}
+
+// 每个格式串只解析一次; 格式串都是字符串常量, 按地址缓存
+typedef struct {
+  const char *fmt;
+  int nargs;   // -1 表示有不支持的转换说明
+  uint8_t kind[FMT_MAX_ARGS];
+} FmtInfo;
+
+#define FMT_CACHE_SIZE 256
+static FmtInfo fmt_cache[FMT_CACHE_SIZE];
+
+static const FmtInfo *fmt_info(const char *fmt) {
+  FmtInfo *f = &fmt_cache[((uintptr_t)fmt >> 3) % FMT_CACHE_SIZE];
+  if (f->fmt == fmt) return f;
+  f->fmt = fmt;
+  f->nargs = 0;
+  for (const char *p = strchr(fmt, '%'); p != NULL && f->nargs >= 0; p = strchr(p, '%')) {
+    FmtSpec s;
+    p = parse_spec(p, &s);
+    if (s.kind == ARG_NONE) continue;
+    if (s.kind == ARG_BAD || f->nargs + s.nstar + 1 > FMT_MAX_ARGS) { f->nargs = -1; break; }
+    for (int i = 0; i < s.nstar; i++) f->kind[f->nargs++] = ARG_INT;
+    f->kind[f->nargs++] = s.kind;
+  }
+  return f;
+}
+
+#define PUT(type, v) ({ type _v = (v); memcpy(buf + n, &_v, sizeof(_v)); n += 8; })
+
+/// 把参数原样放进 TREC_ARGS, 由写线程格式化
+/// @return false 表示格式串不支持或者参数太长, 这时不会写入任何记录
+static bool push_fmt(const char *fmt, va_list ap) {
+  const FmtInfo *f = fmt_info(fmt);
+  if (f->nargs < 0) return false;
+  uint8_t buf[FMT_MAX_RECS * TREC_TEXT_CHUNK];
+  size_t n = 0;
+  for (int i = 0; i < f->nargs; i++) {
+    switch (f->kind[i]) {
+      case ARG_INT:     PUT(int64_t, va_arg(ap, int)); break;
+      case ARG_LONG:    PUT(int64_t, va_arg(ap, long)); break;
+      case ARG_LLONG:   PUT(int64_t, va_arg(ap, long long)); break;
+      case ARG_SIZE:    PUT(int64_t, va_arg(ap, size_t)); break;
+      case ARG_INTMAX:  PUT(int64_t, va_arg(ap, intmax_t)); break;
+      case ARG_PTRDIFF: PUT(int64_t, va_arg(ap, ptrdiff_t)); break;
+      case ARG_PTR:     PUT(int64_t, (uintptr_t)va_arg(ap, void *)); break;
+      case ARG_DOUBLE:  PUT(double, va_arg(ap, double)); break;
+      case ARG_STR: {
+        const char *str = va_arg(ap, const char *);
+        if (str == NULL) str = "(null)";
+        uint32_t len = strlen(str) + 1;
+        if (n + sizeof(len) + len > sizeof(buf)) return false;
+        memcpy(buf + n, &len, sizeof(len));
+        memcpy(buf + n + sizeof(len), str, len);
+        n += sizeof(len) + len;
+        break;
+      }
+    }
+    if (n + 8 > sizeof(buf)) return false;
+  }
+
+  size_t nrecs = (n + TREC_TEXT_CHUNK - 1) / TREC_TEXT_CHUNK;
+  size_t h = tracelog_reserve(1 + nrecs);
+  trace_ring[h & TRACE_RING_MASK] = (TraceRec){ .type = TREC_FMT, .len = nrecs, .fmt = fmt };
+  for (size_t i = 0; i < nrecs; i++) {
+    TraceRec *r = &trace_ring[(h + 1 + i) & TRACE_RING_MASK];
+    r->type = TREC_ARGS;
+    memcpy(r->text, buf + i * TREC_TEXT_CHUNK, TREC_TEXT_CHUNK);
+  }
+  tracelog_commit(h + 1 + nrecs);
+  return true;
+}
+
+// 不支持的格式串 (例如 long double) 在 CPU 线程上格式化, 切成 TREC_TEXT
+static void push_text(const char *fmt, va_list ap) {
+  va_list aq;
+  va_copy(aq, ap);
+  int n = vsnprintf(NULL, 0, fmt, aq);
+  va_end(aq);
+  if (n <= 0) return;
+  char buf[n + 1];
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  TraceRec r = { .type = TREC_TEXT };
+  for (int i = 0; i < n; i += TREC_TEXT_CHUNK) {
+    r.len = n - i < TREC_TEXT_CHUNK ? n - i : TREC_TEXT_CHUNK;
+    memcpy(r.text, buf + i, r.len);
+    tracelog_push(&r);
+  }
+}
+
+void tracelog_printf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  if (stopped) {
+    out_vprintf(fmt, ap);
+    out_flush();
+  } else {
+    va_list aq;
+    va_copy(aq, ap);
+    if (!push_fmt(fmt, aq)) push_text(fmt, ap);
+    va_end(aq);
+  }
+  va_end(ap);
+}
+
+static void tracelog_close(void) {
+  stop_writer();
+  stopped = true;
+#ifdef CONFIG_TRACE_GZIP
+  if (out_gz != NULL) { gzclose(out_gz); out_gz = NULL; }
+#endif
+  fflush(out_fp);
+}
+
+// fork 之前清空环并拿住锁, 这样子进程里的锁和环都是干净的
+static void atfork_prepare(void) {
+  tracelog_sync();
+  pthread_mutex_lock(&lock);
+}
+
+static void atfork_parent(void) { pthread_mutex_unlock(&lock); }
+
+// 子进程里没有写线程, 在这之后到 tracelog_restart 之前由 CPU 线程自己清空环
+static void atfork_child(void) {
+  // 父进程的写线程可能正等在条件变量上, 子进程里重新初始化
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&writer_cv, NULL);
+  pthread_cond_init(&cpu_cv, NULL);
+  running = false;
+}
+
+// fork 出来的子进程 (例如被唤醒的快照) 要继续运行时调用, 重新启动写线程
+void tracelog_restart(void) {
+  if (out_fp != NULL && !running && !stopped) start_writer();
+}
+
+void init_tracelog(FILE *fp, bool compress) {
+  out_fp = fp;
+#ifdef CONFIG_TRACE_GZIP
+  if (compress) {
+    fflush(fp);
+    out_gz = gzdopen(dup(fileno(fp)), "wb");
+    Assert(out_gz, "Can not compress the log file");
+  }
+#else
+  (void)compress;
+#endif
+  pthread_atfork(atfork_prepare, atfork_parent, atfork_child);
+  atexit(tracelog_close);
+  start_writer();
+}
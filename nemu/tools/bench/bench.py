@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+
+# 标准 benchmark: 每个负载在固定的 CPU 上跑若干次, 通过 perfrun 拿到 host 的
+# 周期数/指令数和峰值 RSS, 结合 statistic() 的输出写成 CSV
+#
+# 例子:
+#   bench.py --sim $NEMU_HOME/build/riscv32-nemu-interpreter --arch riscv32-nemu \
+#            --perfrun $NEMU_HOME/tools/perfrun/build/perfrun --runs 5 --cpu 2 \
+#            --csv build/bench.csv $AM_KERNELS_HOME/benchmarks/coremark ...
+
+import argparse
+import csv
+import glob
+import os
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'regress'))
+from regress import ANSI_RE, SIM_ENV, parse_output # noqa: E402
+
+EXTRA_PATTERNS = {
+    'cycles_per_sec': re.compile(r'simulation frequency = (\d+) cycles/s'), # 只有 NPC 有
+    'sim_cycles': re.compile(r'RTL cycles = (\d+)'),
+}
+PERFRUN_RE = re.compile(r'perfrun: cycles=(-?\d+) instructions=(-?\d+) maxrss_kb=(\d+) wall_us=(\d+)')
+
+COLUMNS = ['workload', 'run', 'status', 'guest_insts', 'host_us', 'mips', 'host_cycles', 'host_insts',
+           'host_cycles_per_inst', 'maxrss_kb', 'wall_us', 'sim_cycles', 'cycles_per_sec', 'ipc']
+
+
+def find_image(path, arch):
+    """path 是一个 AM 程序的目录 (镜像在 build/ 下) 或者镜像本身"""
+    if os.path.isfile(path):
+        return os.path.abspath(path)
+    images = glob.glob(os.path.join(path, 'build', '*-' + arch + '.bin'))
+    if len(images) != 1:
+        sys.exit('{0}: expect exactly one *-{1}.bin under build/, found {2}'.format(path, arch, len(images)))
+    return os.path.abspath(images[0])
+
+
+def run_once(opts, image, log):
+    with tempfile.NamedTemporaryFile('r', suffix='.perfrun') as res:
+        cmd = [opts.perfrun, '-o', res.name]
+        if opts.cpu >= 0:
+            cmd += ['-c', str(opts.cpu)]
+        cmd += ['--', opts.sim, '-b', '--log=' + log] + opts.args.split() + [image]
+        p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, stdin=subprocess.DEVNULL,
+                           env=SIM_ENV, timeout=opts.timeout)
+        out = p.stdout.decode(errors='replace')
+        perf = PERFRUN_RE.search(res.read())
+
+    r = parse_output(out)
+    text = ANSI_RE.sub('', out)
+    for key, pat in EXTRA_PATTERNS.items():
+        m = pat.findall(text)
+        if m:
+            r[key] = int(m[-1])
+    row = {
+        'status': r['status'],
+        'guest_insts': r.get('insts'),
+        'host_us': r.get('host_us'),
+        'sim_cycles': r.get('sim_cycles'),
+        'cycles_per_sec': r.get('cycles_per_sec'),
+        'ipc': r.get('ipc'),
+    }
+    if r.get('insts') and r.get('host_us'):
+        row['mips'] = round(r['insts'] / r['host_us'], 3)
+    if perf:
+        cycles, insts, rss, wall = (int(x) for x in perf.groups())
+        row.update({'host_cycles': cycles if cycles >= 0 else None,
+                    'host_insts': insts if insts >= 0 else None,
+                    'maxrss_kb': rss, 'wall_us': wall})
+        if cycles >= 0 and r.get('insts'):
+            row['host_cycles_per_inst'] = round(cycles / r['insts'], 2)
+    return row
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run the standard benchmarks on NEMU/NPC')
+    parser.add_argument('workloads', nargs='+', help='AM program directories or image files')
+    parser.add_argument('--sim', required=True, help='NEMU/NPC binary')
+    parser.add_argument('--arch', required=True, help='images are named NAME-ARCH.bin, e.g. riscv32-nemu')
+    parser.add_argument('--args', default='', help='extra arguments for the simulator')
+    parser.add_argument('--perfrun', required=True, help='the perfrun tool')
+    parser.add_argument('--runs', type=int, default=5, help='runs of each workload')
+    parser.add_argument('--cpu', type=int, default=-1, help='pin the simulator to this cpu')
+    parser.add_argument('--timeout', type=float, default=600, help='timeout of each run in seconds')
+    parser.add_argument('--csv', default='build/bench.csv', help='output file')
+    opts = parser.parse_args()
+
+    logdir = os.path.join(os.path.dirname(os.path.abspath(opts.csv)), 'bench-log')
+    os.makedirs(logdir, exist_ok=True)
+    rows = []
+    for w in opts.workloads:
+        image = find_image(w, opts.arch)
+        name = os.path.basename(image)[:-len('-' + opts.arch + '.bin')]
+        for i in range(opts.runs):
+            row = run_once(opts, image, os.path.join(logdir, '{0}-{1}.log'.format(name, i)))
+            row.update({'workload': name, 'run': i})
+            rows.append(row)
+            print('{0:<12} run {1}: {2:<8} {3} MIPS, {4} host cycles/inst, {5} KB'.format(
+                name, i, row['status'], row.get('mips', '-'), row.get('host_cycles_per_inst', '-'),
+                row.get('maxrss_kb', '-')))
+
+    with open(opts.csv, 'w', newline='') as fp:
+        writer = csv.DictWriter(fp, fieldnames=COLUMNS)
+        writer.writeheader()
+        for row in rows:
+            writer.writerow({k: ('' if row.get(k) is None else row[k]) for k in COLUMNS})
+
+    # 每个负载取中位数
+    print('{0:<12} {1:>10} {2:>14} {3:>12}'.format('workload', 'MIPS', 'cycles/inst', 'cycles/s'))
+    for name in dict.fromkeys(r['workload'] for r in rows):
+        rs = [r for r in rows if r['workload'] == name and r['status'] == 'pass']
+
+        def median(key):
+            vals = [r[key] for r in rs if r.get(key) is not None]
+            return statistics.median(vals) if vals else '-'
+        print('{0:<12} {1:>10} {2:>14} {3:>12}'.format(name, median('mips'), median('host_cycles_per_inst'),
+                                                      median('cycles_per_sec')))
+    print('results: ' + opts.csv)
+    return 0 if all(r['status'] == 'pass' for r in rows) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,33 @@
+// 访存密集型负载: STREAM 风格的 copy/scale/add/triad, 再加一段跨步的 gather,
+// 三个数组各 2MB, 远大于 host 的 L2
+#include <am.h>
+#include <klib.h>
+#include <klib-macros.h>
+
+#define N (512 * 1024)
+#define ITERS 4
+#define STRIDE 7919 // 质数, 和 N 互质, 每次访问落在不同的 cache 行
+
+static uint32_t a[N], b[N], c[N];
+
+int main(const char *args) {
+  for (int i = 0; i < N; i++) { a[i] = i; b[i] = 0; c[i] = 0; }
+
+  // 每一轮之后 a[i] 变成原来的 15 倍
+  for (int k = 0; k < ITERS; k++) {
+    for (int i = 0; i < N; i++) c[i] = a[i];
+    for (int i = 0; i < N; i++) b[i] = 3 * c[i];
+    for (int i = 0; i < N; i++) c[i] = a[i] + b[i];
+    for (int i = 0; i < N; i++) a[i] = b[i] + 3 * c[i];
+  }
+
+  uint32_t scale = 1, sum = 0, expect = 0;
+  for (int k = 0; k < ITERS; k++) scale *= 15;
+  for (uint32_t i = 0, j = 0; i < N; i++, j = (j + STRIDE) & (N - 1)) {
+    sum += a[j];
+    expect += j * scale;
+  }
+
+  printf("memstream: %d words x %d iterations, checksum = 0x%x\n", N, ITERS, sum);
+  return sum != expect;
+}
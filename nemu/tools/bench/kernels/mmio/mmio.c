@@ -0,0 +1,22 @@
+// MMIO 密集型负载: 反复读时钟 (每次两个 MMIO 读), 间或通过串口输出进度
+#include <am.h>
+#include <klib.h>
+#include <klib-macros.h>
+
+#define ROUNDS 200000
+
+int main(const char *args) {
+  ioe_init();
+  uint64_t last = 0;
+  int backwards = 0;
+  for (int i = 0; i < ROUNDS; i++) {
+    uint64_t us = io_read(AM_TIMER_UPTIME).us;
+    if (us < last) backwards++;
+    last = us;
+    if (i % (ROUNDS / 10) == 0) putch('.');
+  }
+  putch('\n');
+
+  printf("mmio: %d timer reads, time went backwards %d times\n", ROUNDS, backwards);
+  return backwards != 0;
+}
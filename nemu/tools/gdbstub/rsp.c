@@ -0,0 +1,344 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include "rsp.h"
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define PACKET_SIZE 4096
+
+static const RspTarget *tgt = NULL;
+static int conn_fd = -1;
+
+static char rx_buf[PACKET_SIZE];
+static int rx_len = 0, rx_pos = 0;
+
+static const char *reg_names[RSP_NR_REGS] = {
+  "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+  "fp", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+  "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+  "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6", "pc",
+};
+
+// ------------------------------ 连接 ------------------------------
+
+static int wait_for_gdb(const char *addr) {
+  bool is_tcp = addr[strspn(addr, "0123456789")] == '\0';
+  int fd = socket(is_tcp ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+  Assert(fd >= 0, "gdbstub: can not create socket");
+  if (is_tcp) {
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(atoi(addr)),
+                              .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    Assert(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0, "gdbstub: can not bind port %s", addr);
+  } else {
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    strncpy(sa.sun_path, addr, sizeof(sa.sun_path) - 1);
+    unlink(addr);
+    Assert(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0, "gdbstub: can not bind %s", addr);
+  }
+  Assert(listen(fd, 1) == 0, "gdbstub: listen failed");
+  Log("Waiting for gdb on %s%s", is_tcp ? "localhost:" : "", addr);
+
+  int c;
+  while ((c = accept(fd, NULL, NULL)) < 0 && errno == EINTR) ; // 设备的 alarm 信号
+  Assert(c >= 0, "gdbstub: accept failed");
+  close(fd);
+  if (is_tcp) {
+    int one = 1;
+    setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  Log("gdb connected");
+  return c;
+}
+
+/// 缓冲区空了时阻塞地读一次
+/// @return false 表示连接断开
+static bool fill_rx(void) {
+  if (rx_pos < rx_len) { return true; }
+  do { rx_len = recv(conn_fd, rx_buf, sizeof(rx_buf), 0); } while (rx_len < 0 && errno == EINTR);
+  rx_pos = 0;
+  if (rx_len <= 0) { rx_len = 0; return false; }
+  return true;
+}
+
+static int get_char(void) {
+  return fill_rx() ? (uint8_t)rx_buf[rx_pos++] : -1;
+}
+
+static void put_bytes(const char *buf, int len) {
+  while (len > 0) {
+    int n = send(conn_fd, buf, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return; }
+    buf += n;
+    len -= n;
+  }
+}
+
+// ------------------------------ 包 ------------------------------
+
+static const char hexchars[] = "0123456789abcdef";
+
+static int hex(int c) {
+  if (c >= '0' && c <= '9') { return c - '0'; }
+  if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+  if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+  return -1;
+}
+
+/// @return 包的长度, 连接断开时返回 -1
+static int recv_packet(char *buf, int size) {
+  while (true) {
+    int c;
+    while ((c = get_char()) != '$') {
+      if (c < 0) { return -1; }
+    }
+    int len = 0;
+    uint8_t sum = 0;
+    while ((c = get_char()) != '#') {
+      if (c < 0) { return -1; }
+      sum += c;
+      if (len < size - 1) { buf[len++] = c; }
+    }
+    int c1 = get_char(), c2 = get_char();
+    if (c1 < 0 || c2 < 0) { return -1; }
+    if (hex(c1) * 16 + hex(c2) == sum) {
+      put_bytes("+", 1);
+      buf[len] = '\0';
+      return len;
+    }
+    put_bytes("-", 1);
+  }
+}
+
+static void send_packet(const char *data) {
+  static char out[PACKET_SIZE * 2 + 8];
+  int len = strlen(data);
+  Assert(len < PACKET_SIZE * 2, "gdbstub: reply too long");
+  uint8_t sum = 0;
+  for (int i = 0; i < len; i++) { sum += data[i]; }
+  int n = sprintf(out, "$%s#%02x", data, sum);
+  while (true) {
+    put_bytes(out, n);
+    // 等 '+'/'-'; 下一个包的 '$' 留给 recv_packet, 对方发了新包也说明收到了
+    int c;
+    do {
+      if (!fill_rx()) { return; }
+      c = rx_buf[rx_pos];
+      if (c == '$') { return; }
+      rx_pos++;
+    } while (c != '+' && c != '-');
+    if (c == '+') { return; }
+  }
+}
+
+static char *put_hex_word(char *p, word_t v) {
+  for (int i = 0; i < sizeof(word_t); i++, v >>= 8) { // 小端
+    *p++ = hexchars[(v >> 4) & 0xf];
+    *p++ = hexchars[v & 0xf];
+  }
+  *p = '\0';
+  return p;
+}
+
+static const char *get_hex_word(const char *p, word_t *v) {
+  *v = 0;
+  for (int i = 0; i < sizeof(word_t); i++) {
+    int h = hex(p[0]), l = hex(p[1]);
+    if (h < 0 || l < 0) { return NULL; }
+    *v |= (word_t)(h * 16 + l) << (i * 8);
+    p += 2;
+  }
+  return p;
+}
+
+// ------------------------------ 执行 ------------------------------
+
+// 有数据到达时看一眼, 只取走 Ctrl-C, 其他字节留给之后的 recv_packet
+static bool gdb_interrupted(void) {
+  if (rx_pos == rx_len) {
+    struct pollfd pfd = { .fd = conn_fd, .events = POLLIN };
+    if (poll(&pfd, 1, 0) <= 0 || !fill_rx()) { return false; }
+  }
+  if (rx_buf[rx_pos] != 0x03) { return false; }
+  rx_pos++;
+  return true;
+}
+
+static void stop_reply(char *reply, int sig) {
+  int code = 0;
+  switch (tgt->status(&code)) {
+    case RSP_EXITED: sprintf(reply, "W%02x", code & 0xff); break;
+    case RSP_ABORTED: strcpy(reply, "X06"); break; // SIGABRT
+    default: sprintf(reply, "S%02x", sig); break;
+  }
+}
+
+static void resume(bool step, char *reply) {
+  if (tgt->status(&(int){0}) != RSP_STOPPED) { stop_reply(reply, 5); return; }
+  if (step) {
+    tgt->exec(1);
+    stop_reply(reply, 5); // SIGTRAP
+    return;
+  }
+  // 整段地执行, 断点和监视点由模拟器的执行循环检查, 段与段之间只看 Ctrl-C
+  while (!tgt->exec(tgt->run_chunk)) {
+    if (gdb_interrupted()) { stop_reply(reply, 2); return; } // SIGINT
+  }
+  stop_reply(reply, 5);
+}
+
+// ------------------------------ 请求 ------------------------------
+
+// 只描述 x0-x31 和 pc, gdb 就不会去问浮点寄存器和 csr
+static void target_xml(char *buf, int size) {
+  int n = snprintf(buf, size, "<?xml version=\"1.0\"?><!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+      "<target version=\"1.0\"><architecture>riscv:rv32</architecture><feature name=\"org.gnu.gdb.riscv.cpu\">");
+  for (int i = 0; i < RSP_NR_REGS; i++) {
+    n += snprintf(buf + n, size - n, "<reg name=\"%s\" bitsize=\"%d\" type=\"%s\"/>", reg_names[i],
+        (int)sizeof(word_t) * 8, i == RSP_PC ? "code_ptr" : (i == 1 || i == 2) ? "data_ptr" : "int");
+  }
+  snprintf(buf + n, size - n, "</feature></target>");
+}
+
+static void handle_query(const char *pkt, char *reply) {
+  if (strncmp(pkt, "qSupported", 10) == 0) {
+    sprintf(reply, "PacketSize=%x;qXfer:features:read+", PACKET_SIZE);
+  } else if (strcmp(pkt, "qAttached") == 0) {
+    strcpy(reply, "1");
+  } else if (strncmp(pkt, "qXfer:features:read:target.xml:", 31) == 0) {
+    static char xml[4096];
+    target_xml(xml, sizeof(xml));
+    unsigned long off = 0, len = 0;
+    sscanf(pkt + 31, "%lx,%lx", &off, &len);
+    unsigned long total = strlen(xml);
+    if (len > PACKET_SIZE - 2) { len = PACKET_SIZE - 2; }
+    if (off >= total) { strcpy(reply, "l"); return; }
+    bool last = off + len >= total;
+    reply[0] = last ? 'l' : 'm';
+    int n = last ? total - off : len;
+    memcpy(reply + 1, xml + off, n);
+    reply[n + 1] = '\0';
+  } else {
+    reply[0] = '\0'; // 不支持
+  }
+}
+
+/// @return false 表示 gdb 结束了调试
+static bool handle_packet(char *pkt, char *reply) {
+  static uint8_t mem[PACKET_SIZE / 2];
+  reply[0] = '\0';
+  char *p = pkt + 1;
+  switch (pkt[0]) {
+    case '?': stop_reply(reply, 5); break;
+    case 'g': {
+      char *q = reply;
+      for (int i = 0; i < RSP_NR_REGS; i++) {
+        word_t v = 0;
+        tgt->reg_read(i, &v); // RVE 没有 x16-x31, 读作 0
+        q = put_hex_word(q, v);
+      }
+      break;
+    }
+    case 'G': {
+      bool ok = true;
+      for (int i = 0; i < RSP_NR_REGS && p != NULL && *p; i++) {
+        word_t v;
+        if ((p = (char *)get_hex_word(p, &v)) != NULL && i != 0) { ok &= tgt->reg_write(i, v); }
+      }
+      strcpy(reply, ok ? "OK" : "E01");
+      break;
+    }
+    case 'p': {
+      word_t v;
+      if (tgt->reg_read(strtoul(p, NULL, 16), &v)) { put_hex_word(reply, v); } else { strcpy(reply, "E01"); }
+      break;
+    }
+    case 'P': {
+      char *eq;
+      int n = strtoul(p, &eq, 16);
+      word_t v;
+      bool ok = *eq == '=' && get_hex_word(eq + 1, &v) && tgt->reg_read(n, &(word_t){0});
+      if (ok && n != 0) { ok = tgt->reg_write(n, v); }
+      strcpy(reply, ok ? "OK" : "E01");
+      break;
+    }
+    case 'm': {
+      char *comma;
+      paddr_t addr = strtoul(p, &comma, 16);
+      word_t len = strtoul(comma + 1, NULL, 16);
+      if (len > sizeof(mem) || !tgt->mem_read(addr, mem, len)) { strcpy(reply, "E14"); break; }
+      for (word_t i = 0; i < len; i++) {
+        reply[i * 2] = hexchars[mem[i] >> 4];
+        reply[i * 2 + 1] = hexchars[mem[i] & 0xf];
+      }
+      reply[len * 2] = '\0';
+      break;
+    }
+    case 'M': {
+      char *comma, *colon;
+      paddr_t addr = strtoul(p, &comma, 16);
+      word_t len = strtoul(comma + 1, &colon, 16);
+      if (*colon != ':' || len > sizeof(mem) || strlen(colon + 1) < len * 2) { strcpy(reply, "E14"); break; }
+      bool ok = true;
+      for (word_t i = 0; i < len && ok; i++) {
+        int h = hex(colon[1 + i * 2]), l = hex(colon[2 + i * 2]);
+        ok = h >= 0 && l >= 0;
+        mem[i] = h * 16 + l;
+      }
+      if (!ok) { strcpy(reply, "E01"); break; }
+      strcpy(reply, tgt->mem_write(addr, mem, len) ? "OK" : "E14");
+      break;
+    }
+    case 'c': case 's':
+      if (*p && !tgt->reg_write(RSP_PC, strtoul(p, NULL, 16))) { strcpy(reply, "E01"); break; }
+      resume(pkt[0] == 's', reply);
+      break;
+    case 'Z': case 'z': {
+      // 软件断点和硬件断点都交给模拟器, 监视点不支持
+      if (p[0] != '0' && p[0] != '1') { break; }
+      vaddr_t addr = strtoul(p + 2, NULL, 16);
+      strcpy(reply, tgt->bp_set(addr, pkt[0] == 'Z') ? "OK" : "E01");
+      break;
+    }
+    case 'H': strcpy(reply, "OK"); break;
+    case 'q': handle_query(pkt, reply); break;
+    case 'k': tgt->kill(); return false;
+    case 'D': strcpy(reply, "OK"); send_packet(reply); return false;
+    default: break;
+  }
+  return true;
+}
+
+void rsp_serve(const char *addr, const RspTarget *target) {
+  static char pkt[PACKET_SIZE], reply[PACKET_SIZE * 2 + 1];
+  tgt = target;
+  conn_fd = wait_for_gdb(addr);
+  while (recv_packet(pkt, sizeof(pkt)) >= 0) {
+    if (!handle_packet(pkt, reply)) { break; }
+    send_packet(reply);
+    if (reply[0] == 'W' || reply[0] == 'X') { break; } // 程序已经结束
+  }
+  close(conn_fd);
+  conn_fd = -1;
+  Log("gdb disconnected");
+}
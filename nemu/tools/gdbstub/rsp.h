@@ -0,0 +1,51 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RSP_H__
+#define __RSP_H__
+
+// GDB 远程串行协议 (RSP) 的协议层, NEMU 和 NPC 共用:
+// 连接, 包的收发, 十六进制编码, 查询, 以及 continue 的分段执行都在 rsp.c 中,
+// 模拟器只提供 RspTarget 中的回调. rsp.c 用各自的 <common.h> 编译
+
+#include <common.h>
+
+#define RSP_NR_REGS 33 // x0-x31, pc
+#define RSP_PC 32
+
+typedef enum { RSP_STOPPED, RSP_EXITED, RSP_ABORTED } RspStatus;
+
+typedef struct {
+  uint64_t run_chunk; // continue 时每执行这么多条指令检查一次 Ctrl-C
+  /// @return false 表示没有这个寄存器
+  bool (*reg_read)(int n, word_t *val);
+  /// @return false 表示不能写这个寄存器, n 为 RSP_PC 时用于 `c ADDR'
+  bool (*reg_write)(int n, word_t val);
+  /// @return false 表示地址不合法
+  bool (*mem_read)(paddr_t addr, uint8_t *buf, word_t len);
+  bool (*mem_write)(paddr_t addr, const uint8_t *buf, word_t len);
+  /// @return false 表示不能在 addr 处设置/删除断点
+  bool (*bp_set)(vaddr_t addr, bool set);
+  /// 最多执行 n 条指令
+  /// @return true 表示没有执行完就停下来了 (断点, 监视点, 程序结束)
+  bool (*exec)(uint64_t n);
+  RspStatus (*status)(int *exit_code);
+  void (*kill)(void);
+} RspTarget;
+
+/// 在 addr (端口号或者 Unix socket 路径) 上等待 gdb 连接, 处理请求直到 gdb 断开
+void rsp_serve(const char *addr, const RspTarget *target);
+
+#endif
@@ -0,0 +1,166 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NEMU is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+// 解码 NEMU 的二进制指令踪迹 (--itrace=FILE), 输出与 NEMU 的 itrace 日志相同的格式:
+// 0x80000000: 00 00 02 97 auipc   t0, 0                # t0 = 0x80000000
+
+#include <capstone/capstone.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/itrace-bin.h>
+
+static const char *regs[] = {
+  "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+  "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+  "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+  "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+static csh handle;
+static bool raw = false;   // 不反汇编
+static uint64_t skip = 0;  // 跳过前 skip 条指令
+static uint64_t limit = -1; // 最多输出 limit 条指令
+
+static void usage(const char *prog) {
+  printf("Usage: %s [OPTION...] FILE\n\n", prog);
+  printf("\t-s,--skip=N     skip the first N instructions\n");
+  printf("\t-n,--count=N    print at most N instructions\n");
+  printf("\t-r,--raw        do not disassemble\n");
+  printf("\n");
+  exit(0);
+}
+
+static const char *parse_args(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"skip" , required_argument, NULL, 's'},
+    {"count", required_argument, NULL, 'n'},
+    {"raw"  , no_argument      , NULL, 'r'},
+    {"help" , no_argument      , NULL, 'h'},
+    {0      , 0                , NULL,  0 },
+  };
+  int o;
+  while ((o = getopt_long(argc, argv, "s:n:rh", table, NULL)) != -1) {
+    switch (o) {
+      case 's': skip = strtoull(optarg, NULL, 0); break;
+      case 'n': limit = strtoull(optarg, NULL, 0); break;
+      case 'r': raw = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) usage(argv[0]);
+  return argv[optind];
+}
+
+static void print_inst(uint64_t pc, uint32_t inst, int rd, uint64_t val, bool xl64) {
+  char line[160];
+  int ilen = itrace_bin_ilen(inst);
+  char *p = line;
+  p += sprintf(p, xl64 ? "0x%016" PRIx64 ":" : "0x%08" PRIx64 ":", pc);
+  for (int i = ilen - 1; i >= 0; i--) p += sprintf(p, " %02x", (inst >> (i * 8)) & 0xff);
+  p += sprintf(p, "%*s", (4 - ilen) * 3 + 1, "");
+
+  cs_insn *insn;
+  if (!raw && cs_disasm(handle, (uint8_t *)&inst, ilen, pc, 1, &insn) == 1) {
+    p += sprintf(p, "%-7s %s", insn->mnemonic, insn->op_str);
+    cs_free(insn, 1);
+  } else {
+    p += sprintf(p, "%-7s", "?");
+  }
+  if (rd > 0) printf("%-60s # %s = 0x%" PRIx64 "\n", line, regs[rd], val);
+  else puts(line);
+}
+
+int main(int argc, char *argv[]) {
+  const char *file = parse_args(argc, argv);
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) { perror(file); return 1; }
+  struct stat st;
+  fstat(fd, &st);
+  if ((size_t)st.st_size < sizeof(ItraceBinHeader)) {
+    fprintf(stderr, "%s: file is too small\n", file);
+    return 1;
+  }
+  const uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (base == MAP_FAILED) { perror("mmap"); return 1; }
+  close(fd);
+
+  ItraceBinHeader h;
+  memcpy(&h, base, sizeof(h));
+  if (memcmp(h.magic, ITRACE_BIN_MAGIC, sizeof(h.magic)) != 0 || h.version != ITRACE_BIN_VERSION) {
+    fprintf(stderr, "%s: not a NEMU binary instruction trace\n", file);
+    return 1;
+  }
+  bool xl64 = h.flags & ITRACE_BIN_FLAG_XL64;
+  cs_mode mode = (xl64 ? CS_MODE_RISCV64 : CS_MODE_RISCV32) | CS_MODE_RISCVC;
+  if (!raw && cs_open(CS_ARCH_RISCV, mode, &handle) != CS_ERR_OK) {
+    fprintf(stderr, "can not initialize capstone\n");
+    return 1;
+  }
+
+  static ItraceBinCacheEntry cache[ITRACE_BIN_CACHE_SIZE];
+  for (int i = 0; i < ITRACE_BIN_CACHE_SIZE; i++) cache[i].pc = -1;
+  uint64_t gpr[32] = {0};
+  uint64_t last_pc = 0, n = 0;
+  uint32_t last_inst = 0;
+
+  const uint8_t *p = base + sizeof(h), *end = base + st.st_size;
+  // limit 默认是 UINT64_MAX, 写成 n < skip + limit 会回绕
+  while (p < end && (n < skip || n - skip < limit)) {
+    uint8_t tag = *p++;
+    uint64_t pc = last_pc + itrace_bin_ilen(last_inst), v;
+    if (!(tag & ITRACE_BIN_SEQ)) {
+      if ((p = itrace_bin_get_varint(p, end, &v)) == NULL) break;
+      pc += itrace_bin_unzigzag(v);
+    }
+
+    ItraceBinCacheEntry *e = itrace_bin_cache_entry(cache, pc);
+    uint32_t inst;
+    if (tag & ITRACE_BIN_HIT) {
+      if (e->pc != pc) { fprintf(stderr, "corrupted trace at instruction %" PRIu64 "\n", n); return 1; }
+      inst = e->inst;
+    } else {
+      if (end - p < 4) break;
+      memcpy(&inst, p, 4);
+      p += 4;
+      e->pc = pc;
+      e->inst = inst;
+    }
+
+    int rd = -1;
+    if (tag & ITRACE_BIN_RD) {
+      rd = tag >> ITRACE_BIN_RD_SHIFT;
+      if ((p = itrace_bin_get_varint(p, end, &v)) == NULL) break;
+      gpr[rd] += itrace_bin_unzigzag(v);
+      if (!xl64) gpr[rd] = (uint32_t)gpr[rd];
+    }
+
+    if (n >= skip) print_inst(pc, inst, rd, rd > 0 ? gpr[rd] : 0, xl64);
+    last_pc = pc;
+    last_inst = inst;
+    n++;
+  }
+  if (p == NULL) fprintf(stderr, "warning: the trace is truncated\n");
+
+  if (!raw) cs_close(&handle);
+  munmap((void *)base, st.st_size);
+  return 0;
+}
@@ -0,0 +1,136 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NEMU is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+// 在指定的 CPU 上运行一个命令, 结束后输出一行:
+// perfrun: cycles=N instructions=N maxrss_kb=N wall_us=N status=N
+// 周期数和指令数来自 perf_event_open (只统计用户态, 包括子线程), 不可用时输出 -1
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static int cpu = -1;
+static const char *out_file = NULL;
+
+static void usage(const char *prog) {
+  printf("Usage: %s [OPTION...] -- COMMAND [ARG...]\n\n", prog);
+  printf("\t-c,--cpu=N      pin the command to cpu N\n");
+  printf("\t-o,--output=F   append the result to F instead of stderr\n");
+  printf("\n");
+  exit(0);
+}
+
+static int parse_args(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"cpu"   , required_argument, NULL, 'c'},
+    {"output", required_argument, NULL, 'o'},
+    {"help"  , no_argument      , NULL, 'h'},
+    {0       , 0                , NULL,  0 },
+  };
+  int o;
+  while ((o = getopt_long(argc, argv, "+c:o:h", table, NULL)) != -1) {
+    switch (o) {
+      case 'c': cpu = atoi(optarg); break;
+      case 'o': out_file = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind >= argc) usage(argv[0]);
+  return optind;
+}
+
+// 子进程 exec 时才开始计数, 不统计 perfrun 自己
+static int open_counter(pid_t pid, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.enable_on_exec = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+static int64_t read_counter(int fd) {
+  uint64_t val;
+  if (fd < 0 || read(fd, &val, sizeof(val)) != sizeof(val)) return -1;
+  return val;
+}
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+int main(int argc, char *argv[]) {
+  int cmd = parse_args(argc, argv);
+
+  // 子进程先等父进程打开计数器再 exec
+  int go[2];
+  if (pipe(go) != 0) { perror("pipe"); return 1; }
+  pid_t pid = fork();
+  if (pid < 0) { perror("fork"); return 1; }
+  if (pid == 0) {
+    close(go[1]);
+    char c;
+    if (read(go[0], &c, 1) != 1) _exit(127);
+    if (cpu >= 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      if (sched_setaffinity(0, sizeof(set), &set) != 0) perror("sched_setaffinity");
+    }
+    execvp(argv[cmd], argv + cmd);
+    perror(argv[cmd]);
+    _exit(127);
+  }
+
+  close(go[0]);
+  int fd_cycles = open_counter(pid, PERF_COUNT_HW_CPU_CYCLES);
+  int fd_insts = open_counter(pid, PERF_COUNT_HW_INSTRUCTIONS);
+  if (fd_cycles < 0 || fd_insts < 0) perror("perf_event_open");
+  uint64_t start = now_us();
+  if (write(go[1], "x", 1) != 1) { perror("write"); return 1; }
+  close(go[1]);
+
+  int status;
+  struct rusage ru;
+  if (wait4(pid, &status, 0, &ru) < 0) { perror("wait4"); return 1; }
+  uint64_t wall = now_us() - start;
+
+  FILE *fp = out_file ? fopen(out_file, "a") : stderr;
+  if (fp == NULL) { perror(out_file); fp = stderr; }
+  fprintf(fp, "perfrun: cycles=%" PRId64 " instructions=%" PRId64 " maxrss_kb=%ld wall_us=%" PRIu64 " status=%d\n",
+      read_counter(fd_cycles), read_counter(fd_insts), ru.ru_maxrss, wall,
+      WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+  if (fp != stderr) fclose(fp);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
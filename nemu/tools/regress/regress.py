@@ -0,0 +1,403 @@
+#!/usr/bin/env python3
+
+# 并行回归测试: 在 NEMU/NPC 上以批处理模式 (-b) 跑一组 AM 测试镜像,
+# 收集 HIT GOOD/BAD TRAP, 指令数和 statistic() 报告的 inst/s,
+# 输出 JSON/JUnit 汇总, 并和保存的基线比较性能
+#
+# 例子:
+#   regress.py --sim riscv32-nemu=$NEMU_HOME/build/riscv32-nemu-interpreter \
+#              --sim riscv32-npc=$NPC_HOME/build/riscv32-npc \
+#              $AM_KERNELS_HOME/tests/cpu-tests/build
+#
+# 加上 --flows 之后还会在一个镜像上检查几个调试和工具流程 (见 FLOWS),
+# 模拟器没有编进对应的功能时记为 skip
+
+import argparse
+import json
+import locale
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+import types
+import xml.etree.ElementTree as ET
+from concurrent.futures import ThreadPoolExecutor
+
+TOOLS_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(TOOLS_DIR, 'gdbstub'))
+import gdb_test
+
+ANSI_RE = re.compile(r'\x1b\[[0-9;]*m')
+PATTERNS = {
+    'insts': re.compile(r'total guest instructions = (\d+)'),
+    'inst_per_sec': re.compile(r'simulation frequency = (\d+) inst/s'),
+    'host_us': re.compile(r'host time spent = (\d+) us'),
+    'ipc': re.compile(r'IPC = ([0-9.]+)'), # 只有 NPC 有
+}
+
+# NEMU 按 locale 输出数字 (%'), 千位分隔符随 locale 变化, 统一用 C locale 运行模拟器
+SIM_ENV = dict(os.environ, LC_ALL='C')
+
+
+class Sim:
+    def __init__(self, spec, args):
+        # ARCH=BINARY, ARCH 同时是镜像文件名的后缀, 例如 add-riscv32-nemu.bin
+        if '=' not in spec:
+            sys.exit('bad --sim "{0}", expect ARCH=BINARY'.format(spec))
+        self.arch, self.binary = spec.split('=', 1)
+        self.binary = os.path.abspath(self.binary)
+        self.args = args.get(self.arch, '').split()
+        if not os.access(self.binary, os.X_OK):
+            sys.exit('{0}: not an executable'.format(self.binary))
+
+
+def discover(paths, arch):
+    """找到 paths 下所有 *-ARCH.bin, 返回 [(测试名, 镜像路径)]"""
+    suffix = '-' + arch + '.bin'
+    images = []
+    for path in paths:
+        if os.path.isfile(path):
+            files = [path]
+        else:
+            files = [os.path.join(root, f) for root, _, fs in os.walk(path) for f in fs]
+        for f in files:
+            if f.endswith(suffix):
+                images.append((os.path.basename(f)[:-len(suffix)], os.path.abspath(f)))
+    return sorted(set(images))
+
+
+def parse_output(text):
+    text = ANSI_RE.sub('', text)
+    r = {}
+    for key, pat in PATTERNS.items():
+        m = pat.findall(text)
+        if m:
+            r[key] = float(m[-1]) if key == 'ipc' else int(m[-1])
+    if 'HIT GOOD TRAP' in text:
+        r['status'] = 'pass'
+    elif 'HIT BAD TRAP' in text:
+        r['status'] = 'bad-trap'
+    elif 'ABORT' in text:
+        r['status'] = 'abort'
+    else:
+        r['status'] = 'no-verdict'
+    return r
+
+
+def run_one(sim, name, image, outdir, timeout):
+    logdir = os.path.join(outdir, sim.arch)
+    os.makedirs(logdir, exist_ok=True)
+    log = os.path.join(logdir, name + '.log')
+    cmd = [sim.binary, '-b', '--log=' + log] + sim.args + [image]
+    start = time.time()
+    try:
+        p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                           stdin=subprocess.DEVNULL, env=SIM_ENV, timeout=timeout)
+        out = p.stdout.decode(errors='replace')
+        r = parse_output(out)
+        r['exit_code'] = p.returncode
+        if r['status'] == 'pass' and p.returncode != 0:
+            r['status'] = 'crash'
+    except subprocess.TimeoutExpired as e:
+        out = (e.stdout or b'').decode(errors='replace')
+        r = parse_output(out)
+        r['status'] = 'timeout'
+    r['time'] = round(time.time() - start, 3)
+    with open(os.path.join(logdir, name + '.out'), 'w') as fp:
+        fp.write(out)
+    r.update({'arch': sim.arch, 'name': name, 'image': image, 'log': log})
+    return r
+
+
+def sim_run(cmd, timeout, script=None, env=SIM_ENV):
+    """运行一次模拟器, script 是喂给 sdb 的命令. @return 去掉颜色的输出"""
+    try:
+        p = subprocess.run(cmd, input=(script or '').encode(), stdout=subprocess.PIPE,
+                           stderr=subprocess.STDOUT, env=env, timeout=timeout)
+        out = p.stdout.decode(errors='replace')
+    except subprocess.TimeoutExpired as e:
+        out = (e.stdout or b'').decode(errors='replace') + '\ntimed out'
+    return ANSI_RE.sub('', out)
+
+
+def grouping_locale():
+    """找一个数字带千位分隔符的 locale, 没有的话返回 None. 会改进程的 locale, 只在启动线程之前调用"""
+    try:
+        names = subprocess.run(['locale', '-a'], stdout=subprocess.PIPE).stdout.decode().split()
+    except OSError:
+        return None
+    found = None
+    for name in names:
+        try:
+            locale.setlocale(locale.LC_NUMERIC, name)
+        except locale.Error:
+            continue
+        if locale.localeconv()['thousands_sep']:
+            found = name
+            break
+    locale.setlocale(locale.LC_NUMERIC, 'C')
+    return found
+
+
+# ================================ 流程测试 ================================
+# 每个流程返回 (status, 说明, 输出), status 是 pass/fail/skip.
+# ctx.help 是 --help 的输出 (列出编进去的命令行选项), ctx.sdb_help 是 sdb 的 help
+
+def flow_itrace(sim, image, ctx):
+    """--itrace 写出二进制 trace, itrace-dump 解码; --skip/--count 的结果要和完整解码的切片一致"""
+    if '--itrace=' not in ctx.help:
+        return 'skip', 'built without CONFIG_ITRACE_BINARY', ''
+    if not os.access(ctx.itrace_dump, os.X_OK):
+        return 'skip', ctx.itrace_dump + ' is not built', ''
+    trace = os.path.join(ctx.tmpdir, 'itrace.bin')
+    out = sim_run([sim.binary, '-b', '--log=' + ctx.log, '--itrace=' + trace] + sim.args + [image], ctx.timeout)
+    if parse_output(out)['status'] != 'pass':
+        return 'fail', 'the traced run did not pass', out
+
+    def dump(*args):
+        return sim_run([ctx.itrace_dump, '-r'] + list(args) + [trace], ctx.timeout).splitlines()
+    full = dump()
+    checks = [
+        ('decoded {0} instructions'.format(len(full)), len(full) > 5),
+        ('--skip 3', dump('-s', '3') == full[3:]),
+        ('--count 5', dump('-n', '5') == full[:5]),
+        ('--skip 3 --count 2', dump('-s', '3', '-n', '2') == full[3:5]),
+    ]
+    out += '\n'.join('{0}: {1}'.format(name, 'ok' if ok else 'FAIL') for name, ok in checks)
+    if not all(ok for _, ok in checks):
+        return 'fail', 'itrace-dump output is inconsistent', out
+    return 'pass', '', out
+
+
+def flow_break(sim, image, ctx):
+    """sdb 断点: 命中一次就停, 从断点继续不会马上又停, 条件为假的断点不停"""
+    if 'Set a breakpoint' not in ctx.sdb_help:
+        return 'skip', 'built without sdb breakpoints', ''
+    script = 'b $pc + 4\nb $pc + 8 if 0\nc\nc\nq\n'
+    out = sim_run([sim.binary, '--log=' + ctx.log] + sim.args + [image], ctx.timeout, script)
+    m = re.search(r'breakpoint 1 at (0x[0-9a-f]+)', out)
+    if m is None:
+        return 'fail', 'breakpoint was not set', out
+    hits = re.findall(r'breakpoint 1 hit at (0x[0-9a-f]+)', out)
+    if hits != [m.group(1)]:
+        return 'fail', 'expect exactly one hit at ' + m.group(1), out
+    if 'breakpoint 2 hit' in out:
+        return 'fail', 'a breakpoint with a false condition stopped', out
+    if parse_output(out)['status'] != 'pass':
+        return 'fail', 'the program did not finish after the breakpoint', out
+    return 'pass', '', out
+
+
+def flow_gdb(sim, image, ctx):
+    """gdbstub: 用 gdb_test.py 的批处理 gdb 会话 (断点, 读写内存, 单步)"""
+    if '--gdb=' not in ctx.help:
+        return 'skip', 'built without CONFIG_GDBSTUB', ''
+    elf = os.path.splitext(image)[0] + '.elf'
+    if not os.path.isfile(elf):
+        return 'skip', 'no ' + elf, ''
+    gdb = ctx.gdb or gdb_test.find_gdb()
+    if gdb is None:
+        return 'skip', 'no gdb found', ''
+    ok, out = gdb_test.run(sim.binary, elf, gdb, ctx.timeout)
+    return ('pass', '', out) if ok else ('fail', 'see the gdb session', out)
+
+
+def flow_locale(sim, image, ctx):
+    """用带千位分隔符的 locale 运行时数字会分组, regress 用 C locale 解析出的指令数要和它一致"""
+    if ctx.grouping_locale is None:
+        return 'skip', 'no locale with a thousands separator', ''
+    env = dict(os.environ, LC_ALL=ctx.grouping_locale)
+    grouped = sim_run([sim.binary, '-b', '--log=' + ctx.log] + sim.args + [image], ctx.timeout, env=env)
+    plain = sim_run([sim.binary, '-b', '--log=' + ctx.log] + sim.args + [image], ctx.timeout)
+    out = grouped + '\n---- LC_ALL=C ----\n' + plain
+    m = re.search(r'total guest instructions = (\d\S*)', grouped)
+    r = parse_output(plain)
+    if m is None or 'insts' not in r:
+        return 'fail', 'no instruction count in the output', out
+    if int(re.sub(r'\D', '', m.group(1))) != r['insts']:
+        return 'fail', '{0} under {1}, parsed {2}'.format(m.group(1), ctx.grouping_locale, r['insts']), out
+    return 'pass', '', out
+
+
+def flow_ckpt(sim, image, ctx):
+    """NPC 检查点: sdb save 之后运行到结束, 再用 --restore 从检查点跑完, 两次的指令数一样"""
+    if '--restore=' not in ctx.help:
+        return 'skip', 'built without CONFIG_VERILATOR_SAVABLE', ''
+    ckpt = os.path.join(ctx.tmpdir, 'flow.ckpt')
+    script = 'si 100\nsave {0}\nc\nq\n'.format(ckpt)
+    out = sim_run([sim.binary, '--log=' + ctx.log] + sim.args + [image], ctx.timeout, script)
+    r1 = parse_output(out)
+    if 'checkpoint: saved' not in out or r1['status'] != 'pass':
+        return 'fail', 'the run that saves the checkpoint did not pass', out
+    replay = sim_run([sim.binary, '-b', '--log=' + ctx.log, '--restore=' + ckpt] + sim.args + [image], ctx.timeout)
+    out += '\n---- --restore ----\n' + replay
+    r2 = parse_output(replay)
+    if r2['status'] != 'pass':
+        return 'fail', 'the restored run did not pass', out
+    if r1.get('insts') != r2.get('insts'):
+        return 'fail', 'instruction count {0} after restore, expect {1}'.format(r2.get('insts'), r1.get('insts')), out
+    return 'pass', '', out
+
+
+FLOWS = [('flow-itrace', flow_itrace), ('flow-break', flow_break), ('flow-gdb', flow_gdb),
+         ('flow-locale', flow_locale), ('flow-ckpt', flow_ckpt)]
+
+
+def flow_ctx(sim, image, opts, loc):
+    """探测模拟器编进了哪些功能"""
+    tmpdir = tempfile.mkdtemp(prefix='regress-')
+    log = os.path.join(tmpdir, 'probe.log')
+    ctx = types.SimpleNamespace(timeout=opts.timeout, gdb=opts.gdb, itrace_dump=opts.itrace_dump,
+                                grouping_locale=loc)
+    ctx.help = sim_run([sim.binary, '--help'], opts.timeout)
+    ctx.sdb_help = sim_run([sim.binary, '--log=' + log] + sim.args + [image], opts.timeout, 'help\nq\n')
+    shutil.rmtree(tmpdir, ignore_errors=True)
+    return ctx
+
+
+def run_flow(sim, name, func, image, outdir, ctx):
+    logdir = os.path.join(outdir, sim.arch)
+    os.makedirs(logdir, exist_ok=True)
+    out_file = os.path.join(logdir, name + '.out')
+    ctx = types.SimpleNamespace(**vars(ctx))
+    ctx.tmpdir = tempfile.mkdtemp(prefix=name + '-')
+    ctx.log = os.path.join(ctx.tmpdir, 'sim.log')
+    start = time.time()
+    try:
+        status, msg, out = func(sim, image, ctx)
+    finally:
+        shutil.rmtree(ctx.tmpdir, ignore_errors=True)
+    with open(out_file, 'w') as fp:
+        fp.write(out)
+    return {'arch': sim.arch, 'name': name, 'image': image, 'log': out_file, 'flow': True,
+            'status': status, 'message': msg, 'time': round(time.time() - start, 3)}
+
+
+def compare(results, baseline, threshold):
+    """inst/s 比基线低 threshold 以上算性能回退; 指令数变化说明程序行为变了"""
+    for r in results:
+        b = baseline.get(r['arch'] + '/' + r['name'])
+        if b is None or r['status'] != 'pass':
+            continue
+        if 'inst_per_sec' in b and 'inst_per_sec' in r:
+            r['baseline_inst_per_sec'] = b['inst_per_sec']
+            r['speedup'] = round(r['inst_per_sec'] / max(b['inst_per_sec'], 1), 3)
+            r['perf_regression'] = r['speedup'] < 1 - threshold
+        if 'insts' in b and 'insts' in r and b['insts'] != r['insts']:
+            r['insts_changed'] = b['insts']
+
+
+def write_junit(results, path):
+    suites = ET.Element('testsuites')
+    for arch in sorted({r['arch'] for r in results}):
+        rs = [r for r in results if r['arch'] == arch]
+        suite = ET.SubElement(suites, 'testsuite', name=arch, tests=str(len(rs)),
+                              failures=str(sum(r['status'] not in ('pass', 'skip') or bool(r.get('perf_regression'))
+                                                for r in rs)),
+                              skipped=str(sum(r['status'] == 'skip' for r in rs)),
+                              time=str(round(sum(r['time'] for r in rs), 3)))
+        for r in rs:
+            case = ET.SubElement(suite, 'testcase', classname=arch, name=r['name'], time=str(r['time']))
+            if r['status'] == 'skip':
+                ET.SubElement(case, 'skipped', message=r['message'])
+            elif r['status'] != 'pass':
+                ET.SubElement(case, 'failure', message=r['status']).text = r.get('message') or 'see ' + r['log']
+            elif r.get('perf_regression'):
+                ET.SubElement(case, 'failure', message='perf-regression').text = \
+                    '{0} inst/s, baseline {1} inst/s'.format(r['inst_per_sec'], r['baseline_inst_per_sec'])
+    ET.ElementTree(suites).write(path, encoding='utf-8', xml_declaration=True)
+
+
+def print_summary(results):
+    print('{0:<14} {1:<24} {2:<10} {3:>12} {4:>12} {5:>8}'.format(
+        'arch', 'test', 'status', 'insts', 'inst/s', 'speedup'))
+    for r in results:
+        status = r['status']
+        if r.get('perf_regression'):
+            status = 'slow'
+        print('{0:<14} {1:<24} {2:<10} {3:>12} {4:>12} {5:>8}'.format(
+            r['arch'], r['name'], status, r.get('insts', '-'), r.get('inst_per_sec', '-'),
+            r.get('speedup', '-')))
+        if 'insts_changed' in r:
+            print('  warning: instruction count changed from {0}'.format(r['insts_changed']))
+        if r.get('message'):
+            print('  ' + r['message'])
+    npass = sum(r['status'] == 'pass' for r in results)
+    nskip = sum(r['status'] == 'skip' for r in results)
+    nslow = sum(bool(r.get('perf_regression')) for r in results)
+    print('{0}/{1} passed, {2} skipped, {3} performance regressions'.format(
+        npass, len(results) - nskip, nskip, nslow))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run AM test images on NEMU/NPC in parallel')
+    parser.add_argument('paths', nargs='+', help='directories (searched recursively) or image files')
+    parser.add_argument('--sim', action='append', required=True, metavar='ARCH=BINARY',
+                        help='simulator to test, images are named NAME-ARCH.bin')
+    parser.add_argument('--args', action='append', default=[], metavar='ARCH=ARGS',
+                        help='extra arguments for the simulator of ARCH, e.g. --diff=...')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help='parallel jobs')
+    parser.add_argument('-t', '--timeout', type=float, default=60, help='timeout of each test in seconds')
+    parser.add_argument('-o', '--out', default='build/regress', help='directory for logs and reports')
+    parser.add_argument('--baseline', help='compare inst/s with this JSON file')
+    parser.add_argument('--save-baseline', help='write the results of passed tests as a new baseline')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='report a regression when inst/s drops by more than this ratio')
+    parser.add_argument('--allow-regression', action='store_true',
+                        help='do not fail because of performance regressions')
+    parser.add_argument('--flows', action='store_true',
+                        help='also check itrace-dump, breakpoints, gdbstub, locale and checkpoint flows')
+    parser.add_argument('--flow-image', default='recursion', help='test image used by the flows')
+    parser.add_argument('--gdb', help='gdb with RISC-V support for the gdbstub flow (default: search PATH)')
+    parser.add_argument('--itrace-dump', default=os.path.join(TOOLS_DIR, 'itrace-dump', 'build', 'itrace-dump'),
+                        help='decoder for the itrace flow')
+    opts = parser.parse_args()
+
+    extra = dict(a.split('=', 1) for a in opts.args if '=' in a)
+    sims = [Sim(s, extra) for s in opts.sim]
+    jobs = [(sim, name, image) for sim in sims for name, image in discover(opts.paths, sim.arch)]
+    if not jobs:
+        sys.exit('no test image found')
+    os.makedirs(opts.out, exist_ok=True)
+
+    flows = []
+    if opts.flows:
+        loc = grouping_locale()
+        for sim in sims:
+            images = dict(discover(opts.paths, sim.arch))
+            if not images:
+                continue
+            image = images.get(opts.flow_image) or images[sorted(images)[0]]
+            ctx = flow_ctx(sim, image, opts, loc)
+            flows += [(sim, name, func, image, ctx) for name, func in FLOWS]
+
+    print('running {0} tests and {1} flows with {2} jobs'.format(len(jobs), len(flows), opts.jobs))
+    with ThreadPoolExecutor(max_workers=opts.jobs) as pool:
+        results = list(pool.map(lambda j: run_one(*j, opts.out, opts.timeout), jobs))
+        results += list(pool.map(lambda f: run_flow(*f[:4], opts.out, f[4]), flows))
+
+    if opts.baseline:
+        with open(opts.baseline) as fp:
+            compare(results, json.load(fp), opts.threshold)
+
+    with open(os.path.join(opts.out, 'summary.json'), 'w') as fp:
+        json.dump(results, fp, indent=2)
+    write_junit(results, os.path.join(opts.out, 'junit.xml'))
+    if opts.save_baseline:
+        base = {r['arch'] + '/' + r['name']: {k: r[k] for k in ('insts', 'inst_per_sec') if k in r}
+                for r in results if r['status'] == 'pass' and not r.get('flow')}
+        with open(opts.save_baseline, 'w') as fp:
+            json.dump(base, fp, indent=2, sort_keys=True)
+
+    print_summary(results)
+    print('reports: {0}, {1}'.format(os.path.join(opts.out, 'summary.json'), os.path.join(opts.out, 'junit.xml')))
+    failed = any(r['status'] not in ('pass', 'skip') for r in results)
+    slow = any(r.get('perf_regression') for r in results) and not opts.allow_regression
+    return 1 if failed or slow else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
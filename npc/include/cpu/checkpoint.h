@@ -0,0 +1,48 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NPC is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+#ifndef __CPU_CHECKPOINT_H__
+#define __CPU_CHECKPOINT_H__
+
+#include <common.h>
+#include <cpu/core.h>
+
+#ifdef CONFIG_VERILATOR_SAVABLE
+
+extern uint64_t ckpt_next; // 下一次自动保存的周期, 不自动保存时为 UINT64_MAX
+
+void init_checkpoint(const char *restore_file);
+bool checkpoint_save(const char *file);
+bool checkpoint_load(const char *file);
+void checkpoint_take(void);
+void checkpoint_report(void);
+
+/// @brief 在两条指令之间调用, 到了周期就自动保存一个检查点
+static inline void checkpoint_step(void) {
+  if (unlikely(npc_core_cycles() >= ckpt_next)) {
+    checkpoint_take();
+  }
+}
+
+#else
+// 只是用来骗过编译编译器的
+static inline void init_checkpoint(const char *restore_file) {
+  (void)restore_file;
+}
+static inline void checkpoint_step(void) {}
+static inline void checkpoint_report(void) {}
+#endif
+
+#endif
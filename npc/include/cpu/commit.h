@@ -0,0 +1,51 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NPC is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+#ifndef __CPU_COMMIT_H__
+#define __CPU_COMMIT_H__
+
+#include <common.h>
+
+/*
+ * RTL 通过 DPI-C 报告的提交记录
+ * 一条指令执行期间的 GPR/CSR 写和访存先记在当前记录里, 提交时整条记录进入环,
+ * 同时把写入应用到 cpu 结构体, 所以 cpu.gpr/cpu.csr 总是和 RTL 一致
+ */
+
+#define COMMIT_MAX_CSR 2 // 异常会写 mcause 和 mepc
+
+typedef struct CommitRec {
+  vaddr_t pc;
+  vaddr_t dnpc;
+  uint32_t inst;
+
+  bool rf_wen;
+  uint8_t rd;
+  word_t rd_val;
+
+  char mem;  // 'R' 'W', 没有访存时为 0
+  paddr_t mem_addr;
+  word_t mem_data;
+
+  uint8_t ncsr;
+  struct {
+    uint16_t addr;
+    word_t val;
+  } csr[COMMIT_MAX_CSR];
+} CommitRec;
+
+#define COMMIT_RING_SIZE 64 // 必须是 2 的幂
+
+#endif // __CPU_COMMIT_H__
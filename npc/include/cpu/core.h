@@ -25,29 +25,86 @@ extern "C" {
 void npc_core_fini(void);
 
 /**
- * 刷新波形文件
+ * 结束波形文件
  *
- * 将缓冲区中的波形数据写入文件,
- * 用于异常退出前确保波形完整
+ * 关闭正在写的波形文件 (FST 只有关闭之后才完整),
+ * 用于异常退出前确保波形完整. 只保留最后一段波形时,
+ * 根据运行是否失败决定留下还是删掉. 之后不再 dump 波形
  */
 void npc_core_flush_trace(void);
 
 /**
  * 执行单条指令
  *
- * 驱动时钟直到 debug.valid 有效,
- * 然后将提交信息写入 Decode 结构体
+ * 驱动时钟直到 RTL 通过 commit_dpi 报告一次提交,
+ * 然后将提交记录写入 Decode 结构体
  *
  * @param s 指向 Decode 结构体的指针, 用于接收:
  *          - s->pc: 当前指令 PC
  *          - s->snpc: 静态下一条指令地址 (pc + 4)
  *          - s->dnpc: 动态下一条指令地址 (实际跳转目标)
  *          - s->isa.inst: 当前指令编码
+ *          - s->rec: 完整的提交记录 (GPR/CSR 写, 访存)
  *
  * @return true 执行成功, false 执行失败 (超时/错误)
  */
 bool npc_core_step(struct Decode *s);
 
+/**
+ * 让核自由运行
+ *
+ * 在一次调用里一直驱动时钟, 直到提交了 n 条指令, npc_state 不再是
+ * NPC_RUNNING (例如 ebreak), 或者连续很多个周期没有提交.
+ * 中间不采样 debug 端口, 返回后 cpu.pc 是下一条要执行的指令
+ *
+ * @param resume 不为 NULL 时在每条指令之前检查 gdb 的断点, 见 gdb_bp_before()
+ * @return 实际提交的指令数, 小于 n 且 npc_state 仍为 NPC_RUNNING 说明卡住了
+ */
+uint64_t npc_core_run(uint64_t n, bool *resume);
+
+/**
+ * 复位 CPU 核心
+ *
+ * 拉高 reset 若干个周期, 之后从复位地址重新取指,
+ * 用于在同一个模型上加载新的检查点
+ */
+void npc_core_reset(void);
+
+/**
+ * 获取已经仿真的时钟周期数
+ *
+ * @return 从初始化开始累计的周期数 (包括复位周期)
+ */
+uint64_t npc_core_cycles(void);
+
+/**
+ * 报告 RTL 的性能计数器
+ *
+ * 通过 DPI-C 读出 mcycle/minstret/mhpmcounter*,
+ * 输出 IPC, 按周期划分的停顿 (取指/访存/其他) 和总线/pmem 的统计
+ */
+void npc_core_perf_report(void);
+
+/**
+ * 保存检查点
+ *
+ * 把 Verilator 模型 (需要 --savable), pmem, 设备的 io_space, 寄存器副本
+ * 和周期数/指令数写入 file. 只能在两条指令之间调用
+ *
+ * @return 是否成功
+ */
+bool npc_core_save(const char *file);
+
+/**
+ * 恢复检查点
+ *
+ * 检查点和当前的 pmem/设备配置不一致时不做任何修改.
+ * 恢复之后波形从检查点所在的周期重新开始
+ *
+ * @return 是否成功
+ */
+bool npc_core_load(const char *file);
+
 #ifdef __cplusplus
 }
 #endif
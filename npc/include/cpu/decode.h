@@ -23,6 +23,7 @@ typedef struct Decode {
   vaddr_t snpc; // static next pc
   vaddr_t dnpc; // dynamic next pc
   ISADecodeInfo isa;
+  const struct CommitRec *rec; // RTL 报告的提交记录, 见 cpu/commit.h
   IFDEF(CONFIG_ITRACE, char logbuf[128]);
 } Decode;
 
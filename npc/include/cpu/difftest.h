@@ -29,6 +29,7 @@ void difftest_skip_ref();
 void difftest_skip_dut(int nr_ref, int nr_dut);
 void difftest_set_patch(void (*fn)(void *arg), void *arg);
 bool difftest_step(vaddr_t pc, vaddr_t npc);
+void difftest_sync();
 void difftest_detach();
 void difftest_attach();
 #else
@@ -36,6 +37,7 @@ static inline void difftest_skip_ref() {}
 static inline void difftest_skip_dut(int nr_ref, int nr_dut) {}
 static inline void difftest_set_patch(void (*fn)(void *arg), void *arg) {}
 static inline void difftest_step(vaddr_t pc, vaddr_t npc) {}
+static inline void difftest_sync() {}
 static inline void difftest_detach() {}
 static inline void difftest_attach() {}
 #endif
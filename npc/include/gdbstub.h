@@ -0,0 +1,53 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NPC is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+#ifndef __GDBSTUB_H__
+#define __GDBSTUB_H__
+
+#include <common.h>
+
+#ifdef CONFIG_GDBSTUB
+#include <memory/paddr.h>
+
+// gdb 设置的断点: pmem 中每个字 (指令) 一位, 每条指令只需要测一位
+#define GDB_BP_BITS (CONFIG_MSIZE / 4)
+extern uint64_t gdb_bp_bitmap[GDB_BP_BITS / 64];
+
+static inline bool gdb_bp_test(vaddr_t pc) {
+  paddr_t i = (pc - PMEM_LEFT) >> 2;
+  return i < GDB_BP_BITS && ((gdb_bp_bitmap[i / 64] >> (i % 64)) & 1);
+}
+
+// 和 NEMU 一样在执行 pc 处的指令之前检查断点. 每次开始执行时由 gdb_bp_resume()
+// 得到 resume: 上次正好停在当前 pc 的断点上, 这条指令要先放过去, 否则永远走不动
+bool gdb_bp_resume();
+bool gdb_bp_stop(vaddr_t pc, bool *resume);
+
+/// @return true 表示停在 pc 处的断点上, pc 处的指令还没有执行
+static inline bool gdb_bp_before(vaddr_t pc, bool *resume) {
+  if (likely(!gdb_bp_test(pc))) {
+    *resume = false;
+    return false;
+  }
+  return gdb_bp_stop(pc, resume);
+}
+
+void gdbstub_set_addr(const char *addr);
+bool gdbstub_enabled();
+void gdbstub_mainloop();
+
+#endif
+
+#endif
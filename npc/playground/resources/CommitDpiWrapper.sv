@@ -0,0 +1,37 @@
+module CommitDpiWrapper(
+        input clock,
+        input en_i,
+        input [31:0] pc_i,
+        input [31:0] dnpc_i,
+        input [31:0] inst_i,
+        input gpr_wen_i,
+        input [31:0] gpr_idx_i,
+        input [31:0] gpr_data_i,
+        input csr_wen_i,
+        input [31:0] csr_addr_i,
+        input [31:0] csr_data_i,
+        input mem_en_i,
+        input mem_wen_i,
+        input [31:0] mem_addr_i,
+        input [31:0] mem_data_i
+    );
+
+    import "DPI-C" function void gpr_write_dpi(input int idx, input int data);
+    import "DPI-C" function void csr_write_dpi(input int addr, input int data);
+    import "DPI-C" function void mem_access_dpi(input int wen, input int addr, input int data);
+    import "DPI-C" function void commit_dpi(input int pc, input int dnpc, input int inst);
+    always @(posedge clock) begin
+        if (gpr_wen_i) begin
+            gpr_write_dpi(gpr_idx_i, gpr_data_i);
+        end
+        if (csr_wen_i) begin
+            csr_write_dpi(csr_addr_i, csr_data_i);
+        end
+        if (mem_en_i) begin
+            mem_access_dpi({31'b0, mem_wen_i}, mem_addr_i, mem_data_i);
+        end
+        if (en_i) begin
+            commit_dpi(pc_i, dnpc_i, inst_i);
+        end
+    end
+endmodule
@@ -3,12 +3,12 @@ package npc
 import chisel3._
 import chisel3.util._
 
-import common.{HasCSRParameter, HasCoreParameter, HasRegFileParameter}
+import common.{HasCSRParameter, HasCoreParameter, HasRegFileParameter, SoCPerfEventBundle}
 import component._
 import general.AXI4LiteMasterIO
 import general.AXI4LiteParams
 import firrtl.options.Stage
-import blackbox.ExceptionDpiWrapper
+import blackbox.{CommitDpiWrapper, ExceptionDpiWrapper, PerfDpiWrapper}
 
 // 1. 组件初始化
 // 2. 处理组件的输出信号 (时序) + 组合逻辑元件的输入
@@ -21,6 +21,8 @@ class NPCCore(params: AXI4LiteParams) extends Module with HasCoreParameter with
     val debug = Output(new DebugBundle)
     val icache = new AXI4LiteMasterIO(params)
     val dcache = new AXI4LiteMasterIO(params)
+    val perf = Input(new SoCPerfEventBundle) // 总线和 pmem 的性能事件
+    val perfSample = Input(Bool())           // 通过 DPI-C 报告性能计数器
   })
 
   /* ========== 实例化各模块 ========== */
@@ -236,6 +238,17 @@ class NPCCore(params: AXI4LiteParams) extends Module with HasCoreParameter with
     (cu.io.out.npcOp === NPCOpType.NPC_MRET) -> MEPC.U,
   ))
 
+  /* ========== 性能事件 ========== */
+  csru.io.in.perf.instret := ifu.io.in.fire
+  csru.io.in.perf.ifuStall := (state === State.ifu_valid_wait) && !ifu.io.out.valid
+  csru.io.in.perf.lsuStall := ((state === State.mem_ready_wait) && !lsu.io.in.ready) ||
+    ((state === State.mem_valid_wait) && !lsu.io.out.valid)
+  csru.io.in.perf.soc := io.perf
+
+  private val perfDpiWrapper = Module(new PerfDpiWrapper(NRPerfCounters))
+  perfDpiWrapper.io.sample_i := io.perfSample
+  perfDpiWrapper.io.cnt_i := csru.io.out.counters
+
   /* ========== LSU ========== */
   lsu.io.in.valid := (state === State.mem_ready_wait)
   lsu.io.in.bits.op := mem_op_reg
@@ -253,13 +266,33 @@ class NPCCore(params: AXI4LiteParams) extends Module with HasCoreParameter with
   excu.io.in.lsu := lsu.io.out.bits.exception
   excu.io.in.lsuEn := lsu.io.out.fire && lsu.io.out.bits.exceptionEn
   excu.io.in.pc := pc_reg
-  excu.io.in.a0 := rfu.io.out.debug.gpr(10)
+  excu.io.in.a0 := rfu.io.out.a0
 
   /* ========== debug ========== */
   io.debug.valid := ifu.io.in.fire
   io.debug.pc := pc_reg
   io.debug.dnpc := dnpc_reg
   io.debug.inst := inst_reg
-  io.debug.gpr := rfu.io.out.debug.gpr
-  io.debug.csr := csru.io.out.debug
+
+  /* ========== commit ========== */
+  // 提交时主动通知仿真环境, 这样 C++ 侧可以连续跑很多个周期, 不用每条指令都采样 debug 端口
+  // 执行过程中的 GPR/CSR 写和访存也一并报告, C++ 侧据此维护寄存器的副本
+  private val isStore = (mem_op_reg === MemUOpType.mem_SB) || (mem_op_reg === MemUOpType.mem_SH) ||
+    (mem_op_reg === MemUOpType.mem_SW)
+  private val commitDpiWrapper = Module(new CommitDpiWrapper)
+  commitDpiWrapper.io.clock := clock
+  commitDpiWrapper.io.en_i := ifu.io.in.fire
+  commitDpiWrapper.io.pc_i := pc_reg
+  commitDpiWrapper.io.dnpc_i := dnpc_reg
+  commitDpiWrapper.io.inst_i := inst_reg
+  commitDpiWrapper.io.gpr_wen_i := rfu.io.in.wen
+  commitDpiWrapper.io.gpr_idx_i := rfu.io.in.rd_i
+  commitDpiWrapper.io.gpr_data_i := rfu.io.in.wdata
+  commitDpiWrapper.io.csr_wen_i := csru.io.in.wen
+  commitDpiWrapper.io.csr_addr_i := csru.io.in.waddr
+  commitDpiWrapper.io.csr_data_i := csru.io.out.wdata
+  commitDpiWrapper.io.mem_en_i := lsu.io.out.fire && !excu.io.out.valid
+  commitDpiWrapper.io.mem_wen_i := isStore
+  commitDpiWrapper.io.mem_addr_i := mem_addr_reg
+  commitDpiWrapper.io.mem_data_i := Mux(isStore, mem_wdata_reg, lsu.io.out.bits.rdata)
 }
@@ -3,31 +3,29 @@ package npc
 import chisel3._
 import chisel3.util._
 
-import common.{HasCSRParameter, HasCoreParameter, HasRegFileParameter}
-import component.CSRUDebugBundle
+import common.HasCoreParameter
 import component.AXI4LitePmemSlave
 import general.{AXI4LiteXBar, AXI4LiteXBarParams, AXI4LiteParams}
 
-/** 用来给 Verilator 暴露提交信息, 便于在 C++ 侧采样做差分测试 */
-class DebugBundle extends Bundle with HasCoreParameter with HasRegFileParameter with HasCSRParameter {
+/** 提交的指令, 只用于看波形. 仿真环境通过 CommitDpiWrapper 拿到完整的提交记录 */
+class DebugBundle extends Bundle with HasCoreParameter {
   val valid = Bool()
   val pc    = UInt(XLEN.W)
   val dnpc  = UInt(XLEN.W)
   val inst  = UInt(InstLen.W)
-  val gpr   = Vec(NRReg, UInt(XLEN.W))
-  // CSR 提交信息
-  val csr   = new CSRUDebugBundle
 }
 
 class NPCSoC(params: AXI4LiteParams) extends Module {
   val io = IO(new Bundle {
     val step = Input(Bool())
     val debug = new DebugBundle
+    val perfSample = Input(Bool()) // 拉高后 eval 一次, 性能计数器通过 DPI-C 报告给仿真环境
   })
 
   private val core = Module(new NPCCore(params))
   io.debug := core.io.debug
   core.io.step := io.step
+  core.io.perfSample := io.perfSample
 
   // AXI4-Lite Crossbar 配置
   // 地址映射：内存从 0x80000000 开始，大小为 256MB (0x10000000)
@@ -51,6 +49,11 @@ class NPCSoC(params: AXI4LiteParams) extends Module {
 
   // 连接 xbar 的 slave 端口到内存 slave
   xbar.io.slaves(0) <> memSlave.io.axi
+
+  // 性能事件
+  core.io.perf.xbarConflict := xbar.io.perfConflict
+  core.io.perf.pmemReq := memSlave.io.perfReq
+  core.io.perf.pmemBusy := memSlave.io.perfBusy
 }
 
 object NPCSoC extends App with HasCoreParameter {
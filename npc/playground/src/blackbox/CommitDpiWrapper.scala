@@ -0,0 +1,29 @@
+package blackbox
+
+import chisel3._
+
+/** 在时钟上升沿通过 DPI-C 报告 GPR/CSR 写, 访存和指令提交, 由 C++ 侧拼成提交记录 */
+class CommitDpiWrapper extends ExtModule {
+  val io = FlatIO(new Bundle {
+    val clock = Input(Clock())
+    val en_i = Input(Bool())
+    val pc_i = Input(UInt(32.W))
+    val dnpc_i = Input(UInt(32.W))
+    val inst_i = Input(UInt(32.W))
+    // GPR 写
+    val gpr_wen_i = Input(Bool())
+    val gpr_idx_i = Input(UInt(32.W))
+    val gpr_data_i = Input(UInt(32.W))
+    // CSR 写
+    val csr_wen_i = Input(Bool())
+    val csr_addr_i = Input(UInt(32.W))
+    val csr_data_i = Input(UInt(32.W))
+    // 访存完成
+    val mem_en_i = Input(Bool())
+    val mem_wen_i = Input(Bool())
+    val mem_addr_i = Input(UInt(32.W))
+    val mem_data_i = Input(UInt(32.W))
+  })
+
+  addResource("CommitDpiWrapper.sv")
+}
@@ -0,0 +1,32 @@
+package blackbox
+
+import chisel3._
+
+/** sample_i 为高时通过 DPI-C 报告所有计数器, 下标和 CSR 地址的低位一致 (0: mcycle, 2: minstret, 3..: mhpmcounter) */
+class PerfDpiWrapper(n: Int) extends ExtModule {
+  val io = FlatIO(new Bundle {
+    val sample_i = Input(Bool())
+    val cnt_i = Input(Vec(n, UInt(64.W)))
+  })
+
+  // 端口个数随 n 变化, 所以 Verilog 在这里按 n 生成, 而不是放在 resources 里
+  private val ports = (0 until n).map(i => s"        input [63:0] cnt_i_$i").mkString(",\n")
+  private val calls = (0 until n).map(i => s"            perf_counter_dpi($i, cnt_i_$i);").mkString("\n")
+  setInline(
+    "PerfDpiWrapper.sv",
+    s"""module PerfDpiWrapper(
+       |        input sample_i,
+       |$ports
+       |    );
+       |
+       |    import "DPI-C" function void perf_counter_dpi(input int idx, input longint value);
+       |    // 组合逻辑: 仿真环境拉高 sample_i 再 eval 一次就能读到计数器, 不用多打一拍
+       |    always @(*) begin
+       |        if (sample_i) begin
+       |$calls
+       |        end
+       |    end
+       |endmodule
+       |""".stripMargin
+  )
+}
@@ -26,6 +26,12 @@ trait HasCSRParameter {
   val MCAUSE    = 0x0342
   val MCYCLE    = 0x0b00
   val MCYCLEH   = 0x0b80
+  val MINSTRET  = 0x0b02
+  val MINSTRETH = 0x0b82
+  val MHPMCOUNTER3  = 0x0b03 // mhpmcounter3 开始依次是 PerfEventBundle 里除 instret 外的事件
+  val MHPMCOUNTER3H = 0x0b83
+
+  val NRPerfCounters = 8 // mcycle, (time), minstret, mhpmcounter3..7
   val MVENDORID = 0x0f11
   val MARCHID   = 0x0f12
 }
@@ -0,0 +1,22 @@
+package common
+
+import chisel3._
+
+/** @brief
+  *   SoC 里 (core 之外) 的性能事件, 每个周期一位
+  */
+class SoCPerfEventBundle extends Bundle {
+  val xbarConflict = Bool() // 多个 master 同时请求同一个 slave
+  val pmemReq      = Bool() // pmem 接受了一次读/写请求
+  val pmemBusy     = Bool() // pmem 正在等待随机延迟
+}
+
+/** @brief
+  *   CSRU 按周期累加的性能事件, 对应 minstret 和 mhpmcounter3 开始的计数器
+  */
+class PerfEventBundle extends Bundle {
+  val instret  = Bool() // 提交了一条指令
+  val ifuStall = Bool() // 等待 IFU 取指
+  val lsuStall = Bool() // 等待 LSU 访存
+  val soc      = new SoCPerfEventBundle
+}
@@ -5,6 +5,7 @@ import chisel3.util._
 import common.HasCoreParameter
 import common.HasRegFileParameter
 import common.HasCSRParameter
+import common.PerfEventBundle
 
 class CSRUInputBundle extends Bundle with HasCoreParameter with HasCSRParameter {
   val raddr    = UInt(NRCSRbits.W) // csr 读取
@@ -12,22 +13,13 @@ class CSRUInputBundle extends Bundle with HasCoreParameter with HasCSRParameter
   val wen      = Bool()
   val waddr    = UInt(NRCSRbits.W)
   val wdata = UInt(XLEN.W) // rs1_data
-}
-
-class CSRUDebugBundle extends Bundle with HasCoreParameter with HasCSRParameter {
-  val mstatus   = UInt(XLEN.W)
-  val mtvec     = UInt(XLEN.W)
-  val mepc      = UInt(XLEN.W)
-  val mcause    = UInt(XLEN.W)
-  val mcycle    = UInt(XLEN.W)
-  val mcycleh   = UInt(XLEN.W)
-  val mvendorid = UInt(XLEN.W)
-  val marchid   = UInt(XLEN.W)
+  val perf  = new PerfEventBundle
 }
 
 class CSRUOutputBundle extends Bundle with HasCoreParameter with HasCSRParameter {
   val rdata  = UInt(XLEN.W)
-  val debug = new CSRUDebugBundle // difftest
+  val wdata  = UInt(XLEN.W) // 实际写入的值, 提交记录用
+  val counters = Vec(NRPerfCounters, UInt(64.W)) // 下标是 CSR 地址的低位, 给 PerfDpiWrapper
 }
 
 class CSRU extends Module with HasCoreParameter with HasCSRParameter {
@@ -51,6 +43,21 @@ class CSRU extends Module with HasCoreParameter with HasCSRParameter {
   private val mcycle = RegInit(0.U(64.W))
   mcycle := mcycle + 1.U
 
+  // 性能计数器, 每个事件一个 64 位计数器
+  private def eventCounter(event: Bool): UInt = {
+    val cnt = RegInit(0.U(64.W))
+    when(event) { cnt := cnt + 1.U }
+    cnt
+  }
+  private val minstret = eventCounter(io.in.perf.instret)
+  private val mhpmcounter = Seq(
+    io.in.perf.ifuStall,         // 3
+    io.in.perf.lsuStall,         // 4
+    io.in.perf.soc.xbarConflict, // 5
+    io.in.perf.soc.pmemReq,      // 6
+    io.in.perf.soc.pmemBusy      // 7
+  ).map(eventCounter)
+
   // ==================== 读取映射表 ====================
   private val csrReadMap = Seq(
     (MSTATUS.U, mstatus),
@@ -59,9 +66,13 @@ class CSRU extends Module with HasCoreParameter with HasCSRParameter {
     (MCAUSE.U, mcause),
     (MCYCLE.U, mcycle(31, 0)),
     (MCYCLEH.U, mcycle(63, 32)),
+    (MINSTRET.U, minstret(31, 0)),
+    (MINSTRETH.U, minstret(63, 32)),
     (MVENDORID.U, mvendorid), // mvendorid 地址
     (MARCHID.U, marchid)      // marchid 地址
-  )
+  ) ++ mhpmcounter.zipWithIndex.flatMap { case (cnt, i) =>
+    Seq((MHPMCOUNTER3 + i).U -> cnt(31, 0), (MHPMCOUNTER3H + i).U -> cnt(63, 32))
+  }
 
   // ==================== 读取 CSR ====================
   private val csrRdata = MuxLookup(io.in.raddr, 0.U)(csrReadMap)
@@ -78,6 +89,9 @@ class CSRU extends Module with HasCoreParameter with HasCSRParameter {
     )
   )
 
+  io.out.wdata := csrWdata
+  io.out.counters := VecInit(Seq(mcycle, 0.U(64.W), minstret) ++ mhpmcounter)
+
   // ==================== 写入 CSR ====================
   when(io.in.wen) {
     when(io.in.waddr === MSTATUS.U) { mstatus := csrWdata }
@@ -85,14 +99,4 @@ class CSRU extends Module with HasCoreParameter with HasCSRParameter {
     when(io.in.waddr === MEPC.U) { mepc := csrWdata }
     when(io.in.waddr === MCAUSE.U) { mcause := csrWdata }
   }
-
-  // ==================== debug 输出 ====================
-  io.out.debug.mstatus := mstatus
-  io.out.debug.mtvec := mtvec
-  io.out.debug.mepc := mepc
-  io.out.debug.mcause := mcause
-  io.out.debug.mcycle    := mcycle(31, 0)
-  io.out.debug.mcycleh   := mcycle(63, 32)
-  io.out.debug.mvendorid := mvendorid
-  io.out.debug.marchid   := marchid
 }
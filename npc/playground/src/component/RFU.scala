@@ -8,11 +8,7 @@ import common.HasRegFileParameter
 class RFUOutputBundle extends Bundle with HasCoreParameter with HasRegFileParameter {
   val rs1_v  = UInt(XLEN.W)
   val rs2_v  = UInt(XLEN.W)
-  val debug = new RFUDebugBundle
-}
-
-class RFUDebugBundle extends Bundle with HasCoreParameter with HasRegFileParameter {
-  val gpr = Vec(NRReg, UInt(XLEN.W))
+  val a0     = UInt(XLEN.W) // ebreak 的返回值, 给 EXCU
 }
 
 class RFUInputBundle extends Bundle with HasRegFileParameter with HasCoreParameter {
@@ -43,15 +39,8 @@ class RFU extends Module with HasCoreParameter with HasRegFileParameter {
   // 写入: x0 不可写
   when(io.in.wen && (io.in.rd_i =/= 0.U)) { rf(io.in.rd_i) := io.in.wdata }
 
-  // 导出所有寄存器用于 difftest (带 bypass)
-  // 如果当前周期正在写入某个寄存器，debug 输出应该是新值
-  for (i <- 0 until NRReg) {
-    io.out.debug.gpr(i) := Mux(
-      io.in.wen && (io.in.rd_i === i.U) && (i.U =/= 0.U),
-      io.in.wdata,  // bypass: 输出即将写入的新值
-      rf(i)         // 否则输出寄存器当前值
-    )
-  }
+  // a0 (带 bypass): 如果当前周期正在写入 a0, 输出新值
+  io.out.a0 := Mux(io.in.wen && (io.in.rd_i === 10.U), io.in.wdata, rf(10))
 }
 
 object RFU extends App {
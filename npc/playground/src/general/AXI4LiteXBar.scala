@@ -120,6 +120,7 @@ class AXI4LiteXBar(val p: AXI4LiteXBarParams) extends Module {
   val io = IO(new Bundle {
     val masters = Vec(p.numMasters, Flipped(new AXI4LiteMasterIO(p.axi)))
     val slaves  = Vec(p.numSlaves, Flipped(new AXI4LiteSlaveIO(p.axi)))
+    val perfConflict = Output(Bool()) // 性能事件: 这个周期有 master 因为仲裁失败而等待
   })
 
   // Safe dynamic indexing helper to avoid width mismatch warnings
@@ -275,6 +276,13 @@ class AXI4LiteXBar(val p: AXI4LiteXBarParams) extends Module {
     }
     io.masters(m).r <> rArbs(m).io.out
   }
+
+  // ========================================================================
+  // Performance event
+  // ========================================================================
+
+  private val reqValids = awArbs.map(_.io.in.map(_.valid)) ++ arArbs.map(_.io.in.map(_.valid))
+  io.perfConflict := reqValids.map(v => PopCount(v) > 1.U).reduce(_ || _)
 }
 
 // ============================================================================
@@ -10,6 +10,9 @@ import blackbox.{PmemReadDpiWrapper, PmemWriteDpiWrapper}
 class AXI4LitePmemSlave(params: AXI4LiteParams) extends Module with HasCoreParameter {
   val io = IO(new Bundle {
     val axi = new AXI4LiteSlaveIO(params)
+    // 性能事件: 接受一次请求, 等待随机延迟
+    val perfReq  = Output(Bool())
+    val perfBusy = Output(Bool())
   })
 
   // 共用延迟计数器（读写不会同时进行）
@@ -70,6 +73,8 @@ class AXI4LitePmemSlave(params: AXI4LiteParams) extends Module with HasCoreParam
     }
   }
 
+  io.perfReq := io.axi.ar.fire
+
   // ========== 写操作状态机 ==========
   object WriteState extends ChiselEnum {
     val idle, writing, done = Value
@@ -131,6 +136,7 @@ class AXI4LitePmemSlave(params: AXI4LiteParams) extends Module with HasCoreParam
         counter := LFSR(4)  // 随机延迟
         // counter := 1.U          // 固定延迟
         write_state := WriteState.writing
+        io.perfReq := true.B
         aw_received := false.B
         w_received  := false.B
       }
@@ -150,4 +156,6 @@ class AXI4LitePmemSlave(params: AXI4LiteParams) extends Module with HasCoreParam
       }
     }
   }
+
+  io.perfBusy := (read_state === ReadState.reading) || (write_state === WriteState.writing)
 }
@@ -68,7 +68,11 @@ savedefconfig: $(CONF)
 	$(Q)$< $(silent) --defconfig=configs/$@ $(Kconfig)
 	$(Q)$< $(silent) --syncconfig $(Kconfig)
 
-.PHONY: menuconfig savedefconfig defconfig
+# 按已有的 .config 重新生成 include/config/auto.conf
+syncconfig: $(CONF) $(FIXDEP)
+	$(Q)$< $(silent) --syncconfig $(Kconfig)
+
+.PHONY: menuconfig savedefconfig defconfig syncconfig
 
 # Help text used by make help
 help:
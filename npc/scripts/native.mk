@@ -125,6 +125,39 @@ gdb: run-env
 	$(call git_commit, "gdb NPC")
 	gdb -s $(BINARY) --args $(NPC_EXEC)
 
+# 并行回归测试, 脚本在 NEMU 里, 用法见 $(NEMU_HOME)/scripts/native.mk
+REGRESS_DIRS ?= $(AM_KERNELS_HOME)/tests/cpu-tests/build
+regress: run-env
+	python3 $(NEMU_HOME)/tools/regress/regress.py --sim $(GUEST_ISA)-npc=$(BINARY) \
+		--args "$(GUEST_ISA)-npc=$(ARGS_DIFF)" -o $(BUILD_DIR)/regress $(REGRESS_FLAGS) $(REGRESS_DIRS)
+
+# 标准 benchmark, 和 NEMU 用同一套脚本和负载 (见 $(NEMU_HOME)/scripts/native.mk),
+# NPC 额外报告 cycles/s 和 IPC. 负载的规模按 NEMU 定的, 在 NPC 上会跑得比较久
+PERFRUN = $(NEMU_HOME)/tools/perfrun/build/perfrun
+BENCH_KERNELS ?= $(AM_KERNELS_HOME)/benchmarks/coremark $(AM_KERNELS_HOME)/benchmarks/dhrystone \
+                 $(AM_KERNELS_HOME)/benchmarks/microbench \
+                 $(NEMU_HOME)/tools/bench/kernels/memstream $(NEMU_HOME)/tools/bench/kernels/mmio
+BENCH_RUNS ?= 3
+BENCH_CPU ?= 2
+BENCH_MAINARGS ?= test
+
+# 负载看到的是主机时间的话, 每次运行的行为都不一样, 结果没法比较
+ifneq ($(filter bench,$(MAKECMDGOALS)),)
+ifndef CONFIG_TIMER_VIRTUAL
+$(error make bench needs CONFIG_TIMER_VIRTUAL, enable it in menuconfig first)
+endif
+endif
+
+$(PERFRUN):
+	$(MAKE) -C $(NEMU_HOME)/tools/perfrun
+
+bench: $(BINARY) $(PERFRUN)
+	@for k in $(BENCH_KERNELS); do \
+		$(MAKE) -s -C $$k ARCH=$(GUEST_ISA)-npc mainargs=$(BENCH_MAINARGS) insert-arg || exit 1; \
+	done
+	python3 $(NEMU_HOME)/tools/bench/bench.py --sim $(BINARY) --arch $(GUEST_ISA)-npc --perfrun $(PERFRUN) \
+		--runs $(BENCH_RUNS) --cpu $(BENCH_CPU) --csv $(BUILD_DIR)/bench.csv $(BENCH_KERNELS)
+
 clean-tools = $(dir $(shell find ./tools -maxdepth 2 -mindepth 2 -name "Makefile"))
 
 $(clean-tools):
@@ -134,4 +167,4 @@ clean-lex-yacc:
 clean-tools: $(clean-tools)
 clean-all: clean distclean clean-tools clean-lex-yacc
 
-.PHONY: run gdb run-env clean-tools clean-all $(clean-tools) clean-lex-yacc
+.PHONY: run gdb run-env regress bench clean-tools clean-all $(clean-tools) clean-lex-yacc
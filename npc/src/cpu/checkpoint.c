@@ -0,0 +1,118 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NPC is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+// RTL 仿真的检查点 (格式见 core.cc):
+//   - sdb 的 save/load 命令, 启动时用 --restore=FILE 从检查点开始
+//   - 每 CONFIG_VERILATOR_CKPT_INTERVAL 个周期自动保存到 build/ckpt/,
+//     只留最近 CONFIG_VERILATOR_CKPT_KEEP 个
+//   - 运行失败时报告最后一个检查点, 用 --restore 从它重放,
+//     就能得到出错之前的波形, 不用从复位开始重新仿真
+// 检查点只能由保存它的同一个 build 恢复 (core.cc 会检查), 所以要看波形的话,
+// 保存检查点的那次运行就要打开 CONFIG_VERILATOR_TRACE
+// 恢复之后 REF 的 pmem 和寄存器也同步到检查点的状态
+
+#include <common.h>
+#include <cpu/checkpoint.h>
+#include <cpu/difftest.h>
+#include <isa.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+// CKPT_DIR 由 filelist.mk 根据 NPC_HOME 给出, 与运行时的工作目录无关
+
+int is_exit_status_bad();
+
+uint64_t ckpt_next = UINT64_MAX;
+static char last_ckpt[256] = ""; // 最近一次保存或者恢复的检查点
+
+#if CONFIG_VERILATOR_CKPT_INTERVAL > 0
+static char auto_ckpt[CONFIG_VERILATOR_CKPT_KEEP][256];
+static int auto_pos = 0; // 下一个要覆盖的位置
+#endif
+
+static void set_last(const char *file) {
+  snprintf(last_ckpt, sizeof(last_ckpt), "%s", file);
+}
+
+bool checkpoint_save(const char *file) {
+  if (!npc_core_save(file)) {
+    return false;
+  }
+  set_last(file);
+  Log("checkpoint: saved to %s at cycle %" PRIu64, file, npc_core_cycles());
+  return true;
+}
+
+bool checkpoint_load(const char *file) {
+  if (!npc_core_load(file)) {
+    return false;
+  }
+  IFDEF(CONFIG_DIFFTEST, difftest_sync());
+  if (ckpt_next != UINT64_MAX) {
+    ckpt_next = npc_core_cycles() + CONFIG_VERILATOR_CKPT_INTERVAL;
+  }
+  // 程序结束之后也可以回到检查点继续执行
+  npc_state.state = NPC_STOP;
+  set_last(file);
+  Log("checkpoint: restored from %s, cycle %" PRIu64 ", pc = " FMT_WORD, file,
+      npc_core_cycles(), cpu.pc);
+  return true;
+}
+
+void checkpoint_take(void) {
+  ckpt_next = npc_core_cycles() + CONFIG_VERILATOR_CKPT_INTERVAL;
+#if CONFIG_VERILATOR_CKPT_INTERVAL > 0
+  // 覆盖最早的一个
+  char *file = auto_ckpt[auto_pos];
+  if (file[0] != '\0') {
+    remove(file);
+  }
+  int len = snprintf(file, sizeof(auto_ckpt[0]), CKPT_DIR "/%" PRIu64 ".ckpt",
+                     npc_core_cycles());
+  if (len >= (int)sizeof(auto_ckpt[0]) || !npc_core_save(file)) {
+    file[0] = '\0';
+    return;
+  }
+  set_last(file);
+  auto_pos = (auto_pos + 1) % CONFIG_VERILATOR_CKPT_KEEP;
+#endif
+}
+
+void checkpoint_report(void) {
+  if (!is_exit_status_bad() || last_ckpt[0] == '\0') {
+    return;
+  }
+  Log("checkpoint: failed at cycle %" PRIu64 ", the last checkpoint is %s",
+      npc_core_cycles(), last_ckpt);
+  Log("checkpoint: replay it with --restore=%s%s", last_ckpt,
+      MUXDEF(CONFIG_VERILATOR_TRACE, "",
+             " (this build has no waveform, a build with one can not "
+             "restore the checkpoint)"));
+}
+
+void init_checkpoint(const char *restore_file) {
+#if CONFIG_VERILATOR_CKPT_INTERVAL > 0
+  if (mkdir(CKPT_DIR, 0755) != 0 && errno != EEXIST) {
+    panic("checkpoint: can not create " CKPT_DIR ": %s", strerror(errno));
+  }
+  ckpt_next = npc_core_cycles() + CONFIG_VERILATOR_CKPT_INTERVAL;
+  Log("checkpoint: saving every %d cycles to " CKPT_DIR "/",
+      CONFIG_VERILATOR_CKPT_INTERVAL);
+#endif
+  if (restore_file != NULL) {
+    bool ok = checkpoint_load(restore_file);
+    Assert(ok, "checkpoint: can not restore '%s'", restore_file);
+  }
+}
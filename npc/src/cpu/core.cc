@@ -3,9 +3,13 @@
  *
  * 职责:
  *   1. 初始化 Verilator 生成的 VNpcCoreTop 模型
- *   2. 每次 npc_core_step() 驱动时钟, 等待 debug.valid 有效
- *   3. 将 debug 信息写回 Decode 结构体, 供 itrace/difftest 使用
- *   4. 同步寄存器状态到全局 cpu 结构体
+ *   2. 每次 npc_core_step() 驱动时钟, 直到 RTL 通过 commit_dpi 报告一次提交
+ *   3. 将提交记录交给 Decode 结构体, 供 itrace/ftrace/etrace/difftest 使用
+ *   4. npc_core_run() 让核自由运行多条指令, 中间不和软件交互
+ *   5. 根据 RTL 报告的 GPR/CSR 写维护全局 cpu 结构体中的寄存器副本
+ *   6. 按周期/指令窗口 dump 波形, 或者只保留最后一段, 运行失败时才留下
+ *   7. 结束时读出 RTL 的性能计数器, 报告 IPC 和停顿的分布
+ *   8. 把模型和 NPC 的状态一起保存为检查点, 或者从检查点恢复
  */
 
 #include "debug.h"
@@ -13,8 +17,11 @@
 
 extern "C" {
 #include <common.h>
+#include <cpu/commit.h>
 #include <cpu/cpu.h>
+#include <gdbstub.h>
 #include <cpu/decode.h>
+#include <device/map.h>
 #include <isa.h>
 #include <memory/paddr.h>
 #include "../isa/riscv32/local-include/reg.h"
@@ -23,36 +30,230 @@ extern "C" {
 #include "VNPCSoC.h"
 #include <verilated.h>
 
-#ifdef CONFIG_VERILATOR_TRACE
+#ifdef CONFIG_VERILATOR_TRACE_FST
+#include <verilated_fst_c.h>
+typedef VerilatedFstC TraceFile;
+#define TRACE_EXT "fst"
+#elif defined(CONFIG_VERILATOR_TRACE)
 #include <verilated_vcd_c.h>
+typedef VerilatedVcdC TraceFile;
+#define TRACE_EXT "vcd"
+#endif
+
+#ifdef CONFIG_VERILATOR_SAVABLE
+#include <verilated_save.h>
 #endif
 
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <vector>
+
+extern "C" int is_exit_status_bad();
+extern "C" uint64_t g_nr_guest_inst;
+
 // Verilator 模型实例
 static VNPCSoC *top = nullptr;
 static VerilatedContext *ctx = nullptr;
+static uint64_t ncycles = 0;
+
+// 提交记录环, 由 RTL 通过 DPI-C 填写. 只保留最近 COMMIT_RING_SIZE 条
+static CommitRec commit_ring[COMMIT_RING_SIZE];
+static uint64_t ncommits = 0;
+static CommitRec cur = {}; // 正在执行的指令, 提交时进入环
+
+const int MAX_CYCLES = 1000; // 防止死循环, 连续这么多个周期没有提交就认为卡住了
+
+extern "C" void gpr_write_dpi(int idx, int data) {
+  if (idx == 0) {
+    return;
+  }
+  cur.rf_wen = true;
+  cur.rd = idx;
+  cur.rd_val = data;
+  cpu.gpr[idx] = data;
+}
+
+extern "C" void csr_write_dpi(int addr, int data) {
+  addr &= 0xfff;
+  if (cur.ncsr < COMMIT_MAX_CSR) {
+    cur.csr[cur.ncsr].addr = addr;
+    cur.csr[cur.ncsr].val = data;
+    cur.ncsr++;
+  }
+  cpu.csr[addr] = data;
+}
+
+extern "C" void mem_access_dpi(int wen, int addr, int data) {
+  cur.mem = wen ? 'W' : 'R';
+  cur.mem_addr = addr;
+  cur.mem_data = data;
+}
+
+extern "C" void commit_dpi(int pc, int dnpc, int inst) {
+  cur.pc = pc;
+  cur.dnpc = dnpc;
+  cur.inst = inst;
+  commit_ring[ncommits & (COMMIT_RING_SIZE - 1)] = cur;
+  ncommits++;
+  cur = CommitRec{};
+}
+
+// 性能计数器, 下标和 CSR 地址的低位一致, 见 PerfDpiWrapper
+enum {
+  PERF_CYCLE = 0,
+  PERF_INSTRET = 2,
+  PERF_IFU_STALL,
+  PERF_LSU_STALL,
+  PERF_XBAR_CONFLICT,
+  PERF_PMEM_REQ,
+  PERF_PMEM_BUSY,
+  NR_PERF
+};
+static uint64_t perf_cnt[NR_PERF];
+
+extern "C" void perf_counter_dpi(int idx, long long value) {
+  if (idx >= 0 && idx < NR_PERF) {
+    perf_cnt[idx] = value;
+  }
+}
+
+static const CommitRec *last_commit() {
+  return &commit_ring[(ncommits - 1) & (COMMIT_RING_SIZE - 1)];
+}
+
 #ifdef CONFIG_VERILATOR_TRACE
-static VerilatedVcdC *tfp = nullptr;
-static uint64_t sim_time = 0;  // 仿真时间, 用于波形 dump
+/*
+ * 波形只在 [START, END) 窗口内 dump, 窗口的单位是周期或者提交的指令数.
+ * 打开 VERILATOR_TRACE_RING 时窗口内的波形轮流写到两个文件里,
+ * 每个文件 RING_CYCLES 个周期, 结束时如果运行失败 (例如 difftest 出错)
+ * 就把最后两段留下来, 否则删掉
+ */
+#define TRACE_FILE TRACE_DIR "/npc_core." TRACE_EXT
+#define TRACE_PREV_FILE TRACE_DIR "/npc_core.prev." TRACE_EXT
+
+static TraceFile *tfp = nullptr;
+static bool tracing = false;
+static bool trace_done = false;
+// 到达 trace_next (窗口的起点或终点) 或者 ring_next (换文件) 时调用 trace_event
+static uint64_t trace_next = CONFIG_VERILATOR_TRACE_START;
+static uint64_t ring_next = UINT64_MAX;
+
+#ifdef CONFIG_VERILATOR_TRACE_RING
+static int ring_seg = 0; // 正在写的文件
+
+static const char *ring_file(int seg) {
+  return seg ? TRACE_DIR "/npc_core.ring1." TRACE_EXT
+             : TRACE_DIR "/npc_core.ring0." TRACE_EXT;
+}
 #endif
 
-static uint64_t ncycles = 0;
+static uint64_t trace_pos() {
+  return MUXDEF(CONFIG_VERILATOR_TRACE_BY_INST, ncommits, ncycles);
+}
+
+static void trace_open() {
+#ifdef CONFIG_VERILATOR_TRACE_RING
+  tfp->open(ring_file(ring_seg));
+  ring_next = ncycles + CONFIG_VERILATOR_TRACE_RING_CYCLES;
+#else
+  tfp->open(TRACE_FILE);
+  Log("waveform trace started at cycle %lu: " TRACE_FILE, ncycles);
+#endif
+  tracing = true;
+}
+
+static void trace_close() {
+  tfp->close();
+  tracing = false;
+  ring_next = UINT64_MAX;
+}
+
+static void trace_event() {
+  if (tracing && ncycles >= ring_next) {
+    // 关掉当前文件, 覆盖更早的那一个
+    trace_close();
+    IFDEF(CONFIG_VERILATOR_TRACE_RING, ring_seg ^= 1);
+    trace_open();
+  }
+  if (trace_pos() < trace_next) {
+    return;
+  }
+  if (!tracing && !trace_done) {
+    trace_open();
+    trace_next = CONFIG_VERILATOR_TRACE_END > 0 ? CONFIG_VERILATOR_TRACE_END
+                                                : UINT64_MAX;
+  } else {
+    // 窗口结束
+    trace_close();
+    trace_done = true;
+    trace_next = UINT64_MAX;
+  }
+}
+
+/// @brief 结束波形. 可以调用多次
+static void trace_finish() {
+  if (tracing) {
+    trace_close();
+    trace_done = true;
+  }
+#ifdef CONFIG_VERILATOR_TRACE_RING
+  static bool finished = false;
+  if (finished) {
+    return;
+  }
+  finished = true;
+  const char *cur_file = ring_file(ring_seg), *prev_file = ring_file(!ring_seg);
+  if (!is_exit_status_bad()) {
+    remove(cur_file);
+    remove(prev_file);
+    return;
+  }
+  if (rename(cur_file, TRACE_FILE) == 0) {
+    rename(prev_file, TRACE_PREV_FILE);
+    Log("kept the last waveform segments: " TRACE_PREV_FILE ", " TRACE_FILE);
+  }
+#endif
+}
+
+#ifdef CONFIG_VERILATOR_SAVABLE
+/// @brief 恢复检查点之后时间倒退了, 当前的波形文件作废, 按恢复后的位置重新开窗口
+static void trace_rewind() {
+  if (tracing) {
+    trace_close();
+  }
+  trace_done = false;
+  trace_next = CONFIG_VERILATOR_TRACE_START;
+}
+#endif
+
+static inline void trace_dump(uint64_t time) {
+  if (tracing) {
+    tfp->dump(time);
+  }
+}
+#endif
 
 /// @brief 打一拍(寄存器更新)
 static void tick() {
+#ifdef CONFIG_VERILATOR_TRACE
+  if (unlikely(trace_pos() >= trace_next || ncycles >= ring_next)) {
+    trace_event();
+  }
+#endif
+
   // 下降沿
   top->clock = 0;
   top->eval();
-#ifdef CONFIG_VERILATOR_TRACE
-  tfp->dump(sim_time++);
-#endif
+  IFDEF(CONFIG_VERILATOR_TRACE, trace_dump(ncycles * 2));
 
   // 上升沿 (Chisel 默认在上升沿触发)
   top->clock = 1;
   top->eval();
+  IFDEF(CONFIG_VERILATOR_TRACE, trace_dump(ncycles * 2 + 1));
   ncycles++; // 统计
-#ifdef CONFIG_VERILATOR_TRACE
-  tfp->dump(sim_time++);
-#endif
 }
 
 static void reset(int cycles = 5) {
@@ -62,23 +263,106 @@ static void reset(int cycles = 5) {
     tick();
   }
   top->reset = 0;
+  // 复位之后 step 一直保持为高, 核提交一条指令后自己回到 idle 再取下一条
+  top->io_step = 1;
+
+  // 寄存器副本回到 RTL 的复位值 (见 RFU 和 CSRU)
+  memset(cpu.gpr, 0, sizeof(cpu.gpr));
+  cpu.csr[MSTATUS] = 0x1800;
+  cpu.csr[MTVEC] = cpu.csr[MEPC] = cpu.csr[MCAUSE] = 0;
+  cur = CommitRec{};
+}
+
+/// @brief 解析 CONFIG_VERILATOR_PIN_CPUS, 例如 "2,3,4,5"
+static std::vector<int> parse_cpu_list(const char *s) {
+  std::vector<int> cpus;
+  while (*s != '\0') {
+    char *end;
+    long c = strtol(s, &end, 10);
+    if (end == s) {
+      break;
+    }
+    cpus.push_back(c);
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return cpus;
+}
+
+static bool pin_thread(pid_t tid, int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(tid, sizeof(set), &set) == 0;
+}
+
+/// @brief 当前进程的所有线程 (主线程除外), 按 tid 排序
+static std::vector<pid_t> list_threads() {
+  std::vector<pid_t> tids;
+  pid_t self = getpid();
+  DIR *dir = opendir("/proc/self/task");
+  if (dir == nullptr) {
+    return tids;
+  }
+  for (struct dirent *de; (de = readdir(dir)) != nullptr;) {
+    pid_t tid = atoi(de->d_name);
+    if (tid > 0 && tid != self) {
+      tids.push_back(tid);
+    }
+  }
+  closedir(dir);
+  std::sort(tids.begin(), tids.end());
+  return tids;
+}
+
+/// @brief 主线程绑定到第一个 CPU, 构造模型时新建的线程 (即 Verilator 的工作线程)
+/// 依次绑定到后面的 CPU. before 是构造模型之前就有的线程, 它们不参与绑定.
+/// 已知的限制: Verilator 没有公开工作线程的 tid, 这里按 tid 从小到大对应,
+/// 不保证 tid 的顺序就是线程池中工作线程的编号顺序. 每个工作线程独占一个 CPU
+/// 时这不影响效果, CPU 列表比工作线程少时哪些线程没有绑定是不确定的
+static void pin_sim_threads(const std::vector<pid_t> &before) {
+  std::vector<int> cpus = parse_cpu_list(CONFIG_VERILATOR_PIN_CPUS);
+  if (cpus.empty()) {
+    return;
+  }
+  if (!pin_thread(getpid(), cpus[0])) {
+    Log("can not pin the main thread to cpu %d", cpus[0]);
+    return;
+  }
+
+  std::vector<pid_t> tids;
+  for (pid_t tid : list_threads()) {
+    if (!std::binary_search(before.begin(), before.end(), tid)) {
+      tids.push_back(tid);
+    }
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < tids.size() && i + 1 < cpus.size(); i++) {
+    n += pin_thread(tids[i], cpus[i + 1]);
+  }
+  Log("pinned the main thread to cpu %d and %zu worker threads", cpus[0], n);
 }
 
 extern "C" bool npc_core_init(int argc, char *argv[]) {
   // init VerilatedContext
   ctx = new VerilatedContext;
   ctx->commandArgs(argc, argv);
+#ifdef CONFIG_VERILATOR_PGO_GEN
+  // 结束时写出线程调度的 profile, 给下一次 verilate 使用
+  // 路径由 filelist.mk 根据 NPC_HOME 给出, 与运行时的工作目录无关
+  ctx->profVltFilename(PGO_PROFILE_VLT);
+#endif
 
-  // init top module
+  // init top module, 工作线程在构造模型时创建
+  std::vector<pid_t> threads_before = list_threads();
   top = new VNPCSoC(ctx);
+  pin_sim_threads(threads_before);
 
-// init trace
+// init trace, 文件在到达窗口起点时才打开
 #if defined(CONFIG_VERILATOR_TRACE)
   Verilated::traceEverOn(true);
-  tfp = new VerilatedVcdC;
-  top->trace(tfp, 99);  // 99 levels: 追踪所有层级的信号
-  tfp->open("build/npc_core.vcd");
-  Log("VCD trace enabled: build/npc_core.vcd");
+  tfp = new TraceFile;
+  top->trace(tfp, CONFIG_VERILATOR_TRACE_DEPTH);
 #endif
 
   reset(); // 执行复位
@@ -86,10 +370,194 @@ extern "C" bool npc_core_init(int argc, char *argv[]) {
   return true;
 }
 
+extern "C" void npc_core_reset(void) { reset(); }
+
+extern "C" uint64_t npc_core_cycles(void) { return ncycles; }
+
+static double percent(uint64_t a, uint64_t b) {
+  return b ? a * 100.0 / b : 0;
+}
+
+extern "C" void npc_core_perf_report(void) {
+  if (top == nullptr) {
+    return;
+  }
+  // PerfDpiWrapper 是组合逻辑, 不需要打一拍
+  top->io_perfSample = 1;
+  top->eval();
+  top->io_perfSample = 0;
+  top->eval();
+
+  uint64_t cycles = perf_cnt[PERF_CYCLE], insts = perf_cnt[PERF_INSTRET];
+  uint64_t ifu = perf_cnt[PERF_IFU_STALL], lsu = perf_cnt[PERF_LSU_STALL];
+  uint64_t other = cycles - std::min(cycles, ifu + lsu);
+  uint64_t reqs = perf_cnt[PERF_PMEM_REQ];
+  if (cycles == 0) {
+    return;
+  }
+  Log("RTL cycles = %lu, instructions = %lu, IPC = %.3f, CPI = %.3f", cycles,
+      insts, (double)insts / cycles, insts ? (double)cycles / insts : 0.0);
+  Log("  fetch stall  %14lu %6.2f%%", ifu, percent(ifu, cycles));
+  Log("  memory stall %14lu %6.2f%%", lsu, percent(lsu, cycles));
+  Log("  other        %14lu %6.2f%%", other, percent(other, cycles));
+  Log("  xbar conflict cycles = %lu, pmem requests = %lu, "
+      "avg pmem delay = %.2f cycles",
+      perf_cnt[PERF_XBAR_CONFLICT], reqs,
+      reqs ? (double)perf_cnt[PERF_PMEM_BUSY] / reqs : 0.0);
+}
+
+#ifdef CONFIG_VERILATOR_SAVABLE
+/*
+ * 检查点: CkptHeader, 寄存器副本, 提交记录, pmem 中的非零页
+ * ({ uint32_t paddr; uint8_t data[CKPT_PAGE_SIZE]; }), 设备的 io_space,
+ * 最后是 Verilator 序列化的模型. 文件由 VerilatedSave 写.
+ * 模型 (包括是否打开波形) 换了之后 Verilator 恢复时会直接 abort, 所以头里
+ * 记下可执行文件的指纹, 不是同一个 build 保存的检查点在读之前就拒绝
+ */
+#define CKPT_MAGIC 0x4b43504e // "NPCK"
+#define CKPT_VERSION 2
+#define CKPT_PAGE_SIZE 4096
+
+struct CkptHeader {
+  uint32_t magic, version;
+  uint32_t mbase, msize;
+  uint64_t ncycles, ncommits, ninsts;
+  uint32_t npages;
+  uint32_t io_size;
+  uint64_t build_id;
+};
+
+/// @brief 可执行文件内容的 FNV-1a 哈希, 只算一次
+static uint64_t build_id() {
+  static uint64_t id = 0;
+  if (id != 0) {
+    return id;
+  }
+  FILE *fp = fopen("/proc/self/exe", "rb");
+  Assert(fp, "checkpoint: can not open /proc/self/exe");
+  uint64_t h = 0xcbf29ce484222325ull;
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      h = (h ^ buf[i]) * 0x100000001b3ull;
+    }
+  }
+  fclose(fp);
+  id = h;
+  return id;
+}
+
+static bool page_is_zero(const uint8_t *p) {
+  const uint64_t *w = (const uint64_t *)p;
+  for (size_t i = 0; i < CKPT_PAGE_SIZE / sizeof(uint64_t); i++) {
+    if (w[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+extern "C" bool npc_core_save(const char *file) {
+  VerilatedSave os;
+  os.open(file);
+  if (!os.isOpen()) {
+    Log("checkpoint: can not open '%s'", file);
+    return false;
+  }
+
+  uint8_t *mem = guest_to_host(CONFIG_MBASE);
+  size_t io_size;
+  uint8_t *io = io_space_used(&io_size);
+  CkptHeader h = {};
+  h.magic = CKPT_MAGIC;
+  h.version = CKPT_VERSION;
+  h.mbase = CONFIG_MBASE;
+  h.msize = CONFIG_MSIZE;
+  h.ncycles = ncycles;
+  h.ncommits = ncommits;
+  h.ninsts = g_nr_guest_inst;
+  h.io_size = io_size;
+  h.build_id = build_id();
+  for (uint32_t off = 0; off < CONFIG_MSIZE; off += CKPT_PAGE_SIZE) {
+    h.npages += !page_is_zero(mem + off);
+  }
+
+  os.write(&h, sizeof(h));
+  os.write(&cpu, sizeof(cpu));
+  os.write(&cur, sizeof(cur));
+  os.write(commit_ring, sizeof(commit_ring));
+  for (uint32_t off = 0; off < CONFIG_MSIZE; off += CKPT_PAGE_SIZE) {
+    if (!page_is_zero(mem + off)) {
+      uint32_t paddr = CONFIG_MBASE + off;
+      os.write(&paddr, sizeof(paddr));
+      os.write(mem + off, CKPT_PAGE_SIZE);
+    }
+  }
+  os.write(io, io_size);
+  os << *top;
+  os.close();
+  return true;
+}
+
+extern "C" bool npc_core_load(const char *file) {
+  VerilatedRestore is;
+  is.open(file);
+  if (!is.isOpen()) {
+    Log("checkpoint: can not open '%s'", file);
+    return false;
+  }
+
+  // 头不对的话什么都不改
+  CkptHeader h = {};
+  size_t io_size;
+  uint8_t *io = io_space_used(&io_size);
+  is.read(&h, sizeof(h));
+  if (h.magic != CKPT_MAGIC || h.version != CKPT_VERSION ||
+      h.mbase != CONFIG_MBASE || h.msize != CONFIG_MSIZE ||
+      h.io_size != io_size) {
+    Log("checkpoint: '%s' does not match this NPC (pmem or devices differ)",
+        file);
+    is.close();
+    return false;
+  }
+  if (h.build_id != build_id()) {
+    Log("checkpoint: '%s' was saved by another build of NPC, "
+        "restore it with the binary that saved it",
+        file);
+    is.close();
+    return false;
+  }
+
+  is.read(&cpu, sizeof(cpu));
+  is.read(&cur, sizeof(cur));
+  is.read(commit_ring, sizeof(commit_ring));
+  uint8_t *mem = guest_to_host(CONFIG_MBASE);
+  memset(mem, 0, CONFIG_MSIZE);
+  for (uint32_t i = 0; i < h.npages; i++) {
+    uint32_t paddr = 0;
+    is.read(&paddr, sizeof(paddr));
+    Assert(in_pmem(paddr) && in_pmem(paddr + CKPT_PAGE_SIZE - 1),
+           "checkpoint: bad page " FMT_PADDR " in '%s'", paddr, file);
+    is.read(guest_to_host(paddr), CKPT_PAGE_SIZE);
+  }
+  is.read(io, io_size);
+  is >> *top;
+  is.close();
+
+  ncycles = h.ncycles;
+  ncommits = h.ncommits;
+  g_nr_guest_inst = h.ninsts;
+  IFDEF(CONFIG_VERILATOR_TRACE, trace_rewind());
+  return true;
+}
+#endif
+
 extern "C" void npc_core_flush_trace(void) {
 #ifdef CONFIG_VERILATOR_TRACE
+  // 之后不会再仿真了, FST 只有关闭之后才是完整的
   if (tfp) {
-    tfp->flush();
+    trace_finish();
   }
 #endif
 }
@@ -97,7 +565,7 @@ extern "C" void npc_core_flush_trace(void) {
 extern "C" void npc_core_fini(void) {
 #ifdef CONFIG_VERILATOR_TRACE
   if (tfp) {
-    tfp->close();
+    trace_finish();
     delete tfp;
     tfp = nullptr;
   }
@@ -117,73 +585,9 @@ extern "C" void npc_core_fini(void) {
   Log("total cycles: %lu", ncycles);
 }
 
-/// @brief 读取 debug 信息, 写入 Decode 结构体
-static void read_debug_to_decode(Decode *s) {
-  s->pc = top->io_debug_pc;
-  s->dnpc = top->io_debug_dnpc;
-  s->snpc = s->pc + 4; // 对于 RV32, 静态下一条指令地址
-  s->isa.inst = top->io_debug_inst;
-}
-
-/// @brief 软件维护了硬件的状态, 主要是为了方便 difftest and tracee
-static void sync_gpr_to_cpu() {
-  cpu.gpr[0]  = top->io_debug_gpr_0;
-  cpu.gpr[1]  = top->io_debug_gpr_1;
-  cpu.gpr[2]  = top->io_debug_gpr_2;
-  cpu.gpr[3]  = top->io_debug_gpr_3;
-  cpu.gpr[4]  = top->io_debug_gpr_4;
-  cpu.gpr[5]  = top->io_debug_gpr_5;
-  cpu.gpr[6]  = top->io_debug_gpr_6;
-  cpu.gpr[7]  = top->io_debug_gpr_7;
-  cpu.gpr[8]  = top->io_debug_gpr_8;
-  cpu.gpr[9]  = top->io_debug_gpr_9;
-  cpu.gpr[10] = top->io_debug_gpr_10;
-  cpu.gpr[11] = top->io_debug_gpr_11;
-  cpu.gpr[12] = top->io_debug_gpr_12;
-  cpu.gpr[13] = top->io_debug_gpr_13;
-  cpu.gpr[14] = top->io_debug_gpr_14;
-  cpu.gpr[15] = top->io_debug_gpr_15;
-  cpu.gpr[16] = top->io_debug_gpr_16;
-  cpu.gpr[17] = top->io_debug_gpr_17;
-  cpu.gpr[18] = top->io_debug_gpr_18;
-  cpu.gpr[19] = top->io_debug_gpr_19;
-  cpu.gpr[20] = top->io_debug_gpr_20;
-  cpu.gpr[21] = top->io_debug_gpr_21;
-  cpu.gpr[22] = top->io_debug_gpr_22;
-  cpu.gpr[23] = top->io_debug_gpr_23;
-  cpu.gpr[24] = top->io_debug_gpr_24;
-  cpu.gpr[25] = top->io_debug_gpr_25;
-  cpu.gpr[26] = top->io_debug_gpr_26;
-  cpu.gpr[27] = top->io_debug_gpr_27;
-  cpu.gpr[28] = top->io_debug_gpr_28;
-  cpu.gpr[29] = top->io_debug_gpr_29;
-  cpu.gpr[30] = top->io_debug_gpr_30;
-  cpu.gpr[31] = top->io_debug_gpr_31;
-}
-
-static void sync_csr_to_cpu() {
-  cpu.csr[MSTATUS] = top->io_debug_csr_mstatus;
-  cpu.csr[MTVEC] = top->io_debug_csr_mtvec;
-  cpu.csr[MEPC] = top->io_debug_csr_mepc;
-  cpu.csr[MCAUSE] = top->io_debug_csr_mcause;
-}
-
-// extern "C" bool npc_core_step(Decode *s) {
-//   top->io_step = 1; top->eval(); // 拉高 step 信号
-//   read_debug_to_decode(s); // 组合逻辑的求值
-//   cpu.pc = s->dnpc; //
-//   tick(); // 更新寄存器
-//   sync_gpr_to_cpu(); // 读出写入后的寄存器
-//   sync_csr_to_cpu(); // 读出写入后的 CSR
-//   top->io_step = 0; top->eval(); // 拉低 step 信号
-//   return true;
-// }
-
 extern "C" bool npc_core_step(Decode *s) {
-  top->io_step = 1;
-
-  // 运行直到 debug.valid 为真
-  const int MAX_CYCLES = 1000; // 防止死循环
+  // 运行直到提交一条指令
+  uint64_t n = ncommits;
   int cycles = 0;
   do {
     tick();
@@ -192,15 +596,43 @@ extern "C" bool npc_core_step(Decode *s) {
       Log("Warning: npc_core_step exceeded %d cycles without debug_commit", MAX_CYCLES);
       return false;
     }
-  } while (!top->io_debug_valid);
+  } while (ncommits == n);
 
-  // 读取 commit 信息
-  read_debug_to_decode(s);
+  const CommitRec *rec = last_commit();
+  s->rec = rec;
+  s->pc = rec->pc;
+  s->dnpc = rec->dnpc;
+  s->snpc = s->pc + 4; // 对于 RV32, 静态下一条指令地址
+  s->isa.inst = rec->inst;
   cpu.pc = s->dnpc;
-  sync_gpr_to_cpu();
-  sync_csr_to_cpu();
-
-  top->io_step = 0;
-  top->eval();
   return true;
 }
+
+extern "C" uint64_t npc_core_run(uint64_t n, bool *resume) {
+  uint64_t start = ncommits;
+  vaddr_t pc = cpu.pc; // 下一条要提交的指令
+  while (ncommits - start < n && npc_state.state == NPC_RUNNING) {
+#ifdef CONFIG_GDBSTUB
+    // 和单步执行一样, 在提交 pc 处的指令之前停下来
+    if (resume != NULL && unlikely(gdb_bp_before(pc, resume))) {
+      npc_state.state = NPC_STOP;
+      break;
+    }
+#else
+    (void)resume;
+#endif
+    uint64_t last = ncommits;
+    int idle = 0;
+    do {
+      tick();
+    } while (ncommits == last && ++idle < MAX_CYCLES);
+    if (ncommits == last) {
+      Log("Warning: npc_core_run exceeded %d cycles without debug_commit", MAX_CYCLES);
+      break;
+    }
+    pc = last_commit()->dnpc;
+  }
+
+  cpu.pc = pc;
+  return ncommits - start;
+}
@@ -16,6 +16,8 @@
 #include "../monitor/sdb/sdb.h"
 #include "debug.h"
 #include "isa.h"
+#include <cpu/checkpoint.h>
+#include <cpu/commit.h>
 #include <cpu/core.h>
 #include <cpu/cpu.h>
 #include <cpu/decode.h>
@@ -23,6 +25,7 @@
 #include <device/map.h>
 #include <memory/vaddr.h>
 #include <ftrace.h>
+#include <gdbstub.h>
 #include "../isa/riscv32/local-include/reg.h" // etrace
 
 #ifdef CONFIG_ITRACE
@@ -129,6 +132,36 @@ static void dump_iringbuf(void) {
 
 static bool exec_once(Decode *s) { return npc_core_step(s); }
 
+// 自由运行时每提交这么多条指令更新一次设备
+#define FREERUN_CHUNK 4096
+
+/// @brief 没有需要逐条指令处理的功能时, 让核自由运行
+static bool can_freerun(void) {
+#if defined(CONFIG_ITRACE) || defined(CONFIG_FTRACE) ||                       \
+    defined(CONFIG_ETRACE) || defined(CONFIG_DIFFTEST)
+  return false;
+#else
+  return !g_print_step && MUXDEF(CONFIG_WATCHPOINT, !has_watchpoints(), true);
+#endif
+}
+
+static void execute_freerun(uint64_t n, bool *resume) {
+  while (n > 0) {
+    uint64_t chunk = n < FREERUN_CHUNK ? n : FREERUN_CHUNK;
+    uint64_t done = npc_core_run(chunk, resume);
+    g_nr_guest_inst += done;
+    n -= done;
+    if (npc_state.state != NPC_RUNNING)
+      break;
+    if (done < chunk) {
+      set_npc_state(NPC_ABORT, cpu.pc, -1);
+      break;
+    }
+    IFDEF(CONFIG_DEVICE, device_update());
+    checkpoint_step();
+  }
+}
+
 // ===============================  decode  ===============================
 
 enum {
@@ -196,10 +229,14 @@ static void ftrace_log(const Decode *s) {
 void etrace_push(char type, word_t cause, vaddr_t epc, vaddr_t handler);
 
 static void etrace_log(const Decode *s) {
+  // 进入异常时 RTL 依次写 mcause 和 mepc, 处理程序的入口就是 dnpc
+  const CommitRec *r = s->rec;
+  if (r->ncsr == 2 && r->csr[0].addr == MCAUSE && r->csr[1].addr == MEPC) {
+    etrace_push('E', r->csr[0].val, r->csr[1].val, s->dnpc);
+    return;
+  }
+
   INSTPAT_START();
-  INSTPAT("0000000 00000 00000 000 00000 11100 11", ecall  , I, {
-    etrace_push('E', 11, cpu.csr[MEPC], cpu.csr[MTVEC]);
-  });
   INSTPAT("0011000 00010 00000 000 00000 11100 11", mret   , R, {
     etrace_push('R', csr(MCAUSE), cpu.csr[MEPC], 0);
   });
@@ -212,14 +249,20 @@ static void etrace_log(const Decode *s) {
 
 #ifdef CONFIG_DIFFTEST
 
+// mcycle, minstret, mhpmcounter* 及其高 32 位, NEMU 里没有对应的值
+static bool is_counter_csr(word_t csr) {
+  return (csr >= MCYCLE && csr < MCYCLE + 32) ||
+         (csr >= MCYCLEH && csr < MCYCLEH + 32);
+}
+
 static void skip_csr_difftest(const Decode *s) {
   INSTPAT_START();
   INSTPAT("??????? ????? ????? 001 ????? 11100 11", csrrw  , I, {
     imm &= 0xfff;
-    if (imm == MCYCLE || imm == MCYCLEH) { difftest_skip_ref(); } });
+    if (is_counter_csr(imm)) { difftest_skip_ref(); } });
   INSTPAT("??????? ????? ????? 010 ????? 11100 11", csrrs  , I, {
     imm &= 0xfff;
-    if (imm == MCYCLE || imm == MCYCLEH) { difftest_skip_ref(); } });
+    if (is_counter_csr(imm)) { difftest_skip_ref(); } });
   INSTPAT_END();
 }
 
@@ -229,16 +272,28 @@ static void skip_csr_difftest(const Decode *s) {
 
 static void execute(uint64_t n) {
   Decode s;
+  IFDEF(CONFIG_GDBSTUB, bool resume = gdb_bp_resume());
+
+  if (can_freerun()) {
+    execute_freerun(n, MUXDEF(CONFIG_GDBSTUB, &resume, NULL));
+    return;
+  }
 
   for (; n > 0; n--) {
+    IFDEF(CONFIG_GDBSTUB, if (gdb_bp_before(cpu.pc, &resume)) break);
     if (!exec_once(&s)) {
       set_npc_state(NPC_ABORT, cpu.pc, -1);
       break;
     }
 
 #ifdef CONFIG_ITRACE
-    // 生成日志(完整)
+    // 生成日志(完整), 附上写回的寄存器
     gen_logbuf(s.logbuf, sizeof(s.logbuf), s.pc, s.snpc, &s.isa);
+    if (s.rec->rf_wen) {
+      size_t len = strlen(s.logbuf);
+      snprintf(s.logbuf + len, sizeof(s.logbuf) - len, "  # %s = " FMT_WORD,
+               reg_name(s.rec->rd), s.rec->rd_val);
+    }
     // 最近的 CONFIG_IRINGBUF_SIZE 条指令
     iringbuf_push(s.pc, s.snpc, &s.isa);
 #endif
@@ -259,6 +314,7 @@ static void execute(uint64_t n) {
     trace_and_difftest(&s, cpu.pc);
     if (npc_state.state != NPC_RUNNING) break;
     IFDEF(CONFIG_DEVICE, device_update());
+    checkpoint_step();
   }
 }
 
@@ -266,12 +322,16 @@ static void statistic() {
 #define NUMBERIC_FMT "%" PRIu64
   Log("host time spent = " NUMBERIC_FMT " us", g_timer);
   Log("total guest instructions = " NUMBERIC_FMT, g_nr_guest_inst);
-  if (g_timer > 0)
+  if (g_timer > 0) {
     Log("simulation frequency = " NUMBERIC_FMT " inst/s",
         g_nr_guest_inst * 1000000 / g_timer);
-  else
+    Log("simulation frequency = " NUMBERIC_FMT " cycles/s",
+        npc_core_cycles() * 1000000 / g_timer);
+  } else {
     Log("Finish running in less than 1 us and can not calculate the simulation "
         "frequency");
+  }
+  npc_core_perf_report();
 }
 
 static void dump_trace_msg(void) {
@@ -293,6 +353,7 @@ static void dump_trace_msg(void) {
 #ifdef CONFIG_VERILATOR_TRACE
   npc_core_flush_trace();
 #endif
+  checkpoint_report();
 }
 
 void assert_fail_msg() {
@@ -91,6 +91,14 @@ void init_difftest(char *ref_so_file, long img_size, int port) {
   ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
 }
 
+// 恢复检查点之后 DUT 回到了过去, 把整个 pmem 和寄存器复制给 REF
+void difftest_sync() {
+  ref_difftest_memcpy(PMEM_LEFT, guest_to_host(PMEM_LEFT), CONFIG_MSIZE, DIFFTEST_TO_REF);
+  ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
+  is_skip_ref = false;
+  skip_dut_nr_inst = 0;
+}
+
 /// @return true: 一致
 /// @return false: 不一致
 static bool checkregs(const CPU_state *ref, vaddr_t pc) {
@@ -0,0 +1,299 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NPC is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+// SimPoint 采样模拟的详细模式
+// 对 DIR 下的每个 ckpt-*.bin:
+//   1. 清空 pmem, 装入检查点中的非零页
+//   2. 在复位地址写一段恢复程序 (设置 CSR 和通用寄存器, 然后跳到检查点的 pc),
+//      复位核心并执行它, 之后把被覆盖的内存还原. 设备只恢复 MMIO 空间的内容
+// 检查点按 DIR/SIMPOINT_CKPT_INDEX 中的顺序模拟
+//   3. 执行 warmup 条指令, 再详细模拟 interval 条指令, 记录周期数
+// 最后按权重汇总 CPI, 估算整个程序的 IPC 和周期数
+
+#include "../isa/riscv32/local-include/reg.h"
+#include <common.h>
+#include <cpu/core.h>
+#include <cpu/cpu.h>
+#include <cpu/decode.h>
+#include <device/map.h>
+#include <isa.h>
+#include <memory/paddr.h>
+#include <simpoint.h>
+#include <stdio.h>
+
+#define T0 5
+// 4 个 CSR 各 3 条 (li + csrrw), 31 个通用寄存器各 2 条 (li), 最后 1 条跳转;
+// 远跳时最后改成 li t0 + jalr 共 3 条, 另有跳板中的 3 条
+#define STUB_NEAR_INSTS (4 * 3 + 31 * 2 + 1)
+#define STUB_FAR_INSTS (STUB_NEAR_INSTS + 2)
+#define TRAMP_INSTS 3
+#define RUN_CHUNK 4096 // 每执行这么多条指令更新一次设备
+
+void device_update();
+
+static char sp_dir[256];
+static bool sp_enabled = false;
+
+void init_simpoint(const char *ckpt_dir) {
+  if (ckpt_dir == NULL)
+    return;
+  snprintf(sp_dir, sizeof(sp_dir), "%s", ckpt_dir);
+  sp_enabled = true;
+  Log("simpoint: detailed simulation of checkpoints in %s", sp_dir);
+}
+
+bool simpoint_enabled(void) { return sp_enabled; }
+
+// ===============================  恢复程序  ===============================
+
+static void emit_li(uint32_t **p, int rd, uint32_t v) {
+  uint32_t hi = (v + 0x800) >> 12;
+  uint32_t lo = (v - (hi << 12)) & 0xfff; // addi 的立即数会被符号扩展
+  *(*p)++ = (hi << 12) | (rd << 7) | 0x37;              // lui  rd, hi
+  *(*p)++ = (lo << 20) | (rd << 15) | (rd << 7) | 0x13; // addi rd, rd, lo
+}
+
+static void emit_csrw(uint32_t **p, int csr, uint32_t v) {
+  emit_li(p, T0, v);
+  *(*p)++ = (csr << 20) | (T0 << 15) | (1 << 12) | 0x73; // csrrw x0, csr, t0
+}
+
+static uint32_t enc_jal(int32_t off) { // jal x0, off
+  uint32_t o = (uint32_t)off;
+  return (BITS(o, 20, 20) << 31) | (BITS(o, 10, 1) << 21) |
+         (BITS(o, 11, 11) << 20) | (BITS(o, 19, 12) << 12) | 0x6f;
+}
+
+static bool jal_reachable(int64_t off) {
+  return off >= -(1 << 20) && off < (1 << 20);
+}
+
+typedef struct {
+  uint32_t stub[STUB_FAR_INSTS];
+  int nr_stub;                  // 恢复程序的指令数
+  paddr_t tramp_pc;             // 跳板的地址, 近跳时不需要跳板, 为 0
+  uint32_t tramp[TRAMP_INSTS];
+} RestoreCode;
+
+/// @brief 生成恢复程序. mstatus 最后写, 否则 MIE 打开后恢复过程中可能进入中断.
+/// jal 只能跳 +-1MB, 太远的话先用 t0 跳到检查点 pc 旁边的跳板, 跳板恢复 t0
+/// 之后再 jal 过去. 这样不需要借用 mepc 和 mret, 所有状态都能精确恢复
+/// @return 能否放下跳板
+static bool build_restore(RestoreCode *c, const SimpointCkptHeader *h) {
+  uint32_t *p = c->stub;
+  emit_csrw(&p, MTVEC, h->mtvec);
+  emit_csrw(&p, MCAUSE, h->mcause);
+  emit_csrw(&p, MEPC, h->mepc);
+  emit_csrw(&p, MSTATUS, h->mstatus);
+  for (int i = 1; i < 32; i++) {
+    emit_li(&p, i, h->gpr[i]);
+  }
+
+  vaddr_t jump_pc = RESET_VECTOR + (p - c->stub) * 4;
+  int64_t off = (int64_t)h->pc - (int64_t)jump_pc;
+  c->tramp_pc = 0;
+  if (jal_reachable(off)) {
+    *p++ = enc_jal(off);
+    c->nr_stub = p - c->stub;
+    Assert(c->nr_stub == STUB_NEAR_INSTS, "simpoint: bad stub length");
+    return true;
+  }
+
+  // 跳板放在检查点 pc 之后, 放不下就放在之前, 不覆盖 pc 处的指令
+  paddr_t after = h->pc + 4, before = h->pc - TRAMP_INSTS * 4;
+  if (in_pmem(after) && in_pmem(after + TRAMP_INSTS * 4 - 1)) {
+    c->tramp_pc = after;
+  } else if (in_pmem(before) && before < h->pc) {
+    c->tramp_pc = before;
+  } else {
+    return false;
+  }
+  emit_li(&p, T0, c->tramp_pc);
+  *p++ = (T0 << 15) | 0x67; // jalr x0, 0(t0)
+  c->nr_stub = p - c->stub;
+  Assert(c->nr_stub == STUB_FAR_INSTS, "simpoint: bad stub length");
+
+  uint32_t *q = c->tramp;
+  emit_li(&q, T0, h->gpr[T0]);
+  *q++ = enc_jal((int64_t)h->pc - (int64_t)(c->tramp_pc + 8));
+  return true;
+}
+
+// ===============================  检查点  ===============================
+
+/// @brief 把 NEMU 中一个设备的 MMIO 空间装入同名的设备, 找不到就跳过
+static bool load_dev(FILE *fp, const SimpointCkptDev *d) {
+#ifdef CONFIG_DEVICE
+  for (int i = 0; i < nr_map; i++) {
+    char name[sizeof(d->name)];
+    snprintf(name, sizeof(name), "%s", maps[i].name);
+    if (strncmp(name, d->name, sizeof(name)) == 0 &&
+        maps[i].high - maps[i].low + 1 == d->len) {
+      return fread(maps[i].space, d->len, 1, fp) == 1;
+    }
+  }
+#endif
+  Log("simpoint: device '%.*s' is not restored", (int)sizeof(d->name),
+      d->name);
+  return fseek(fp, d->len, SEEK_CUR) == 0;
+}
+
+static bool load_ckpt(const char *path, SimpointCkptHeader *h) {
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    Log("simpoint: can not open '%s'", path);
+    return false;
+  }
+  bool ok = fread(h, sizeof(*h), 1, fp) == 1 &&
+            h->magic == SIMPOINT_CKPT_MAGIC &&
+            h->version == SIMPOINT_CKPT_VERSION;
+  if (!ok) {
+    Log("simpoint: '%s' is not a checkpoint", path);
+    fclose(fp);
+    return false;
+  }
+  Assert(h->mbase == CONFIG_MBASE && h->msize <= CONFIG_MSIZE,
+         "simpoint: checkpoint memory [" FMT_PADDR ", +%#x) does not fit pmem",
+         h->mbase, h->msize);
+
+  memset(guest_to_host(CONFIG_MBASE), 0, CONFIG_MSIZE);
+  for (uint32_t i = 0; i < h->npages && ok; i++) {
+    uint32_t paddr;
+    ok = fread(&paddr, sizeof(paddr), 1, fp) == 1 && in_pmem(paddr) &&
+         in_pmem(paddr + SIMPOINT_PAGE_SIZE - 1) &&
+         fread(guest_to_host(paddr), SIMPOINT_PAGE_SIZE, 1, fp) == 1;
+  }
+  for (uint32_t i = 0; i < h->ndevs && ok; i++) {
+    SimpointCkptDev d;
+    ok = fread(&d, sizeof(d), 1, fp) == 1;
+    if (ok) {
+      ok = load_dev(fp, &d);
+    }
+  }
+  fclose(fp);
+  if (!ok)
+    Log("simpoint: '%s' is truncated", path);
+  return ok;
+}
+
+/// @param done 实际执行的指令数
+/// @return 是否执行完 n 条指令
+static bool run_insts(uint64_t n, uint64_t *done) {
+  for (*done = 0; *done < n;) {
+    uint64_t chunk = n - *done < RUN_CHUNK ? n - *done : RUN_CHUNK;
+    uint64_t k = npc_core_run(chunk, NULL);
+    *done += k;
+    if (npc_state.state != NPC_RUNNING)
+      return false;
+    if (k < chunk) {
+      set_npc_state(NPC_ABORT, cpu.pc, -1);
+      return false;
+    }
+    IFDEF(CONFIG_DEVICE, device_update());
+  }
+  return true;
+}
+
+static bool simulate_ckpt(const SimpointCkptHeader *h, uint64_t *insts,
+                          uint64_t *cycles) {
+  RestoreCode c;
+  if (!build_restore(&c, h)) {
+    Log("simpoint: no room for a trampoline near pc " FMT_WORD, h->pc);
+    return false;
+  }
+
+  // 恢复程序和跳板覆盖了内存, 执行完之后还原
+  uint8_t saved[sizeof(c.stub)], saved_tramp[sizeof(c.tramp)];
+  uint8_t *entry = guest_to_host(RESET_VECTOR);
+  memcpy(saved, entry, c.nr_stub * 4);
+  memcpy(entry, c.stub, c.nr_stub * 4);
+  uint8_t *tramp = c.tramp_pc ? guest_to_host(c.tramp_pc) : NULL;
+  if (tramp) {
+    memcpy(saved_tramp, tramp, sizeof(c.tramp));
+    memcpy(tramp, c.tramp, sizeof(c.tramp));
+  }
+
+  npc_state.state = NPC_RUNNING;
+  npc_core_reset();
+  uint64_t done = 0;
+  bool ok = run_insts(c.nr_stub + (tramp ? TRAMP_INSTS : 0), &done);
+  memcpy(entry, saved, c.nr_stub * 4);
+  if (tramp) {
+    memcpy(tramp, saved_tramp, sizeof(c.tramp));
+  }
+  if (!ok || cpu.pc != h->pc) {
+    Log("simpoint: failed to restore registers, pc = " FMT_WORD, cpu.pc);
+    return false;
+  }
+
+  if (!run_insts(h->warmup, &done)) {
+    Log("simpoint: program ended during warm-up");
+    return false;
+  }
+
+  uint64_t c0 = npc_core_cycles();
+  ok = run_insts(h->interval, &done);
+  *insts = done;
+  *cycles = npc_core_cycles() - c0;
+  // 最后一个区间可能以程序结束告终
+  return (ok || npc_state.state == NPC_END) && done > 0;
+}
+
+void simpoint_run(void) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/" SIMPOINT_CKPT_INDEX, sp_dir);
+  FILE *idx = fopen(path, "r");
+  Assert(idx, "simpoint: can not open index '%s'", path);
+
+  double wsum = 0, cpi_sum = 0;
+  uint64_t total_insts = 0;
+  int nr = 0, failed = 0;
+  char name[256];
+  // 每行: 文件名 聚类编号 权重, 这里只用文件名, 其余以检查点头部为准
+  while (fscanf(idx, "%255s%*[^\n]", name) == 1) {
+    snprintf(path, sizeof(path), "%s/%s", sp_dir, name);
+    SimpointCkptHeader h;
+    uint64_t insts = 0, cycles = 0;
+    if (!load_ckpt(path, &h) || !simulate_ckpt(&h, &insts, &cycles)) {
+      failed++;
+      continue;
+    }
+
+    double cpi = (double)cycles / insts;
+    Log("simpoint: %s, weight %.4f, %" PRIu64 " insts, %" PRIu64
+        " cycles, CPI %.4f",
+        name, h.weight, insts, cycles, cpi);
+    wsum += h.weight;
+    cpi_sum += h.weight * cpi;
+    total_insts = h.total_insts;
+    nr++;
+  }
+  fclose(idx);
+
+  if (nr == 0) {
+    Log("simpoint: no checkpoint was simulated in %s", sp_dir);
+    set_npc_state(NPC_ABORT, cpu.pc, -1);
+    return;
+  }
+
+  // 只对成功模拟的检查点归一化权重
+  double cpi = cpi_sum / wsum;
+  Log("simpoint: %d checkpoints (%d failed), %.1f%% of the program covered", nr,
+      failed, wsum * 100);
+  Log("simpoint: weighted CPI = %.4f, IPC = %.4f", cpi, 1 / cpi);
+  Log("simpoint: estimated %.0f cycles for %" PRIu64 " instructions",
+      cpi * total_insts, total_insts);
+  npc_state.state = failed ? NPC_ABORT : NPC_QUIT;
+}
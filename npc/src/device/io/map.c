@@ -56,6 +56,12 @@ void init_map() {
   p_space = io_space;
 }
 
+// 所有设备的寄存器和缓冲区都是从 io_space 里分配的, 检查点只需要保存这一段
+uint8_t *io_space_used(size_t *size) {
+  *size = p_space - io_space;
+  return io_space;
+}
+
 word_t map_read(paddr_t addr, int len, IOMap *map) {
   assert(len >= 1 && len <= 8);
   check_bound(map, addr);
@@ -2,13 +2,56 @@
 #include <cpu/cpu.h>
 
 
+// pmem 在 host 上的起始地址, 第一次访存时取一次
+static uint8_t *pmem_base = NULL;
+
+/// @return addr 开始的 4 个字节都在 pmem 中时返回 host 指针, 否则返回 NULL
+static inline uint8_t *pmem_ptr(paddr_t addr) {
+  if (unlikely(pmem_base == NULL)) {
+    pmem_base = guest_to_host(CONFIG_MBASE);
+  }
+  paddr_t off = addr - CONFIG_MBASE;
+  return likely(off <= CONFIG_MSIZE - 4) ? pmem_base + off : NULL;
+}
+
 int pmem_read_dpi(int en, int addr, int len) {
   if (!en) return 0;
-  return (int)paddr_read((paddr_t)addr, len);
+  uint8_t *p = pmem_ptr(addr);
+  if (likely(p != NULL && len == 4)) {
+    uint32_t data;
+    memcpy(&data, p, sizeof(data));
+    return data;
+  }
+  return (int)paddr_read((paddr_t)addr, len); // MMIO
 }
 
+// strb 的每一位展开成一个字节的掩码
+static const uint32_t strb_mask[16] = {
+  0x00000000, 0x000000ff, 0x0000ff00, 0x0000ffff,
+  0x00ff0000, 0x00ff00ff, 0x00ffff00, 0x00ffffff,
+  0xff000000, 0xff0000ff, 0xff00ff00, 0xff00ffff,
+  0xffff0000, 0xffff00ff, 0xffffff00, 0xffffffff,
+};
+
 void pmem_write_dpi(int en, int addr, int strb, int data) {
   if (!en) return;
+  uint8_t *p = pmem_ptr(addr);
+  if (likely(p != NULL)) {
+    // 一次读出 4 个字节, 按掩码混合后一次写回
+    uint32_t mask = strb_mask[strb & 0xf], old;
+    memcpy(&old, p, sizeof(old));
+    uint32_t val = (old & ~mask) | ((uint32_t)data & mask);
+    memcpy(p, &val, sizeof(val));
+    return;
+  }
+
+  // MMIO: 常见的连续掩码一次写完, 其他情况逐字节写
+  switch (strb & 0xf) {
+    case 0x1: paddr_write((paddr_t)addr, 1, (word_t)data); return;
+    case 0x3: paddr_write((paddr_t)addr, 2, (word_t)data); return;
+    case 0xf: paddr_write((paddr_t)addr, 4, (word_t)data); return;
+    default: break;
+  }
   for (int i = 0; i < 4; i++) {
     if ((strb >> i) & 1) {
       paddr_write((paddr_t)(addr + i), 1, (word_t)((data >> (i * 8)) & 0xFF));
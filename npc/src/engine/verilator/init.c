@@ -14,10 +14,26 @@
  ***************************************************************************************/
 
 #include <cpu/cpu.h>
+#include <gdbstub.h>
+#include <simpoint.h>
 
 void sdb_mainloop();
 
 void engine_start() {
+  /* Run sampled simulation instead of the debugger. */
+  if (simpoint_enabled()) {
+    simpoint_run();
+    return;
+  }
+
+#ifdef CONFIG_GDBSTUB
+  /* Let gdb drive the execution instead of sdb. */
+  if (gdbstub_enabled()) {
+    gdbstub_mainloop();
+    return;
+  }
+#endif
+
   /* Receive commands from user. */
   sdb_mainloop();
 }
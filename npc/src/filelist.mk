@@ -19,6 +19,25 @@ DIRS-y += src/memory
 CXXSRC += src/npc-main.cc
 CXXSRC += src/cpu/core.cc
 
+ifeq ($(CONFIG_SIMPOINT),)
+SRCS-BLACKLIST-y += src/cpu/simpoint.c
+endif
+
+ifeq ($(CONFIG_VERILATOR_SAVABLE),)
+SRCS-BLACKLIST-y += src/cpu/checkpoint.c
+else
+CFLAGS += -DCKPT_DIR=\"$(NPC_HOME)/build/ckpt\"
+endif
+
+ifeq ($(CONFIG_GDBSTUB),)
+SRCS-BLACKLIST-y += src/monitor/gdbstub.c
+else ifeq ($(wildcard $(NEMU_HOME)/tools/gdbstub/rsp.c),)
+  $(error CONFIG_GDBSTUB needs tools/gdbstub/rsp.c from NEMU, but NEMU_HOME=$(NEMU_HOME) is not a NEMU repo)
+endif
+# RSP 协议层和 NEMU 共用
+SRCS-$(CONFIG_GDBSTUB) += $(NEMU_HOME)/tools/gdbstub/rsp.c
+INC_PATH += $(NEMU_HOME)/tools/gdbstub
+
 SHARE = $(if $(CONFIG_TARGET_SHARE),1,0)
 LIBS += $(if $(CONFIG_TARGET_NATIVE_ELF),-lreadline -ldl -pie,)
 
@@ -38,13 +57,23 @@ INC_PATH += $(shell verilator --getenv VERILATOR_ROOT)/include/vltstd
 CXXFLAGS += -Wno-sign-compare
 
 # 链接 Verilator 生成的静态库 (模型 + 运行时)
-# libverilated.a 已经包含 verilated_vcd_c.o
+# libverilated.a 已经包含 verilated_vcd_c.o/verilated_fst_c.o
 ARCHIVES += $(VERILATOR_LIB)
 ARCHIVES += $(VERILATOR_MDIR)/libverilated.a
 
 # Verilator 需要 pthread
 LIBS += -lpthread
 
+# FST 波形用 zlib 压缩
+LIBS += $(if $(CONFIG_VERILATOR_TRACE_FST),-lz,)
+
+# 波形文件的目录, 与运行时的工作目录无关
+CXXFLAGS += $(if $(CONFIG_VERILATOR_TRACE),-DTRACE_DIR=\"$(NPC_HOME)/build\",)
+
+# PGO 插桩的模型需要链接 gcov
+LIBS += $(if $(CONFIG_VERILATOR_PGO_GEN),-fprofile-generate=$(NPC_HOME)/build/pgo,)
+CXXFLAGS += $(if $(CONFIG_VERILATOR_PGO_GEN),-DPGO_PROFILE_VLT=\"$(NPC_HOME)/build/profile.vlt\",)
+
 ifdef mainargs
 ASFLAGS += -DBIN_PATH=\"$(mainargs)\"
 endif
@@ -25,6 +25,10 @@ enum {
   MCAUSE = 0x342,
   MCYCLE  = 0x0B00, // skip
   MCYCLEH = 0x0B80, // skip
+  MINSTRET  = 0x0B02, // skip
+  MINSTRETH = 0x0B82, // skip
+  MHPMCOUNTER3  = 0x0B03, // skip, 性能计数器, 见 PerfEventBundle
+  MHPMCOUNTER3H = 0x0B83, // skip
   MVENDORID = 0x0F11,
   MARCHID   = 0x0F12,
 };
@@ -0,0 +1,154 @@
+/***************************************************************************************
+ * Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+ *
+ * NPC is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan
+ *PSL v2. You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ *
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ *KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ *NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ *
+ * See the Mulan PSL v2 for more details.
+ ***************************************************************************************/
+
+// GDB 远程串行协议 (RSP) 的 NPC 端, 用法和 NEMU 相同:
+//   npc --gdb=1234 IMAGE             监听 127.0.0.1:1234
+//   npc --gdb=/tmp/npc.sock IMAGE    监听 Unix socket
+// 协议层在 $(NEMU_HOME)/tools/gdbstub/rsp.c 中, 这里只提供访问 NPC 的回调.
+// 寄存器来自 RTL 的 debug 端口, 只能读; 内存可以读写
+// 断点放在 gdb_bp_bitmap 中, 由 cpu-exec 和 core.cc 在每条指令之前检查
+
+#include <cpu/cpu.h>
+#include <cpu/difftest.h>
+#include <gdbstub.h>
+#include <isa.h>
+#include <memory/paddr.h>
+#include <rsp.h>
+
+#define RUN_CHUNK (1 << 16) // RTL 比 NEMU 慢, 每段少一些, Ctrl-C 才及时
+
+extern uint64_t g_nr_guest_inst;
+
+uint64_t gdb_bp_bitmap[GDB_BP_BITS / 64] = {};
+
+// 上一次停在了哪个断点上
+static bool bp_stopped = false;
+static vaddr_t bp_stop_pc = 0;
+
+static const char *gdb_addr = NULL;
+
+void gdbstub_set_addr(const char *addr) { gdb_addr = addr; }
+bool gdbstub_enabled() { return gdb_addr != NULL; }
+
+static bool reg_read(int n, word_t *val) {
+  if (n < ARRLEN(cpu.gpr)) {
+    *val = cpu.gpr[n];
+    return true;
+  }
+  if (n == RSP_PC) {
+    *val = cpu.pc;
+    return true;
+  }
+  return false;
+}
+
+// 寄存器和 pc 都在 RTL 中, 不能从外部修改
+static bool reg_write(int n, word_t val) { return false; }
+
+static bool mem_ok(paddr_t addr, word_t len) {
+  return in_pmem(addr) && (len == 0 || in_pmem(addr + len - 1));
+}
+
+static bool mem_read(paddr_t addr, uint8_t *buf, word_t len) {
+  if (!mem_ok(addr, len)) {
+    return false;
+  }
+  memcpy(buf, guest_to_host(addr), len);
+  return true;
+}
+
+static bool mem_write(paddr_t addr, const uint8_t *buf, word_t len) {
+  if (!mem_ok(addr, len)) {
+    return false;
+  }
+  memcpy(guest_to_host(addr), buf, len);
+  // REF 的内存也要一起改, 否则之后读到这里的指令都会报不一致
+  IFDEF(CONFIG_DIFFTEST, ref_difftest_memcpy(addr, guest_to_host(addr), len,
+                                             DIFFTEST_TO_REF));
+  return true;
+}
+
+static bool bp_set(vaddr_t addr, bool set) {
+  if (!in_pmem(addr) || (addr & 0x3) != 0) {
+    return false;
+  }
+  paddr_t i = (addr - PMEM_LEFT) >> 2;
+  if (set) {
+    gdb_bp_bitmap[i / 64] |= 1ull << (i % 64);
+  } else {
+    gdb_bp_bitmap[i / 64] &= ~(1ull << (i % 64));
+  }
+  return true;
+}
+
+bool gdb_bp_resume() {
+  bool resume = bp_stopped && bp_stop_pc == cpu.pc;
+  bp_stopped = false;
+  return resume;
+}
+
+bool gdb_bp_stop(vaddr_t pc, bool *resume) {
+  if (*resume) {
+    *resume = false;
+    return false;
+  }
+  bp_stopped = true;
+  bp_stop_pc = pc;
+  return true;
+}
+
+// 断点在指令之前检查, 停在断点上时 cpu.pc 就是断点地址, 执行的指令数少于 n
+static bool run(uint64_t n) {
+  uint64_t start = g_nr_guest_inst;
+  cpu_exec(n);
+  return npc_state.state != NPC_STOP || g_nr_guest_inst - start < n;
+}
+
+static RspStatus status(int *exit_code) {
+  switch (npc_state.state) {
+  case NPC_END:
+    *exit_code = npc_state.halt_ret;
+    return RSP_EXITED;
+  case NPC_QUIT:
+    *exit_code = 0;
+    return RSP_EXITED;
+  case NPC_ABORT:
+    return RSP_ABORTED;
+  default:
+    return RSP_STOPPED;
+  }
+}
+
+static void quit(void) { npc_state.state = NPC_QUIT; }
+
+void gdbstub_mainloop() {
+  static const RspTarget target = {
+      .run_chunk = RUN_CHUNK,
+      .reg_read = reg_read,
+      .reg_write = reg_write,
+      .mem_read = mem_read,
+      .mem_write = mem_write,
+      .bp_set = bp_set,
+      .exec = run,
+      .status = status,
+      .kill = quit,
+  };
+  rsp_serve(gdb_addr, &target);
+
+  // gdb detach 之后继续运行到结束
+  if (npc_state.state == NPC_STOP || npc_state.state == NPC_RUNNING) {
+    cpu_exec(-1);
+  }
+}
@@ -17,6 +17,8 @@
 #include <ftrace.h>
 #include <isa.h>
 #include <memory/paddr.h>
+#include <simpoint.h>
+#include <cpu/checkpoint.h>
 
 void init_rand();
 void init_log(const char *log_file);
@@ -40,6 +42,7 @@ static void welcome() {
 }
 
 #include <getopt.h>
+#include <gdbstub.h>
 
 void sdb_set_batch_mode();
 
@@ -47,6 +50,8 @@ static char *log_file = NULL;
 static char *diff_so_file = NULL;
 static char *img_file = NULL;
 static int difftest_port = 1234;
+static char *simpoint_dir = NULL;
+static char *restore_file = NULL;
 
 static long load_img() {
   if (img_file == NULL) {
@@ -77,6 +82,15 @@ static int parse_args(int argc, char *argv[]) {
       {"diff", required_argument, NULL, 'd'},
       {"port", required_argument, NULL, 'p'},
       {"help", no_argument, NULL, 'h'},
+#ifdef CONFIG_SIMPOINT
+      {"simpoint", required_argument, NULL, 'S'},
+#endif
+#ifdef CONFIG_GDBSTUB
+      {"gdb", required_argument, NULL, 'g'},
+#endif
+#ifdef CONFIG_VERILATOR_SAVABLE
+      {"restore", required_argument, NULL, 'R'},
+#endif
       {0, 0, NULL, 0},
   };
   int o;
@@ -94,6 +108,21 @@ static int parse_args(int argc, char *argv[]) {
     case 'd':
       diff_so_file = optarg;
       break;
+#ifdef CONFIG_SIMPOINT
+    case 'S':
+      simpoint_dir = optarg;
+      break;
+#endif
+#ifdef CONFIG_GDBSTUB
+    case 'g':
+      gdbstub_set_addr(optarg);
+      break;
+#endif
+#ifdef CONFIG_VERILATOR_SAVABLE
+    case 'R':
+      restore_file = optarg;
+      break;
+#endif
     case 1:
       img_file = optarg;
       return 0;
@@ -103,6 +132,16 @@ static int parse_args(int argc, char *argv[]) {
       printf("\t-l,--log=FILE           output log to FILE\n");
       printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
       printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
+#ifdef CONFIG_SIMPOINT
+      printf("\t--simpoint=DIR          simulate NEMU checkpoints in DIR\n");
+#endif
+#ifdef CONFIG_GDBSTUB
+      printf("\t--gdb=PORT|PATH         wait for gdb on localhost:PORT or Unix "
+             "socket PATH\n");
+#endif
+#ifdef CONFIG_VERILATOR_SAVABLE
+      printf("\t--restore=FILE          start from the checkpoint in FILE\n");
+#endif
       printf("\n");
       exit(0);
     }
@@ -139,12 +178,18 @@ void init_monitor(int argc, char *argv[]) {
   extern bool npc_core_init(int argc, char *argv[]);
   npc_core_init(argc, argv); // 必须要在 load_img 之后初始化 npc
 
+  /* Initialize SimPoint sampled simulation. */
+  init_simpoint(simpoint_dir);
+
   /* Initialize function tracer. */
   IFDEF(CONFIG_FTRACE, init_ftrace(img_file));
 
   /* Initialize differential testing. */
   init_difftest(diff_so_file, img_size, difftest_port);
 
+  /* Restore the checkpoint after difftest, so that REF is synced too. */
+  init_checkpoint(restore_file);
+
   /* Initialize the simple debugger. */
   init_sdb();
 
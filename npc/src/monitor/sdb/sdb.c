@@ -15,6 +15,7 @@
 
 #include "sdb.h"
 #include "utils.h"
+#include <cpu/checkpoint.h>
 #include <cpu/cpu.h>
 #include <isa.h>
 #include <memory/vaddr.h>
@@ -141,6 +142,26 @@ static int cmd_d(char *args) {
   return 0;
 }
 
+#ifdef CONFIG_VERILATOR_SAVABLE
+static int cmd_save(char *args) {
+  if (args == NULL) {
+    printf("usage: save FILE\n");
+    return 0;
+  }
+  checkpoint_save(args);
+  return 0;
+}
+
+static int cmd_load(char *args) {
+  if (args == NULL) {
+    printf("usage: load FILE\n");
+    return 0;
+  }
+  checkpoint_load(args);
+  return 0;
+}
+#endif
+
 static int cmd_help(char *args);
 
 enum {
@@ -153,6 +174,10 @@ enum {
   CMD_P,
   CMD_W,
   CMD_D,
+#ifdef CONFIG_VERILATOR_SAVABLE
+  CMD_SAVE,
+  CMD_LOAD,
+#endif
   NR_CMD,
 };
 
@@ -173,6 +198,10 @@ static struct {
     [CMD_P] = {"p", "print expression", cmd_p},      // p EXPR
     [CMD_W] = {"w", "watchpoint expression", cmd_w}, // w EXPR
     [CMD_D] = {"d", "delete watchpoint", cmd_d},     // d N
+#ifdef CONFIG_VERILATOR_SAVABLE
+    [CMD_SAVE] = {"save", "Save a checkpoint of the simulation", cmd_save},
+    [CMD_LOAD] = {"load", "Restore a checkpoint", cmd_load}, // load FILE
+#endif
 };
 
 static int cmd_help(char *args) {
@@ -24,6 +24,7 @@ int add_watchpoint(const char *expr);
 bool delete_watchpoint(int no);
 void list_watchpoints(void);
 bool check_watchpoints(void);
+bool has_watchpoints(void);
 
 extern const char *parse_error_msg;
 
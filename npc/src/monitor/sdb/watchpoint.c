@@ -109,6 +109,8 @@ void list_watchpoints(void) {
   }
 }
 
+bool has_watchpoints(void) { return head != NULL; }
+
 bool check_watchpoints(void) {
   bool triggered = false;
 